@@ -14,6 +14,7 @@ struct Task application[TASK_AMOUNT];
 
 int8_t person_score;
 int8_t no_person_score;
+struct ScoreFilter score_filter;
 
 void app_init()
 {
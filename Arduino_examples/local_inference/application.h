@@ -13,9 +13,12 @@
 #include "tensorflow/lite/schema/schema_generated.h"
 #include "tensorflow/lite/version.h"
 #include "tasks.h"
+#include "score_filter.h"
 
 extern int8_t person_score;
 extern int8_t no_person_score;
+//Person decision smoothed across frames (see score_filter.cpp)
+extern struct ScoreFilter score_filter;
 
 #define TASK_AMOUNT 3
 
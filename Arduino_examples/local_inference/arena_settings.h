@@ -0,0 +1,11 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_ARENA_SETTINGS_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_ARENA_SETTINGS_H_
+
+//Size of the tensor arena. Regenerate with Host_tools/arena_report.py --measured <arena_used_bytes> --write-header <this file>
+//once the value reported after AllocateTensors() on the board is known; 136 KB is the original (unmeasured) size. The host estimate
+//(81376 B for the person model) leaves out the kernel scratch buffers, so the arena is only shrunk from a measurement.
+//TENSOR_ARENA_USED_BYTES is that measurement (0 while unmeasured): report_arena_usage() warns when the usage grows beyond it.
+#define TENSOR_ARENA_USED_BYTES 0
+#define TENSOR_ARENA_SIZE (136*1024)
+
+#endif
@@ -25,6 +25,7 @@ Once the enough energy is collected in the capacitor, the scheduled application
 */
 
 #include "application.h"
+#include "arena_settings.h"
 
 //Globals used for compatibility with Arduino-style sketches
 namespace{
@@ -33,11 +34,14 @@ const tflite::Model* model = nullptr;
 tflite::MicroInterpreter* interpreter = nullptr;
 TfLiteTensor* input = nullptr;   
 
-//An area of memory used for input, output, and intermediate arrays
-constexpr int kTensorArenaSize = 136*1024;
+//An area of memory used for input, output, and intermediate arrays (sized in arena_settings.h)
+constexpr int kTensorArenaSize = TENSOR_ARENA_SIZE;
+static_assert(TENSOR_ARENA_USED_BYTES <= TENSOR_ARENA_SIZE, "The tensor arena is smaller than the usage measured on the board");
 static uint8_t tensor_arena[kTensorArenaSize];
 }
 
+size_t arena_used_bytes = 0;
+
 #define MAX_TASK_AMOUNT 10
 struct TaskInstance TSK_LIST[MAX_TASK_AMOUNT];
 int OCC_LIST[MAX_TASK_AMOUNT] = {0};
@@ -115,6 +119,7 @@ void getfirstTask()
 void setupScheduler()
 {
   app_init();
+  score_filter_init(&score_filter, SCORE_FILTER_MODE, SCORE_FILTER_ALPHA, SCORE_FILTER_ON, SCORE_FILTER_OFF, SCORE_FILTER_K, SCORE_FILTER_N);
   getfirstTask();
 }
 
@@ -283,8 +288,10 @@ void inference()
       TF_LITE_REPORT_ERROR(error_reporter, "Invoke failed!");
     }
     TfLiteTensor* output = interpreter->output(0);
-    person_score = output->data.uint8[kPersonIndex];
-    no_person_score = output->data.uint8[kNotAPersonIndex]; 
+    person_score = output->data.int8[kPersonIndex];
+    no_person_score = output->data.int8[kNotAPersonIndex];
+    //The decision is made on the dequantized person probability, smoothed across frames
+    score_filter_update(&score_filter, score_dequantize(person_score, output->params.scale, output->params.zero_point));
 }
 
 void led_task()
@@ -292,7 +299,7 @@ void led_task()
   pinMode(LEDR, OUTPUT);
   pinMode(LEDG, OUTPUT);
 
-  if (person_score > no_person_score) {
+  if (score_filter.decision) {
     digitalWrite(LEDG, LOW);
     digitalWrite(LEDR, HIGH);
     delay(500);
@@ -341,6 +348,7 @@ void setup()
     TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors () failed!");
     return;
   }
+  report_arena_usage();
 
   //Information about the memory area used for the model's input 
   input = interpreter->input(0);
@@ -353,3 +361,19 @@ void loop()
   unsigned int next_time = fmax(get_time(), 5);
   delay(next_time);
 }
+
+//Reports the tensor arena high-water mark after AllocateTensors(). The used value is the input for Host_tools/arena_report.py --measured,
+//which sizes TENSOR_ARENA_SIZE in arena_settings.h with a safety margin.
+void report_arena_usage()
+{
+  arena_used_bytes = interpreter->arena_used_bytes();
+  TF_LITE_REPORT_ERROR(error_reporter, "Tensor arena: %d of %d bytes used, %d bytes headroom",
+                       (int)arena_used_bytes, kTensorArenaSize, kTensorArenaSize - (int)arena_used_bytes);
+#if TENSOR_ARENA_USED_BYTES > 0
+  //The arena was sized from an earlier measurement, a model or library change that needs more makes the margin smaller than intended
+  if(arena_used_bytes > TENSOR_ARENA_USED_BYTES){
+    TF_LITE_REPORT_ERROR(error_reporter, "Tensor arena use grew from the %d bytes arena_settings.h was sized from, regenerate it",
+                         TENSOR_ARENA_USED_BYTES);
+  }
+#endif
+}
@@ -0,0 +1,45 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_SCORE_FILTER_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_SCORE_FILTER_H_
+
+#include <stdint.h>
+
+//Temporal smoothing of the person decision across frames
+#define SCORE_FILTER_NONE 0     //every frame decides on its own (probability >= SCORE_FILTER_THRESHOLD)
+#define SCORE_FILTER_EWMA 1     //exponentially weighted moving average of the probability, with separate on and off thresholds
+#define SCORE_FILTER_K_OF_N 2   //person after SCORE_FILTER_K of the last SCORE_FILTER_N frames were positive, no person after K negative (K > N / 2)
+
+#define SCORE_FILTER_MODE SCORE_FILTER_EWMA
+#define SCORE_FILTER_THRESHOLD 0.5f
+//Weight of the newest frame in the average, and the hysteresis band around SCORE_FILTER_THRESHOLD
+#define SCORE_FILTER_ALPHA 0.5f
+#define SCORE_FILTER_ON 0.6f
+#define SCORE_FILTER_OFF 0.4f
+#define SCORE_FILTER_K 2
+#define SCORE_FILTER_N 3
+#define SCORE_FILTER_MAX_N 32
+
+struct ScoreFilter
+{
+    int mode;
+    float alpha;
+    float on;
+    float off;
+    int k;
+    int n;
+    float smoothed;             //averaged probability (SCORE_FILTER_EWMA)
+    float probability;          //probability of the last frame
+    uint32_t history;           //per-frame decisions, newest in bit 0 (SCORE_FILTER_K_OF_N)
+    int frames;
+    bool decision;              //stable decision, person or not
+    bool changed;               //the last update changed the stable decision (or made the first one)
+    bool raw;                   //decision of the last frame alone
+    uint16_t changes;           //stable decision changes
+    uint16_t raw_changes;       //changes of the per-frame decision, the flicker the filter suppresses
+};
+
+extern float score_dequantize(int8_t value, float scale, int zero_point);
+extern void score_filter_init(struct ScoreFilter* filter, int mode, float alpha, float on, float off, int k, int n);
+extern bool score_filter_update(struct ScoreFilter* filter, float probability);
+extern float score_filter_confidence(const struct ScoreFilter* filter);
+
+#endif
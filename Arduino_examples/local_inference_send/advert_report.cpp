@@ -0,0 +1,37 @@
+/*
+This script encodes the local inference result into the manufacturer data of an advertisement. Instead of advertising, waiting for the gateway to connect, writing
+one character and disconnecting, the device sends a short burst of non-connectable advertisements and a scanning gateway receives the result without any connection.
+Every report carries a sequence number (the gateway drops the repeated advertisements of the same burst), the supply voltage and the radio-on time of the previous
+report, so the cost of both reporting paths can be compared. The gateway counterpart is in computer.py.
+*/
+#include "advert_report.h"
+
+int advert_encode(uint8_t* out, const struct ResultReport* report)
+{
+    out[0] = ADVERT_REPORT_VERSION;
+    out[1] = report->result;
+    out[2] = report->confidence;
+    out[3] = report->sequence & 0xFF;
+    out[4] = report->sequence >> 8;
+    out[5] = report->voltage_mv & 0xFF;
+    out[6] = report->voltage_mv >> 8;
+    out[7] = report->radio_on_ms & 0xFF;
+    out[8] = report->radio_on_ms >> 8;
+    out[9] = report->flags;
+    return ADVERT_REPORT_LENGTH;
+}
+
+bool advert_decode(const uint8_t* data, int length, struct ResultReport* report)
+{
+    if(length < ADVERT_REPORT_LENGTH || data[0] != ADVERT_REPORT_VERSION)
+    {
+        return false;
+    }
+    report->result = data[1];
+    report->confidence = data[2];
+    report->sequence = data[3] | (data[4] << 8);
+    report->voltage_mv = data[5] | (data[6] << 8);
+    report->radio_on_ms = data[7] | (data[8] << 8);
+    report->flags = data[9];
+    return true;
+}
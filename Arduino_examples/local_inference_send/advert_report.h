@@ -0,0 +1,42 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_ADVERT_REPORT_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_ADVERT_REPORT_H_
+
+#include <stdint.h>
+
+//Result reporting modes: connection to the gateway and a write to txChar after every inference (original), a short burst of non-connectable
+//advertisements carrying the result in the manufacturer data, or results collected in the on-device log and flushed in batches (see result_log.h)
+#define RESULT_REPORT_CONNECTED 0
+#define RESULT_REPORT_ADVERTISING 1
+#define RESULT_REPORT_BATCHED 2
+#define RESULT_REPORT_MODE RESULT_REPORT_ADVERTISING
+//Report only when the smoothed person decision changes (see score_filter.h), the first decision after boot is always reported. Applies to the
+//immediate modes only: the batched log keeps every result, its flush decides when the radio turns on.
+#define RESULT_SEND_CHANGES_ONLY 1
+
+//Duration of the advertising burst and advertising interval (0.625 ms units, 160 -> 100 ms)
+#define ADVERT_BURST_MS 600
+#define ADVERT_INTERVAL 160
+//Company identifier reserved by the Bluetooth SIG for testing, must be the same as advert_company_id in computer.py
+#define ADVERT_COMPANY_ID 0xFFFF
+
+//Manufacturer data (after the company identifier): [version, result, confidence %, sequence (uint16 LE), voltage mV (uint16 LE),
+//radio-on time of the previous report in ms (uint16 LE), flags]
+#define ADVERT_REPORT_VERSION 1
+#define ADVERT_REPORT_LENGTH 10
+//Set in flags when the previous report (whose radio-on time is carried) used the connected path
+#define ADVERT_FLAG_PREVIOUS_CONNECTED 0x01
+
+struct ResultReport
+{
+    uint8_t result;
+    uint8_t confidence;
+    uint16_t sequence;
+    uint16_t voltage_mv;
+    uint16_t radio_on_ms;
+    uint8_t flags;
+};
+
+extern int advert_encode(uint8_t* out, const struct ResultReport* report);
+extern bool advert_decode(const uint8_t* data, int length, struct ResultReport* report);
+
+#endif
@@ -11,6 +11,7 @@ IoT gateway via BLE.
 
 #include "application.h"
 #include <ArduinoBLE.h>
+#include <math.h>
 
 struct Task application[TASK_AMOUNT];
 
@@ -20,13 +21,17 @@ char* uuidOfService = "UUID_SERVICE"; //example -> char* uuidOfService = "180F";
 char* nameofPeripheral = "NAME_PERIPHERAL"; // example -> char* nameofPeripheral = "BLESender";
 int RX_BUFFER_SIZE = 220;
 bool RX_BUFFER_FIXED_LENGTH = false;
-char prediction_status[]="";
-unsigned long prevNow = 0;
-bool wasConnected = false;
+char prediction_status[2];
 
 int8_t person_score;
 int8_t no_person_score;
+struct ScoreFilter score_filter;
 int prediction;
+int reported_prediction = -1;
+uint16_t result_sequence = 0;
+unsigned long result_radio_on_ms = 0;
+bool previous_report_connected = false;
+struct ResultLog result_log;
 
 BLEService bleService(uuidOfService);
 BLECharacteristic txChar(uuidOftxChar, BLEIndicate, RX_BUFFER_SIZE, RX_BUFFER_FIXED_LENGTH);
@@ -65,7 +70,12 @@ void app_init()
     application[F_local].child[1].type = avb;
 
     application[F_results].task_name = F_results;
+#if RESULT_REPORT_MODE == RESULT_REPORT_ADVERTISING
+    //Advertising burst plus stack bring-up and shutdown (to be re-measured with the PPK2)
+    application[F_results].execution_time = ADVERT_BURST_MS + 200;
+#else
     application[F_results].execution_time = 4334;
+#endif
     application[F_results].task_priority = 5;
     application[F_results].first_task = 0;
     application[F_results].children = 0;
@@ -79,6 +89,12 @@ void app_init()
     application[F_led].required_voltage = 3957; 
 }
 
+//Time between two captures: camera execution plus the wait edge back to the camera task
+unsigned long capture_period()
+{
+    return application[F_camera].execution_time + application[F_camera].child[0].constraint_value;
+}
+
 struct Task *get_task_ti(struct TaskInstance *ti)
 {
     return &(application[ti->task_id]);
@@ -91,11 +107,17 @@ struct Task *get_task_e(struct Edge *e)
 
 void blePeripheralConnectHandler(BLEDevice central)
 {
-    //empty callback
+    session_on_connect(central);
 }
 void blePeripheralDisconnectHandler(BLEDevice central)
 {
-    //empty callback
+    session_on_disconnect();
+}
+
+//Transfers start as soon as the gateway subscribed to txChar
+void onTxCharSubscriptionChanged(BLEDevice central, BLECharacteristic characteristic)
+{
+    session_on_subscribe(characteristic.subscribed());
 }
 
 void initBLE(void){
@@ -106,50 +128,115 @@ void initBLE(void){
   BLE.addService(bleService);
   BLE.setEventHandler(BLEConnected, blePeripheralConnectHandler);
   BLE.setEventHandler(BLEDisconnected, blePeripheralDisconnectHandler);
+  txChar.setEventHandler(BLESubscribed, onTxCharSubscriptionChanged);
+  txChar.setEventHandler(BLEUnsubscribed, onTxCharSubscriptionChanged);
   BLE.advertise(); 
 }
 
-void send_results()
+//Sends the result as a short burst of non-connectable advertisements, no central has to connect
+void advertise_results()
 {
-    initBLE();
-    while(wasConnected == false)
+    struct ResultReport report;
+    uint8_t manufacturer_data[ADVERT_REPORT_LENGTH];
+
+    report.result = prediction;
+    //Confidence in the smoothed decision that is reported, not in the last frame alone
+    int confidence = (int)lroundf(score_filter_confidence(&score_filter) * 100.0f);
+    report.confidence = confidence < 0 ? 0 : (confidence > 100 ? 100 : confidence);
+    report.sequence = result_sequence;
+    report.voltage_mv = read_voltage();
+    report.radio_on_ms = result_radio_on_ms;
+    report.flags = previous_report_connected ? ADVERT_FLAG_PREVIOUS_CONNECTED : 0;
+    int length = advert_encode(manufacturer_data, &report);
+
+    BLE.begin();
+    BLE.setManufacturerData(ADVERT_COMPANY_ID, manufacturer_data, length);
+    BLE.setAdvertisingInterval(ADVERT_INTERVAL);
+    BLE.setConnectable(false);
+    BLE.advertise();
+    unsigned long start = millis();
+    while(millis() - start < ADVERT_BURST_MS)
     {
         BLE.poll();
-        long now = millis();
-        if(now-prevNow >= 4000)
+    }
+    BLE.stopAdvertise();
+    BLE.end();
+}
+
+//Sends all logged results in one session, entries are removed from the log only after their batch was confirmed. A batch has to fit into one
+//notification, so it holds only as many entries as the ATT MTU of the connection allows (one entry at the default MTU of 23 bytes)
+void flush_result_log(int voltage)
+{
+    uint8_t batch[220];
+    session_start(session_select(capture_period(), voltage));
+    if(session_wait_subscribed(SESSION_CONNECT_TIMEOUT))
+    {
+        session_first_byte();
+        int max_length = session_mtu() - 3;
+        if(max_length > RX_BUFFER_SIZE)
         {
-            prevNow = now;
-            if(BLE.connected() && wasConnected == false)
+            max_length = RX_BUFFER_SIZE;
+        }
+        while(result_log.count > 0)
+        {
+            int length = result_log_encode(&result_log, batch, max_length, millis());
+            if(length <= 0 || !txChar.writeValue(batch, length))
             {
-                if (person_score > no_person_score)
-                {
-                    prediction = 1;
-                    int j = 0;
-                    sprintf(prediction_status, "%d", prediction);
-                    while(j<1)
-                    {
-                        txChar.writeValue(prediction_status+j);
-                        j+=1;
-                    }
-                }
-                else
-                {
-                    prediction = 0;
-                    int k = 0;
-                    sprintf(prediction_status, "%d", prediction);
-                    while(k<1)
-                    {
-                        txChar.writeValue(prediction_status+k);
-                        k+=1;
-                    }
-                }
-
-                BLE.disconnect();
-                BLE.end();
-                wasConnected = true;
+                break;
             }
+            result_log_consume(&result_log, batch[1]);
         }
     }
+    session_end();
+}
+
+void send_results()
+{
+    prediction = score_filter.decision ? 1 : 0;
+#if RESULT_SEND_CHANGES_ONLY && RESULT_REPORT_MODE != RESULT_REPORT_BATCHED
+    //A decision the gateway already has (flicker included, the filter absorbs it) is not worth turning the radio on. Compared with the last
+    //reported one, so a change is still reported if F_results was skipped for lack of energy when it happened.
+    if(prediction == reported_prediction)
+    {
+        return;
+    }
+    reported_prediction = prediction;
+#endif
+    unsigned long radio_start = millis();
+
+#if RESULT_REPORT_MODE == RESULT_REPORT_ADVERTISING
+    advertise_results();
+    previous_report_connected = false;
+#elif RESULT_REPORT_MODE == RESULT_REPORT_BATCHED
+    int voltage = read_voltage();
+    struct ResultEntry entry;
+    entry.time_ms = millis();
+    entry.person_score = person_score;
+    entry.no_person_score = no_person_score;
+    entry.voltage_mv = voltage;
+    entry.strategy = RESULT_STRATEGY_LOCAL;
+    result_log_add(&result_log, &entry);
+    if(!result_log_should_flush(&result_log, millis(), voltage))
+    {
+        //Radio stays off, the result waits in the log
+        return;
+    }
+    flush_result_log(voltage);
+    previous_report_connected = true;
+#else
+    //Keep the connection of the previous cycle if the next capture follows soon and there is enough energy
+    session_start(session_select(capture_period(), read_voltage()));
+    if(session_wait_subscribed(SESSION_CONNECT_TIMEOUT))
+    {
+        session_first_byte();
+        sprintf(prediction_status, "%d", prediction);
+        txChar.writeValue(prediction_status);
+    }
+    session_end();
+    previous_report_connected = true;
+#endif
 
-    wasConnected = false;
+    //Radio-on time of this report, carried by the next advertisement
+    result_radio_on_ms = millis() - radio_start;
+    result_sequence++;
 }
@@ -14,14 +14,21 @@
 #include "tensorflow/lite/version.h"
 #include <ArduinoBLE.h>
 #include "tasks.h"
+#include "score_filter.h"
+#include "ble_session.h"
+#include "advert_report.h"
+#include "result_log.h"
 
 extern int8_t person_score;
 extern int8_t no_person_score;
+//Person decision smoothed across frames (see score_filter.cpp)
+extern struct ScoreFilter score_filter;
 extern int predicition;
 extern int RX_BUFFER_SIZE;
 extern bool RX_BUFFER_FIXED_LENGTH;
-extern unsigned long prevNow;
-extern bool wasConnected;
+extern uint16_t result_sequence;
+extern unsigned long result_radio_on_ms;
+extern struct ResultLog result_log;
 extern char* uuidOftxChar;
 extern char* uuidOfService;
 extern char* nameofPeripheral;
@@ -45,10 +52,14 @@ extern void execute(struct TaskInstance *selected_task);
 //BLE functions
 extern void blePeripheralConnectHandler(BLEDevice central);
 extern void blePeripheralDisconnectHandler(BLEDevice central);
+extern void onTxCharSubscriptionChanged(BLEDevice central, BLECharacteristic characteristic);
 extern void initBLE(void);
 
 //All defined functions
 extern void send_results();
+extern void advertise_results();
+extern void flush_result_log(int voltage);
+extern unsigned long capture_period();
 extern int read_voltage();
 
 #endif
@@ -0,0 +1,95 @@
+/*
+This script keeps a ring log of the inference results (time, scores, voltage and strategy) on the device. Instead of connecting to the gateway after every single
+inference to send one byte, the results are collected and flushed in one BLE session once enough of them are waiting, the oldest one gets too old, or there is
+plenty of energy, so the connection cost is shared by many detections. When the log is full the oldest entry is overwritten, and the number of lost entries is
+reported with the next batch. The gateway decoder is in computer.py.
+*/
+#include "result_log.h"
+
+void result_log_reset(struct ResultLog* log)
+{
+    log->head = 0;
+    log->count = 0;
+    log->dropped = 0;
+}
+
+void result_log_add(struct ResultLog* log, const struct ResultEntry* entry)
+{
+    if(log->count == RESULT_LOG_CAPACITY)
+    {
+        //Overwrite the oldest entry
+        log->head = (log->head + 1) % RESULT_LOG_CAPACITY;
+        log->count--;
+        log->dropped++;
+    }
+    log->entries[(log->head + log->count) % RESULT_LOG_CAPACITY] = *entry;
+    log->count++;
+}
+
+bool result_log_should_flush(const struct ResultLog* log, uint32_t now, int voltage)
+{
+    if(log->count == 0)
+    {
+        return false;
+    }
+    return log->count >= RESULT_LOG_FLUSH_COUNT ||
+           now - log->entries[log->head].time_ms >= RESULT_LOG_MAX_AGE ||
+           voltage >= RESULT_LOG_FLUSH_VOLTAGE;
+}
+
+static void put_u16(uint8_t* out, uint16_t value)
+{
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+static void put_u32(uint8_t* out, uint32_t value)
+{
+    put_u16(out, value & 0xFFFF);
+    put_u16(out + 2, value >> 16);
+}
+
+//Encodes the oldest entries that fit into max_length bytes into one batch message, returns the message length (0 if the log is empty).
+//The entries stay in the log until result_log_consume() confirms they were delivered.
+int result_log_encode(const struct ResultLog* log, uint8_t* out, int max_length, uint32_t now)
+{
+    int entries = (max_length - RESULT_LOG_HEADER_LENGTH) / RESULT_LOG_ENTRY_LENGTH;
+    if(entries > log->count)
+    {
+        entries = log->count;
+    }
+    if(entries <= 0)
+    {
+        return 0;
+    }
+
+    out[0] = RESULT_LOG_MESSAGE;
+    out[1] = entries;
+    put_u16(out + 2, log->dropped);
+    put_u32(out + 4, now);
+
+    uint8_t* entry_out = out + RESULT_LOG_HEADER_LENGTH;
+    for(int i = 0; i < entries; i++)
+    {
+        const struct ResultEntry* entry = &log->entries[(log->head + i) % RESULT_LOG_CAPACITY];
+        put_u32(entry_out, entry->time_ms);
+        entry_out[4] = (uint8_t)entry->person_score;
+        entry_out[5] = (uint8_t)entry->no_person_score;
+        put_u16(entry_out + 6, entry->voltage_mv);
+        entry_out[8] = entry->strategy;
+        entry_out += RESULT_LOG_ENTRY_LENGTH;
+    }
+    return RESULT_LOG_HEADER_LENGTH + entries * RESULT_LOG_ENTRY_LENGTH;
+}
+
+//Removes the given number of delivered entries (the oldest ones)
+void result_log_consume(struct ResultLog* log, int entries)
+{
+    if(entries > log->count)
+    {
+        entries = log->count;
+    }
+    log->head = (log->head + entries) % RESULT_LOG_CAPACITY;
+    log->count -= entries;
+    log->dropped = 0;
+}
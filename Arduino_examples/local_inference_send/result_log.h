@@ -0,0 +1,47 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_RESULT_LOG_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_RESULT_LOG_H_
+
+#include <stdint.h>
+
+//Entries kept on the device, the oldest entry is overwritten (and counted as dropped) when the log is full
+#define RESULT_LOG_CAPACITY 32
+//The log is flushed when it holds RESULT_LOG_FLUSH_COUNT entries, when the oldest entry is RESULT_LOG_MAX_AGE ms old, or when the
+//storage voltage is at least RESULT_LOG_FLUSH_VOLTAGE mV (energy is cheap, so results are delivered early)
+#define RESULT_LOG_FLUSH_COUNT 8
+#define RESULT_LOG_MAX_AGE 300000
+#define RESULT_LOG_FLUSH_VOLTAGE 4500
+
+//Strategy used for the logged result
+#define RESULT_STRATEGY_LOCAL 0
+#define RESULT_STRATEGY_REMOTE 1
+
+//Batch message sent over txChar: [RESULT_LOG_MESSAGE, entries, dropped entries (uint16 LE), device time ms (uint32 LE)] followed by the entries
+#define RESULT_LOG_MESSAGE 0xB1
+#define RESULT_LOG_HEADER_LENGTH 8
+//Entry: [time ms (uint32 LE), person score (int8), no person score (int8), voltage mV (uint16 LE), strategy]
+#define RESULT_LOG_ENTRY_LENGTH 9
+
+struct ResultEntry
+{
+    uint32_t time_ms;
+    int8_t person_score;
+    int8_t no_person_score;
+    uint16_t voltage_mv;
+    uint8_t strategy;
+};
+
+struct ResultLog
+{
+    struct ResultEntry entries[RESULT_LOG_CAPACITY];
+    int head;           //index of the oldest entry
+    int count;
+    uint16_t dropped;   //entries overwritten before they were flushed
+};
+
+extern void result_log_reset(struct ResultLog* log);
+extern void result_log_add(struct ResultLog* log, const struct ResultEntry* entry);
+extern bool result_log_should_flush(const struct ResultLog* log, uint32_t now, int voltage);
+extern int result_log_encode(const struct ResultLog* log, uint8_t* out, int max_length, uint32_t now);
+extern void result_log_consume(struct ResultLog* log, int entries);
+
+#endif
@@ -0,0 +1,107 @@
+/*
+This script turns the model output into the person decision. The int8 output is dequantized with the scale and zero point of the output tensor
+(score_dequantize), so the decision is made on the person probability (0 - 1) whatever the quantization of the model, and the remote score (per mille) can be
+fed to the same filter. Single frames flicker around the threshold (a person at the edge of the crop, changing light), and every flip would blink the LED or
+trigger a transmission, so the decision is smoothed across frames: either with an exponentially weighted moving average and separate on / off thresholds, or
+by requiring k of the last n frames to agree before it changes.
+*/
+#include "score_filter.h"
+
+//Real value of a quantized output, the probability for the softmax output of the person model
+float score_dequantize(int8_t value, float scale, int zero_point)
+{
+    return (value - zero_point) * scale;
+}
+
+void score_filter_init(struct ScoreFilter* filter, int mode, float alpha, float on, float off, int k, int n)
+{
+    filter->mode = mode;
+    filter->alpha = alpha;
+    filter->on = on;
+    filter->off = off;
+    filter->n = (n < 1) ? 1 : (n > SCORE_FILTER_MAX_N ? SCORE_FILTER_MAX_N : n);
+    filter->k = (k < 1) ? 1 : (k > filter->n ? filter->n : k);
+    filter->smoothed = 0.0f;
+    filter->probability = 0.0f;
+    filter->history = 0;
+    filter->frames = 0;
+    filter->decision = false;
+    filter->changed = false;
+    filter->raw = false;
+    filter->changes = 0;
+    filter->raw_changes = 0;
+}
+
+static int count_bits(uint32_t bits)
+{
+    int count = 0;
+    while(bits)
+    {
+        bits &= bits - 1;
+        count++;
+    }
+    return count;
+}
+
+//Adds the person probability of a frame, returns the stable decision
+bool score_filter_update(struct ScoreFilter* filter, float probability)
+{
+    bool raw = probability >= SCORE_FILTER_THRESHOLD;
+    if(filter->frames > 0 && raw != filter->raw)
+    {
+        filter->raw_changes++;
+    }
+    filter->raw = raw;
+    filter->probability = probability;
+
+    bool decision = filter->decision;
+    if(filter->mode == SCORE_FILTER_EWMA)
+    {
+        //The first frame starts the average
+        filter->smoothed = (filter->frames == 0) ? probability : filter->alpha * probability + (1.0f - filter->alpha) * filter->smoothed;
+        if(filter->smoothed >= filter->on)
+        {
+            decision = true;
+        }
+        else if(filter->smoothed < filter->off)
+        {
+            decision = false;
+        }
+    }
+    else if(filter->mode == SCORE_FILTER_K_OF_N)
+    {
+        uint32_t mask = (filter->n == 32) ? 0xFFFFFFFF : ((1u << filter->n) - 1);
+        filter->history = ((filter->history << 1) | (raw ? 1 : 0)) & mask;
+        int seen = (filter->frames + 1 < filter->n) ? filter->frames + 1 : filter->n;
+        int positive = count_bits(filter->history);
+        if(positive >= filter->k)
+        {
+            decision = true;
+        }
+        else if(seen - positive >= filter->k)
+        {
+            decision = false;
+        }
+    }
+    else
+    {
+        decision = raw;
+    }
+
+    //The first decision counts as changed (it was never reported), but not as a flip
+    filter->changed = filter->frames == 0 || decision != filter->decision;
+    if(filter->frames > 0 && filter->changed)
+    {
+        filter->changes++;
+    }
+    filter->decision = decision;
+    filter->frames++;
+    return decision;
+}
+
+//Probability (0 - 1) of the class the stable decision chose: from the averaged probability (SCORE_FILTER_EWMA) or from the last frame
+float score_filter_confidence(const struct ScoreFilter* filter)
+{
+    float probability = (filter->mode == SCORE_FILTER_EWMA) ? filter->smoothed : filter->probability;
+    return filter->decision ? probability : 1.0f - probability;
+}
@@ -16,25 +16,39 @@ struct Task application[TASK_AMOUNT];
 //Parameters used for the BLE communication
 char* uuidOftxChar = "UUID_TX_CHAR"; // example -> char* uuidOftxChar = "2d2F88c4-f244-5a80-21f1-ee0224e80658"
 char* uuidOfrxChar = "UUID_RX_CHAR"; // example -> char* uuidOfrxChar = "00002A3D-0000-1000-8000-00805f9b34fb"
+char* uuidOftelemetryChar = "UUID_TELEMETRY_CHAR"; // example -> char* uuidOftelemetryChar = "6e7b2c31-4f0a-4d8e-9a51-3c2d7f1e0b44"
 char* uuidOfService = "UUID_SERVICE"; // example -> char* uuidOfService = "180F"
 char* nameofPeripheral = "NAME_PERIPHERAL"; // example -> char* nameofPeripheral = "BLESender"
 int RX_BUFFER_SIZE = 220;
 bool RX_BUFFER_FIXED_LENGTH = false;
-char prediction_status[]="";
-unsigned long prevNow = 0;
-bool wasConnected = false;
-byte tmp[256];
+byte* tmp = nullptr; //RX_BUFFER_BYTES long, placed in the phase arena pool
+struct LatencyModel remote_latency;
+struct Telemetry telemetry;
+unsigned long offload_start = 0;
+unsigned long result_time = 0;
+bool result_received = false;
+bool refine_requested = false;
+struct FrameResult remote_result;
+struct ResultCache result_cache;
+uint16_t task_last_ms[TASK_AMOUNT];
 BLEService bleService(uuidOfService);
+#if TRANSFER_MODE == TRANSFER_NOTIFY_WINDOWED
+BLECharacteristic txChar(uuidOftxChar, BLENotify, TRANSFER_CHUNK_MAX, RX_BUFFER_FIXED_LENGTH);
+#else
 BLECharacteristic txChar(uuidOftxChar, BLEIndicate, RX_BUFFER_SIZE, RX_BUFFER_FIXED_LENGTH);
+#endif
 BLECharacteristic rxChar(uuidOfrxChar, BLEWriteWithoutResponse | BLEWrite, RX_BUFFER_SIZE, RX_BUFFER_FIXED_LENGTH);
+BLECharacteristic telemetryChar(uuidOftelemetryChar, BLERead, sizeof(struct Telemetry), true);
 
 int8_t person_score;
 int8_t no_person_score;
+struct ScoreFilter score_filter;
 
 void app_init()
 {
     application[F_camera].task_name = F_camera;
-    application[F_camera].execution_time = 1049;
+    //Capture only, the measured 1049 ms included decoding which is now done by F_decode (split to be re-measured with the PPK2)
+    application[F_camera].execution_time = 749;
     application[F_camera].task_priority = 3;
     application[F_camera].first_task = 1;
     application[F_camera].children = 3;
@@ -48,7 +62,7 @@ void app_init()
     application[F_camera].child[1].constraint_value = 3;
     application[F_camera].child[1].type = lowerorequal;
 
-    application[F_camera].child[2].task_id = F_local;
+    application[F_camera].child[2].task_id = F_decode;
     application[F_camera].child[2].constraint_value = 1;
     application[F_camera].child[2].type = avb;
 
@@ -70,6 +84,17 @@ void app_init()
     application[F_led2].children = 0;
     application[F_led2].required_voltage = 4000;
 
+    application[F_decode].task_name = F_decode;
+    application[F_decode].execution_time = 300;
+    application[F_decode].task_priority = 8;
+    application[F_decode].first_task = 0;
+    application[F_decode].children = 1;
+    application[F_decode].required_voltage = 3960;
+
+    application[F_decode].child[0].task_id = F_local;
+    application[F_decode].child[0].constraint_value = 0;
+    application[F_decode].child[0].type = nocondition;
+
     application[F_local].task_name = F_local;
     application[F_local].execution_time = 1148;
     application[F_local].task_priority = 8;
@@ -89,6 +114,12 @@ void app_init()
     application[F_led].required_voltage = 3960; 
 }
 
+//Time between two captures: camera execution plus the wait edge back to the camera task
+unsigned long capture_period()
+{
+    return application[F_camera].execution_time + application[F_camera].child[0].constraint_value;
+}
+
 struct Task *get_task_ti(struct TaskInstance *ti)
 {
     return &(application[ti->task_id]);
@@ -101,17 +132,94 @@ struct Task *get_task_e(struct Edge *e)
 
 void blePeripheralConnectHandler(BLEDevice central)
 {
-  //empty callback
+  transfer_on_connect();
+  session_on_connect(central);
 }
 
 void blePeripheralDisconnectHandler(BLEDevice central)
 {
-  //empty callback
+  session_on_disconnect();
+}
+
+//Transfers start as soon as the gateway subscribed to txChar
+void onTxCharSubscriptionChanged(BLEDevice central, BLECharacteristic characteristic)
+{
+  session_on_subscribe(characteristic.subscribed());
 }
 
 void onRxCharValueUpdate(BLEDevice central, BLECharacteristic characteristic) {
   
-  int dataLength = rxChar.readValue(tmp, 256);
+  if(!phase_buffer_live(&phase_buffers[BUF_RX]))
+  {
+    return;
+  }
+  byte message[RX_BUFFER_BYTES];
+  int dataLength = rxChar.readValue(message, RX_BUFFER_BYTES);
+  if(transfer_on_message(message, dataLength) || split_on_message(message, dataLength))
+  {
+    return;
+  }
+  int match = frame_match_result(message, dataLength, transfer_frame_id(), result_received, &remote_result);
+  if(match == FRAME_MATCH_STALE)
+  {
+    telemetry.stale_results++;
+    return;
+  }
+  if(match == FRAME_MATCH_ACCEPTED)
+  {
+    telemetry.result_gateway_ms = remote_result.latency_ms;
+    result_time = millis();
+    result_received = true;
+    return;
+  }
+  uint8_t frame_id;
+  if(frame_decode_refine(message, dataLength, &frame_id))
+  {
+    if(frame_id != transfer_frame_id() || result_received)
+    {
+      telemetry.stale_results++;
+      return;
+    }
+    refine_requested = true;
+    return;
+  }
+  memcpy(tmp, message, dataLength);
+}
+
+//Refresh the telemetry snapshot from the measured offload latency distribution
+void update_telemetry(void)
+{
+  telemetry.latency_samples = remote_latency.count;
+  telemetry.latency_last_ms = remote_latency.last;
+  telemetry.latency_p50_ms = latency_percentile(&remote_latency, 50, application[F_image].execution_time);
+  telemetry.latency_estimate_ms = latency_percentile(&remote_latency, LATENCY_PERCENTILE, application[F_image].execution_time);
+  for(int i = 0; i < TASK_AMOUNT && i < TELEMETRY_TASKS; i++)
+  {
+    telemetry.task_last_ms[i] = task_last_ms[i];
+  }
+  telemetryChar.writeValue((byte*)&telemetry, sizeof(struct Telemetry));
+}
+
+//Throughput of the last image transfer (bytes / duration) as seen by the device
+void update_transfer_telemetry(void)
+{
+  telemetry.transfer_ms = transfer_stats.duration_ms;
+  telemetry.transfer_bytes = transfer_stats.bytes;
+  telemetry.transfer_chunks = transfer_stats.chunks;
+  telemetry.transfer_retransmitted = transfer_stats.retransmitted;
+  telemetry.transfer_chunk_size = transfer_stats.chunk_size;
+  telemetry.connect_first_byte_ms = session_connect_latency();
+  telemetry.transfer_paused_ms = transfer_stats.paused_ms;
+  telemetry.transfer_resumes = transfer_stats.resumes;
+  telemetryChar.writeValue((byte*)&telemetry, sizeof(struct Telemetry));
+}
+
+//Feeds the person probability of a local or remote result to the decision filter, the LED tasks show the smoothed decision
+void score_result(float probability)
+{
+  score_filter_update(&score_filter, probability);
+  telemetry.decision_changes = score_filter.changes;
+  telemetry.decision_flicker = score_filter.raw_changes;
 }
 
 void initBLE(void){
@@ -120,63 +228,149 @@ void initBLE(void){
   BLE.setAdvertisedService(bleService);
   bleService.addCharacteristic(rxChar);
   bleService.addCharacteristic(txChar); 
+  bleService.addCharacteristic(telemetryChar);
+  update_telemetry();
   BLE.addService(bleService);
   BLE.setEventHandler(BLEConnected, blePeripheralConnectHandler);
   BLE.setEventHandler(BLEDisconnected, blePeripheralDisconnectHandler);
+  txChar.setEventHandler(BLESubscribed, onTxCharSubscriptionChanged);
+  txChar.setEventHandler(BLEUnsubscribed, onTxCharSubscriptionChanged);
   rxChar.setEventHandler(BLEWritten, onRxCharValueUpdate);
   BLE.advertise(); 
 }
 
-void send_image()
+//Keeps the connection until the result of the transferred frame (or a refinement request for it) arrives or the timeout passes
+static void wait_for_result(unsigned long timeout)
 {
-    initBLE();
-    while(wasConnected == false)
+    unsigned long start = millis();
+    while(!result_received && !refine_requested && BLE.connected() && millis() - start < timeout)
     {
         BLE.poll();
-        long now = millis();
-        if(now-prevNow >= 5000)
+    }
+}
+
+//An interrupted transfer (capacitor drained or connection lost) is resumed from the last acknowledged chunk, also after a reconnection
+static bool deliver_image(unsigned char* image, int image_length, bool first)
+{
+    bool delivered = false;
+    int attempts = 0;
+    while(!delivered && attempts <= TRANSFER_MAX_RESUMES && session_wait_subscribed(SESSION_CONNECT_TIMEOUT))
+    {
+        if(attempts == 0 && first)
+        {
+            session_first_byte();
+        }
+        delivered = transfer_image(image, image_length);
+        attempts++;
+    }
+    return delivered;
+}
+
+//Prepares the payload of the decoded frame and sends it, the result (if any) arrives in onRxCharValueUpdate
+static void offload_frame(int8_t* frame)
+{
+    //The payload (intermediate activation in the split computing mode, or the thumbnail) is prepared before the radio is turned on
+    unsigned char* image = jpeg_buffer;
+    int image_length = jpeg_length;
+    telemetry.thumbnail_source_bytes = jpeg_length;
+    unsigned char* payload = nullptr;
+    int payload_length = encode_split(&payload);
+    unsigned char* preview = nullptr;
+    int preview_length = 0;
+    if(payload_length <= 0 && frame != nullptr && !split_active())
+    {
+        payload_length = encode_thumbnail(frame, &payload);
+        preview_length = encode_preview(frame, payload_length > 0 ? payload_length : jpeg_length, &preview);
+    }
+    if(payload_length > 0)
+    {
+        image = payload;
+        image_length = payload_length;
+    }
+    telemetry.preview_bytes = preview_length;
+    //Keep the connection of the previous cycle if the next capture follows soon and there is enough energy
+    bool reused = session_start(session_select(capture_period(), read_voltage()));
+    if(reused)
+    {
+        update_telemetry();
+    }
+    //With a preview, the full image is only sent if the gateway asks for it
+    refine_requested = false;
+    bool delivered = deliver_image(preview_length > 0 ? preview : image, preview_length > 0 ? preview_length : image_length, true);
+    if(delivered)
+    {
+        wait_for_result(RESULT_TIMEOUT);
+    }
+    if(delivered && preview_length > 0 && refine_requested)
+    {
+        refine_requested = false;
+        telemetry.refinements++;
+        delivered = deliver_image(image, image_length, false);
+        if(delivered)
+        {
+            wait_for_result(RESULT_TIMEOUT);
+        }
+    }
+    if(!delivered)
+    {
+        transfer_abort();
+    }
+}
+
+void send_image()
+{
+    offload_start = millis();
+    result_received = false;
+    int8_t* frame = decode_frame();
+    bool cached = false;
+#if RESULT_CACHE_ENABLED
+    //A frame of the same scene as a recently offloaded one gets its result without turning the radio on
+    uint64_t hash = 0;
+    if(frame != nullptr)
+    {
+        hash = frame_hash(frame, kNumCols, kNumRows);
+        uint16_t score;
+        cached = result_cache_lookup(&result_cache, hash, millis(), &score);
+        telemetry.cache_hits = result_cache.hits;
+        telemetry.cache_misses = result_cache.misses;
+        if(cached)
         {
-            prevNow = now;
-            if(BLE.connected() && wasConnected == false)
-            {
-                if(jpeg_length == 3080)
-                {
-                  int i=0;
-                  while(i<jpeg_length)
-                  {
-                    txChar.writeValue(jpeg_buffer+i, 220);
-                    i+=220;
-                  }
-                  wasConnected = true;
-                }
-                else
-                {
-                  int i=0;
-                  while(i<jpeg_length)
-                  {
-                    txChar.writeValue(jpeg_buffer+i, 220);
-                    i+=220;
-                  }
-                  int k = 7;
-                  sprintf(prediction_status, "%d", k);
-                  int j=0;
-                  while(j<1)
-                  {
-                    txChar.writeValue(prediction_status+j);
-                    j+=1;
-                  }
-                  wasConnected = true;
-                }
-
-                delay(1000);
-                
-                BLE.disconnect();
-                BLE.end();
-            }
+            phase_enter(phase_buffers, BUF_COUNT, PHASE_TX);
+            remote_result.score = score;
+            remote_result.latency_ms = 0;
+            remote_result.flags = 0;
+            result_received = true;
+            result_time = millis();
+            //Nothing is sent for this frame, the telemetry must not repeat the transfer of the previous one
+            memset(&transfer_stats, 0, sizeof(transfer_stats));
         }
     }
+#endif
+    if(!cached)
+    {
+        offload_frame(frame);
+    }
+#if RESULT_CACHE_ENABLED
+    //A hit is not inserted again, so a cached result expires RESULT_CACHE_MAX_AGE after it came from the gateway
+    if(frame != nullptr && result_received && !cached)
+    {
+        result_cache_insert(&result_cache, hash, remote_result.score, millis());
+    }
+#endif
+    if(result_received)
+    {
+        score_result(remote_result.score / 1000.0f);
+    }
+    update_transfer_telemetry();
+    session_end();
 
-    wasConnected = false;
+    //Offload cycle ends with the received result, or with the end of the transfer if the gateway did not answer in time. Cache hits are counted
+    //in the telemetry only, they would pull the remote latency the scheduler compares with local inference towards zero
+    if(!cached)
+    {
+        unsigned long offload_end = result_received ? result_time : millis();
+        latency_record(&remote_latency, offload_end - offload_start);
+    }
 }
 
 void led2_task()
@@ -184,7 +378,8 @@ void led2_task()
   pinMode(LEDR, OUTPUT);
   pinMode(LEDG, OUTPUT);
 
-  if (char(tmp[0])=='5' || char(tmp[0])=='6' || char(tmp[0])=='7' || char(tmp[0])=='8' || char(tmp[0])=='9') {
+  //No result (timeout or stale answers only) leaves the decision of the earlier frames
+  if (score_filter.decision) {
     digitalWrite(LEDG, LOW);
     digitalWrite(LEDR, HIGH);
     delay(500);
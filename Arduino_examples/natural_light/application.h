@@ -14,20 +14,79 @@
 #include "tensorflow/lite/version.h"
 #include <ArduinoBLE.h>
 #include "tasks.h"
+#include "latency_model.h"
+#include "telemetry.h"
+#include "image_transfer.h"
+#include "ble_session.h"
+#include "phase_arena.h"
+#include "jpeg_encoder.h"
+#include "split_inference.h"
+#include "result_cache.h"
+#include "window_search.h"
+#include "prefilter.h"
+#include "prefilter_model_data.h"
+#include "model_store.h"
+#include "input_lut.h"
+#include "score_filter.h"
+#include "op_profiler.h"
 
 extern int8_t person_score;
 extern int8_t no_person_score;
+//Person decision of the local and remote results, smoothed across frames (see score_filter.cpp)
+extern struct ScoreFilter score_filter;
 extern int RX_BUFFER_SIZE;
 extern bool RX_BUFFER_FIXED_LENGTH;
-extern unsigned long prevNow;
-extern bool wasConnected;
 extern char* uuidOftxChar;
 extern char* uuidOfrxChar;
+extern char* uuidOftelemetryChar;
 extern char* uuidOfService;
 extern char* nameofPeripheral;
-extern byte tmp[256];
+extern byte* tmp;
+extern struct LatencyModel remote_latency;
+extern struct Telemetry telemetry;
+extern uint16_t task_last_ms[];
 
-#define TASK_AMOUNT 5
+#define RX_BUFFER_BYTES 256
+
+//Remote inference result (see frame_codec.h): the score (per mille) is a person probability for the decision filter. After the transfer the device
+//waits up to RESULT_TIMEOUT ms for the result of the frame it sent.
+#define RESULT_TIMEOUT 1000
+extern struct FrameResult remote_result;
+extern struct ResultCache result_cache;
+extern bool result_received;
+extern bool refine_requested;
+
+//Offload a grayscale thumbnail of the model input re-encoded on the device (see jpeg_encoder.cpp) instead of the camera JPEG.
+//THUMBNAIL_SCALE 1, 2 or 4 averages the 96x96 frame down to 96x96, 48x48 or 24x24 pixels before encoding.
+#define OFFLOAD_THUMBNAIL 1
+#define THUMBNAIL_QUALITY JPEG_QUALITY_DEFAULT
+#define THUMBNAIL_SCALE 1
+#define THUMBNAIL_MAX_BYTES 3072
+
+//Progressive offload: a PREVIEW_SCALE times smaller preview of the thumbnail is sent first, and the thumbnail (or the camera JPEG) only if the
+//gateway cannot decide on the preview and answers with a refinement request (see frame_codec.h) instead of a result
+#define OFFLOAD_PROGRESSIVE 1
+#define PREVIEW_SCALE 2
+#define PREVIEW_QUALITY 30
+#define PREVIEW_MAX_BYTES 1024
+
+//Buffers sharing the phase arena pool
+enum PhaseBufferId
+{
+    BUF_TENSOR_ARENA,
+    BUF_JPEG,
+    BUF_RX,
+    BUF_LUMA,
+    BUF_THUMBNAIL,
+    BUF_PREVIEW,
+    BUF_FRAME,
+    BUF_PREFILTER_ARENA,
+    BUF_COUNT
+};
+
+extern struct PhaseBuffer phase_buffers[BUF_COUNT];
+
+#define TASK_AMOUNT 6
 
 typedef enum TaskName
 {
@@ -35,7 +94,8 @@ typedef enum TaskName
     F_image,
     F_local,
     F_led,
-    F_led2
+    F_led2,
+    F_decode
 };
 
 extern struct Task application [TASK_AMOUNT];
@@ -45,13 +105,25 @@ extern struct Task *get_task_e(struct Edge *e);
 extern void execute(struct TaskInstance *selected_task);
 
 //BLE functions
+extern BLECharacteristic txChar;
+extern BLECharacteristic rxChar;
 extern void blePeripheralConnectHandler(BLEDevice central);
 extern void blePeripheralDisconnectHandler(BLEDevice central);
+extern void onTxCharSubscriptionChanged(BLEDevice central, BLECharacteristic characteristic);
 extern void onRxCharValueUpdate(BLEDevice central, BLECharacteristic characteristic);
 extern void initBLE(void);
+extern void update_telemetry(void);
+extern void update_transfer_telemetry(void);
 
 //All defined functions
 extern void send_image();
+extern void score_result(float probability);
+extern bool split_active();
+extern int8_t* decode_frame();
+extern int encode_thumbnail(int8_t* luma, unsigned char** thumbnail);
+extern int encode_preview(int8_t* luma, int max_length, unsigned char** preview);
+extern int encode_split(unsigned char** payload);
+extern unsigned long capture_period();
 extern int read_voltage();
 extern void led2_task();
 
@@ -4,6 +4,7 @@ image will be stored and prepare the camera for operations. This script includes
 decoding and processing the captured image as an input for the next task in the flow.
 */
 #include "image_provider.h"
+#include "frame_decoder.h"
 
 #if defined(ARDUINO) && !defined(ARDUINO_ARDUINO_NANO33BLE)
 #define ARDUINO_EXCLUDE_CODE
@@ -17,17 +18,12 @@ decoding and processing the captured image as an input for the next task in the
 #include <memorysaver.h>
 // Arducam library
 #include <ArduCAM.h>
-// JPEGDecoder library
-#include <JPEGDecoder.h>
 
 // Checks that the Arducam library has been correctly configured
 #if !(defined OV2640_MINI_2MP_PLUS)
 #error Please select the hardware platform and camera module in the Arduino/libraries/ArduCAM/memorysaver.h
 #endif
 
-// The size of our temporary buffer for holding
-// JPEG data received from the Arducam module
-#define MAX_JPEG_BYTES 4096
 // The pin connected to the Arducam Chip Select
 #define CS 7
 
@@ -36,10 +32,14 @@ int index_test;
 
 // Camera library instance
 ArduCAM myCAM(OV2640, CS);
-// Temporary buffer for holding JPEG data from camera
-unsigned char jpeg_buffer[MAX_JPEG_BYTES] = {0};
+// Temporary buffer for holding JPEG data from camera (MAX_JPEG_BYTES long, placed in the
+// phase arena pool by the sketch, see phase_buffers in natural_light.ino)
+unsigned char* jpeg_buffer = nullptr;
 // Length of the JPEG data currently in the buffer
 int jpeg_length = 0;
+// Luma to input tables, built by the sketch with input_lut_build()
+int8_t input_lut[256];
+int8_t luma_lut[256];
 
 // Get the camera module ready
 TfLiteStatus InitCamera(tflite::ErrorReporter* error_reporter) {
@@ -131,96 +131,6 @@ TfLiteStatus ReadData(tflite::ErrorReporter* error_reporter) {
   return kTfLiteOk;
 }
 
-// Decode the JPEG image, crop it, and convert it to greyscale
-TfLiteStatus DecodeAndProcessImage(tflite::ErrorReporter* error_reporter,
-                                   int image_width, int image_height,
-                                   int8_t* image_data) {
-  //Serial.println("I am decoding and processing the captured image!");
-  //TF_LITE_REPORT_ERROR(error_reporter,
-                       //"Decoding JPEG and converting to greyscale");
-  // Parse the JPEG headers. The image will be decoded as a sequence of Minimum
-  // Coded Units (MCUs), which are 16x8 blocks of pixels.
-  JpegDec.decodeArray(jpeg_buffer, jpeg_length);
-
-  // Crop the image by keeping a certain number of MCUs in each dimension
-  const int keep_x_mcus = image_width / JpegDec.MCUWidth;
-  const int keep_y_mcus = image_height / JpegDec.MCUHeight;
-
-  // Calculate how many MCUs we will throw away on the x axis
-  const int skip_x_mcus = JpegDec.MCUSPerRow - keep_x_mcus;
-  // Roughly center the crop by skipping half the throwaway MCUs at the
-  // beginning of each row
-  const int skip_start_x_mcus = skip_x_mcus / 2;
-  // Index where we will start throwing away MCUs after the data
-  const int skip_end_x_mcu_index = skip_start_x_mcus + keep_x_mcus;
-  // Same approach for the columns
-  const int skip_y_mcus = JpegDec.MCUSPerCol - keep_y_mcus;
-  const int skip_start_y_mcus = skip_y_mcus / 2;
-  const int skip_end_y_mcu_index = skip_start_y_mcus + keep_y_mcus;
-
-  // Pointer to the current pixel
-  uint16_t* pImg;
-  // Color of the current pixel
-  uint16_t color;
-
-  // Loop over the MCUs
-  while (JpegDec.read()) {
-    // Skip over the initial set of rows
-    if (JpegDec.MCUy < skip_start_y_mcus) {
-      continue;
-    }
-    // Skip if we're on a column that we don't want
-    if (JpegDec.MCUx < skip_start_x_mcus ||
-        JpegDec.MCUx >= skip_end_x_mcu_index) {
-      continue;
-    }
-    // Skip if we've got all the rows we want
-    if (JpegDec.MCUy >= skip_end_y_mcu_index) {
-      continue;
-    }
-    // Pointer to the current pixel
-    pImg = JpegDec.pImage;
-
-    // The x and y indexes of the current MCU, ignoring the MCUs we skip
-    int relative_mcu_x = JpegDec.MCUx - skip_start_x_mcus;
-    int relative_mcu_y = JpegDec.MCUy - skip_start_y_mcus;
-
-    // The coordinates of the top left of this MCU when applied to the output
-    // image
-    int x_origin = relative_mcu_x * JpegDec.MCUWidth;
-    int y_origin = relative_mcu_y * JpegDec.MCUHeight;
-
-    // Loop through the MCU's rows and columns
-    for (int mcu_row = 0; mcu_row < JpegDec.MCUHeight; mcu_row++) {
-      // The y coordinate of this pixel in the output index
-      int current_y = y_origin + mcu_row;
-      for (int mcu_col = 0; mcu_col < JpegDec.MCUWidth; mcu_col++) {
-        // Read the color of the pixel as 16-bit integer
-        color = *pImg++;
-        // Extract the color values (5 red bits, 6 green, 5 blue)
-        uint8_t r, g, b;
-        r = ((color & 0xF800) >> 11) * 8;
-        g = ((color & 0x07E0) >> 5) * 4;
-        b = ((color & 0x001F) >> 0) * 8;
-        // Convert to grayscale by calculating luminance
-        // See https://en.wikipedia.org/wiki/Grayscale for magic numbers
-        float gray_value = (0.2126 * r) + (0.7152 * g) + (0.0722 * b);
-
-        // Convert to signed 8-bit integer by subtracting 128.
-        gray_value -= 128;
-
-        // The x coordinate of this pixel in the output image
-        int current_x = x_origin + mcu_col;
-        // The index of this pixel in our flat output buffer
-        int index = (current_y * image_width) + current_x;
-        image_data[index] = static_cast<int8_t>(gray_value);
-      }
-    }
-  }
-  //TF_LITE_REPORT_ERROR(error_reporter, "Image decoded and processed");
-  return kTfLiteOk;
-}
-
 // Get an image from the camera module
 TfLiteStatus GetImage(tflite::ErrorReporter* error_reporter, int image_width,
                       int image_height, int channels, int8_t* image_data) {
@@ -243,11 +153,12 @@ TfLiteStatus GetImage(tflite::ErrorReporter* error_reporter, int image_width,
   TfLiteStatus read_data_status = ReadData(error_reporter);
   if (read_data_status != kTfLiteOk) {
     //TF_LITE_REPORT_ERROR(error_reporter, "ReadData failed");
+    jpeg_length = 0;
     return read_data_status;
   }
 
   TfLiteStatus decode_status = DecodeAndProcessImage(
-      error_reporter, image_width, image_height, image_data);
+      error_reporter, jpeg_buffer, jpeg_length, image_width, image_height, image_data, input_lut);
   if (decode_status != kTfLiteOk) {
     //TF_LITE_REPORT_ERROR(error_reporter, "DecodeAndProcessImage failed");
     return decode_status;
@@ -256,9 +167,11 @@ TfLiteStatus GetImage(tflite::ErrorReporter* error_reporter, int image_width,
   return kTfLiteOk;
 }
 
-void initialize_camera(tflite::ErrorReporter* error_reporter, int image_width, int image_height, int channels, int8_t* image_data) {
+// Capture stage: initialize the camera, take a picture and read the raw JPEG into jpeg_buffer.
+// The frame is not decoded here, so cycles that only offload the JPEG skip the decoding cost.
+TfLiteStatus capture_image(tflite::ErrorReporter* error_reporter) {
 
-  //Serial.println("I am in initialize camera!");
+  //Serial.println("I am in capture image!");
   TfLiteStatus init_status = InitCamera(error_reporter);
   if (init_status != kTfLiteOk) {
     //TF_LITE_REPORT_ERROR(error_reporter, "InitCamera failed");
@@ -274,16 +187,36 @@ void initialize_camera(tflite::ErrorReporter* error_reporter, int image_width, i
   TfLiteStatus read_data_status = ReadData(error_reporter);
   if (read_data_status != kTfLiteOk) {
     //TF_LITE_REPORT_ERROR(error_reporter, "ReadData failed");
-    //return read_data_status;
+    jpeg_length = 0;
+    return read_data_status;
   }
 
-  TfLiteStatus decode_status = DecodeAndProcessImage(error_reporter, image_width, image_height, image_data);
+  return kTfLiteOk;
+}
+
+// Decode stage: decode the JPEG already held in jpeg_buffer into the model input (lut is input_lut), or into the plain luma - 128 (luma_lut)
+TfLiteStatus decode_image(tflite::ErrorReporter* error_reporter, int image_width, int image_height, int8_t* image_data, const int8_t* lut) {
+
+  if (jpeg_length == 0) {
+    return kTfLiteError;
+  }
+
+  TfLiteStatus decode_status = DecodeAndProcessImage(error_reporter, jpeg_buffer, jpeg_length, image_width, image_height, image_data, lut);
   if (decode_status != kTfLiteOk) {
     //TF_LITE_REPORT_ERROR(error_reporter, "DecodeAndProcessImage failed");
-    //return decode_status;
+    return decode_status;
   }
 
-  //return kTfLiteOk;
+  return kTfLiteOk;
+}
+
+// Full cycle (capture and decode) kept for the examples that always run inference locally
+void initialize_camera(tflite::ErrorReporter* error_reporter, int image_width, int image_height, int channels, int8_t* image_data) {
+
+  if (capture_image(error_reporter) != kTfLiteOk) {
+    return;
+  }
+  decode_image(error_reporter, image_width, image_height, image_data, input_lut);
 }
 
 #endif  // ARDUINO_EXCLUDE_CODE
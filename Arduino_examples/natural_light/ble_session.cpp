@@ -0,0 +1,170 @@
+/*
+This script manages the BLE session used by the transfer tasks. In the one-shot session (original behaviour) every transfer brings up the stack (BLE.begin, service setup,
+advertising), waits for the central, sends the data and ends with BLE.disconnect() and BLE.end(), so every cycle pays for the stack bring-up, advertising and
+connection establishment. In the persistent session the stack and the connection are kept alive between cycles, with a longer connection interval and slave latency
+negotiated, so the idle connection costs only a few short connection events.
+Which session is used is decided for every transfer from the capture period and the storage voltage: keeping the connection alive only pays off when the next transfer
+follows soon and there is enough energy to keep the radio connected in the meantime.
+The transfer is driven by the connection and subscription events: it starts as soon as the gateway subscribed to the TX characteristic, and the time from the
+connection (or from the start of the cycle on a reused connection) to the first byte sent is kept for the telemetry.
+The connection parameters of a persistent session are requested for the connection handle of the connected central, once the connection is established and
+outside the connect handler (from the polling loop of session_wait_subscribed).
+*/
+#include "application.h"
+#include "ble_session.h"
+#include <utility/ATT.h>
+#include <utility/HCI.h>
+
+//Connection handle of no connection
+#define SESSION_NO_HANDLE 0xffff
+//ATT MTU of a connection before the central negotiated a larger one
+#define SESSION_DEFAULT_MTU 23
+
+static bool stack_up = false;
+static bool persistent_session = false;
+static volatile bool central_subscribed = false;
+static unsigned long connect_time = 0;
+static unsigned long first_byte_latency = 0;
+static uint16_t connection_handle = SESSION_NO_HANDLE;
+static volatile bool update_pending = false;
+
+//Returns true if the connection should be kept alive after the transfer
+bool session_select(unsigned long capture_period, int voltage)
+{
+#if SESSION_PERSISTENT_ENABLED
+    return capture_period <= SESSION_MAX_PERIOD && voltage >= SESSION_MIN_VOLTAGE;
+#else
+    return false;
+#endif
+}
+
+//Brings the stack up if needed and advertises if no central is connected, returns true if the connection of the previous cycle is reused
+bool session_start(bool persistent)
+{
+    bool reused = stack_up && BLE.connected();
+    persistent_session = persistent;
+    if(reused)
+    {
+        connect_time = millis();
+    }
+
+    if(!stack_up)
+    {
+        if(persistent)
+        {
+            //Preferred interval, requested by the stack right after the central connects
+            BLE.setConnectionInterval(SESSION_INTERVAL_MIN, SESSION_INTERVAL_MAX);
+        }
+        initBLE();
+        stack_up = true;
+    }
+    else if(!reused)
+    {
+        BLE.advertise();
+    }
+    return reused;
+}
+
+//Ends the transfer, the stack is only shut down in the one-shot session
+void session_end()
+{
+    if(persistent_session && BLE.connected())
+    {
+        return;
+    }
+    BLE.disconnect();
+    BLE.end();
+    stack_up = false;
+}
+
+//Returns the connection handle the controller assigned to the central, BLEDevice does not expose it, so it is looked up by the peer address
+static uint16_t central_handle(BLEDevice central)
+{
+    //address() prints the most significant byte first, the stack keeps the address least significant byte first
+    String text = central.address();
+    uint8_t address[6];
+    for(int i = 0; i < 6; i++)
+    {
+        address[5 - i] = strtoul(text.substring(i * 3, i * 3 + 2).c_str(), NULL, 16);
+    }
+    //Public or random address
+    for(uint8_t address_type = 0; address_type <= 1; address_type++)
+    {
+        uint16_t handle = ATT.connectionHandle(address_type, address);
+        if(handle != SESSION_NO_HANDLE)
+        {
+            return handle;
+        }
+    }
+    return SESSION_NO_HANDLE;
+}
+
+//Called from the BLE connect handler, the connection parameters are only requested later from session_request_parameters()
+void session_on_connect(BLEDevice central)
+{
+    connect_time = millis();
+    central_subscribed = false;
+    connection_handle = central_handle(central);
+    update_pending = persistent_session && connection_handle != SESSION_NO_HANDLE;
+}
+
+void session_on_disconnect()
+{
+    central_subscribed = false;
+    update_pending = false;
+    connection_handle = SESSION_NO_HANDLE;
+}
+
+//Asks the central for slave latency so the idle connection between cycles costs less energy
+static void session_request_parameters()
+{
+    if(update_pending && BLE.connected())
+    {
+        update_pending = false;
+        HCI.leConnUpdate(connection_handle, SESSION_INTERVAL_MIN, SESSION_INTERVAL_MAX, SESSION_SLAVE_LATENCY, SESSION_SUPERVISION_TIMEOUT);
+    }
+}
+
+//Called from the subscription event handler of the TX characteristic
+void session_on_subscribe(bool subscribed)
+{
+    central_subscribed = subscribed;
+}
+
+//Polls the stack until the gateway is connected and subscribed, returns false if that did not happen within the timeout
+bool session_wait_subscribed(unsigned long timeout)
+{
+    unsigned long start = millis();
+    while(!central_subscribed || !BLE.connected())
+    {
+        BLE.poll();
+        session_request_parameters();
+        if(millis() - start >= timeout)
+        {
+            return false;
+        }
+    }
+    session_request_parameters();
+    return true;
+}
+
+//Called right before the first byte of the transfer is sent
+void session_first_byte()
+{
+    first_byte_latency = millis() - connect_time;
+}
+
+unsigned long session_connect_latency()
+{
+    return first_byte_latency;
+}
+
+//ATT MTU of the current connection, a notification carries at most session_mtu() - 3 bytes (ArduinoBLE cuts longer values without an error)
+uint16_t session_mtu()
+{
+    if(connection_handle == SESSION_NO_HANDLE)
+    {
+        return SESSION_DEFAULT_MTU;
+    }
+    return ATT.mtu(connection_handle);
+}
@@ -0,0 +1,174 @@
+/*
+This script encodes and decodes the messages of the image transfer protocol. Every JPEG chunk carries a small header with the frame id, chunk index, total image length
+and a CRC-16, so the gateway can reassemble images of any size (also with lost, duplicated or reordered chunks) without guessing the frame boundaries from the chunk
+length or an end marker. The gateway acknowledges chunks with a message carrying the frame id, the next expected chunk and the negotiated ATT MTU. When chunks
+are lost, it sends a negative acknowledgement with a bitmap of the missing chunks instead, so only those have to be sent again. The result of the remote
+inference comes back as a binary message with the frame id (so late results of earlier frames can be told apart), the score, the gateway latency and an
+optional bounding box. In the progressive mode the gateway can answer a preview with a refinement request instead, asking for a larger image of the same
+capture.
+The gateway counterpart is Gateway_examples/frame_codec.py.
+*/
+#include "frame_codec.h"
+#include <string.h>
+
+static void put_u16(uint8_t* out, uint16_t value)
+{
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+static uint16_t get_u16(const uint8_t* data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+//CRC-16/CCITT-FALSE (polynomial 0x1021), start with crc = 0xFFFF
+uint16_t frame_crc16(const uint8_t* data, int length, uint16_t crc)
+{
+    for(int i = 0; i < length; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for(int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+//Writes the header and payload into out (FRAME_HEADER_LENGTH + payload_length bytes), returns the message length
+int frame_encode_chunk(uint8_t* out, uint8_t frame_id, uint16_t index, uint16_t total_length, const uint8_t* payload, int payload_length)
+{
+    out[0] = FRAME_DATA;
+    out[1] = frame_id;
+    put_u16(out + 2, index);
+    put_u16(out + 4, total_length);
+    memcpy(out + FRAME_HEADER_LENGTH, payload, payload_length);
+
+    uint16_t crc = frame_crc16(out, 6, 0xFFFF);
+    crc = frame_crc16(payload, payload_length, crc);
+    put_u16(out + 6, crc);
+    return FRAME_HEADER_LENGTH + payload_length;
+}
+
+//Returns false if the message is not a data chunk or the CRC does not match, the payload points into data
+bool frame_decode_chunk(const uint8_t* data, int length, struct FrameChunk* chunk)
+{
+    if(length <= FRAME_HEADER_LENGTH || data[0] != FRAME_DATA)
+    {
+        return false;
+    }
+    uint16_t crc = frame_crc16(data, 6, 0xFFFF);
+    crc = frame_crc16(data + FRAME_HEADER_LENGTH, length - FRAME_HEADER_LENGTH, crc);
+    if(crc != get_u16(data + 6))
+    {
+        return false;
+    }
+    chunk->frame_id = data[1];
+    chunk->index = get_u16(data + 2);
+    chunk->total_length = get_u16(data + 4);
+    chunk->payload = data + FRAME_HEADER_LENGTH;
+    chunk->payload_length = length - FRAME_HEADER_LENGTH;
+    return true;
+}
+
+int frame_encode_ack(uint8_t* out, uint8_t frame_id, uint16_t next, uint16_t mtu)
+{
+    out[0] = FRAME_ACK;
+    out[1] = frame_id;
+    put_u16(out + 2, next);
+    put_u16(out + 4, mtu);
+    return FRAME_ACK_LENGTH;
+}
+
+int frame_encode_nack(uint8_t* out, uint8_t frame_id, uint16_t next, uint16_t mtu, uint8_t span, uint32_t missing)
+{
+    frame_encode_ack(out, frame_id, next, mtu);
+    out[0] = FRAME_NACK;
+    out[6] = span;
+    put_u16(out + 7, missing & 0xFFFF);
+    put_u16(out + 9, missing >> 16);
+    return FRAME_NACK_LENGTH;
+}
+
+//Decodes both acknowledgement types, a FRAME_ACK is returned with an empty bitmap
+bool frame_decode_ack(const uint8_t* data, int length, struct FrameAck* ack)
+{
+    bool nack = length == FRAME_NACK_LENGTH && data[0] == FRAME_NACK;
+    if(!nack && (length != FRAME_ACK_LENGTH || data[0] != FRAME_ACK))
+    {
+        return false;
+    }
+    ack->frame_id = data[1];
+    ack->next = get_u16(data + 2);
+    ack->mtu = get_u16(data + 4);
+    ack->span = 0;
+    ack->missing = 0;
+    if(nack)
+    {
+        ack->span = data[6] < FRAME_NACK_SPAN ? data[6] : FRAME_NACK_SPAN;
+        ack->missing = get_u16(data + 7) | ((uint32_t)get_u16(data + 9) << 16);
+    }
+    return true;
+}
+
+int frame_encode_result(uint8_t* out, const struct FrameResult* result)
+{
+    out[0] = FRAME_RESULT;
+    out[1] = result->frame_id;
+    put_u16(out + 2, result->score);
+    put_u16(out + 4, result->latency_ms);
+    out[6] = result->flags;
+    memcpy(out + 7, result->box, 4);
+    return FRAME_RESULT_LENGTH;
+}
+
+//Returns false if the message is not a result, scores above 1000 are clamped
+bool frame_decode_result(const uint8_t* data, int length, struct FrameResult* result)
+{
+    if(length != FRAME_RESULT_LENGTH || data[0] != FRAME_RESULT)
+    {
+        return false;
+    }
+    result->frame_id = data[1];
+    result->score = get_u16(data + 2) > 1000 ? 1000 : get_u16(data + 2);
+    result->latency_ms = get_u16(data + 4);
+    result->flags = data[6];
+    memcpy(result->box, data + 7, 4);
+    return true;
+}
+
+//Checks a message received after the frame frame_id was sent, result is only filled in for FRAME_MATCH_ACCEPTED.
+//received tells whether the result of the frame was already taken.
+int frame_match_result(const uint8_t* data, int length, uint8_t frame_id, bool received, struct FrameResult* result)
+{
+    struct FrameResult decoded;
+    if(!frame_decode_result(data, length, &decoded))
+    {
+        return FRAME_MATCH_NONE;
+    }
+    //A late result of an earlier frame (or a repeated one) must not be taken for the result of the frame just sent
+    if(decoded.frame_id != frame_id || received)
+    {
+        return FRAME_MATCH_STALE;
+    }
+    *result = decoded;
+    return FRAME_MATCH_ACCEPTED;
+}
+
+int frame_encode_refine(uint8_t* out, uint8_t frame_id)
+{
+    out[0] = FRAME_REFINE;
+    out[1] = frame_id;
+    return FRAME_REFINE_LENGTH;
+}
+
+bool frame_decode_refine(const uint8_t* data, int length, uint8_t* frame_id)
+{
+    if(length != FRAME_REFINE_LENGTH || data[0] != FRAME_REFINE)
+    {
+        return false;
+    }
+    *frame_id = data[1];
+    return true;
+}
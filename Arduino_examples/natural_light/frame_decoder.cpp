@@ -0,0 +1,94 @@
+/*
+This script turns a JPEG frame of the camera into the input of the models. The frame is decoded MCU by MCU with the JPEGDecoder library, the center of the
+image is kept and every pixel is converted to luma and mapped to the quantized input value by the table of input_lut.cpp. It takes the JPEG data as
+arguments and does not touch the camera, so the same decoding runs in the sketch (arduino_image_provider.cpp) and in the host benchmark
+(Host_tools/host_benchmark), where JPEGDecoder.h is a shim over picojpeg with the same interface.
+*/
+#include "frame_decoder.h"
+#include "input_lut.h"
+
+// JPEGDecoder library
+#include <JPEGDecoder.h>
+
+// Decode the JPEG image, crop it, and convert it to greyscale mapped through lut (see input_lut.cpp)
+TfLiteStatus DecodeAndProcessImage(tflite::ErrorReporter* error_reporter,
+                                   const uint8_t* jpeg, int length,
+                                   int image_width, int image_height,
+                                   int8_t* image_data, const int8_t* lut) {
+  //Serial.println("I am decoding and processing the captured image!");
+  //TF_LITE_REPORT_ERROR(error_reporter,
+                       //"Decoding JPEG and converting to greyscale");
+  // Parse the JPEG headers. The image will be decoded as a sequence of Minimum
+  // Coded Units (MCUs), which are 16x8 blocks of pixels.
+  JpegDec.decodeArray(jpeg, length);
+
+  // Crop the image by keeping a certain number of MCUs in each dimension
+  const int keep_x_mcus = image_width / JpegDec.MCUWidth;
+  const int keep_y_mcus = image_height / JpegDec.MCUHeight;
+
+  // Calculate how many MCUs we will throw away on the x axis
+  const int skip_x_mcus = JpegDec.MCUSPerRow - keep_x_mcus;
+  // Roughly center the crop by skipping half the throwaway MCUs at the
+  // beginning of each row
+  const int skip_start_x_mcus = skip_x_mcus / 2;
+  // Index where we will start throwing away MCUs after the data
+  const int skip_end_x_mcu_index = skip_start_x_mcus + keep_x_mcus;
+  // Same approach for the columns
+  const int skip_y_mcus = JpegDec.MCUSPerCol - keep_y_mcus;
+  const int skip_start_y_mcus = skip_y_mcus / 2;
+  const int skip_end_y_mcu_index = skip_start_y_mcus + keep_y_mcus;
+
+  // Pointer to the current pixel
+  uint16_t* pImg;
+  // Color of the current pixel
+  uint16_t color;
+
+  // Loop over the MCUs
+  while (JpegDec.read()) {
+    // Skip over the initial set of rows
+    if (JpegDec.MCUy < skip_start_y_mcus) {
+      continue;
+    }
+    // Skip if we're on a column that we don't want
+    if (JpegDec.MCUx < skip_start_x_mcus ||
+        JpegDec.MCUx >= skip_end_x_mcu_index) {
+      continue;
+    }
+    // Skip if we've got all the rows we want
+    if (JpegDec.MCUy >= skip_end_y_mcu_index) {
+      continue;
+    }
+    // Pointer to the current pixel
+    pImg = JpegDec.pImage;
+
+    // The x and y indexes of the current MCU, ignoring the MCUs we skip
+    int relative_mcu_x = JpegDec.MCUx - skip_start_x_mcus;
+    int relative_mcu_y = JpegDec.MCUy - skip_start_y_mcus;
+
+    // The coordinates of the top left of this MCU when applied to the output
+    // image
+    int x_origin = relative_mcu_x * JpegDec.MCUWidth;
+    int y_origin = relative_mcu_y * JpegDec.MCUHeight;
+
+    // Loop through the MCU's rows and columns
+    for (int mcu_row = 0; mcu_row < JpegDec.MCUHeight; mcu_row++) {
+      // The y coordinate of this pixel in the output index
+      int current_y = y_origin + mcu_row;
+      for (int mcu_col = 0; mcu_col < JpegDec.MCUWidth; mcu_col++) {
+        // Read the color of the pixel as 16-bit integer
+        color = *pImg++;
+        // Luminance in fixed point (see https://en.wikipedia.org/wiki/Grayscale for magic numbers),
+        // normalized and quantized to the input tensor by one table lookup
+        int8_t value = lut[input_lut_luma(color)];
+
+        // The x coordinate of this pixel in the output image
+        int current_x = x_origin + mcu_col;
+        // The index of this pixel in our flat output buffer
+        int index = (current_y * image_width) + current_x;
+        image_data[index] = value;
+      }
+    }
+  }
+  //TF_LITE_REPORT_ERROR(error_reporter, "Image decoded and processed");
+  return kTfLiteOk;
+}
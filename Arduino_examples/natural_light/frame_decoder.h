@@ -0,0 +1,12 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_FRAME_DECODER_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_FRAME_DECODER_H_
+
+#include <stdint.h>
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+
+//Decodes a JPEG frame, crops its center to image_width x image_height and maps every pixel through lut (see input_lut.cpp)
+extern TfLiteStatus DecodeAndProcessImage(tflite::ErrorReporter* error_reporter, const uint8_t* jpeg, int length, int image_width, int image_height,
+                                          int8_t* image_data, const int8_t* lut);
+
+#endif
@@ -4,9 +4,18 @@
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/micro/micro_error_reporter.h"
 
+// The size of our temporary buffer for holding
+// JPEG data received from the Arducam module
+#define MAX_JPEG_BYTES 4096
+
 TfLiteStatus GetImage(tflite::ErrorReporter* error_reporter, int image_width, int image_height, int channels, int8_t* image_data);
+extern TfLiteStatus capture_image(tflite::ErrorReporter* error_reporter);
+extern TfLiteStatus decode_image(tflite::ErrorReporter* error_reporter, int image_width, int image_height, int8_t* image_data, const int8_t* lut);
 extern void initialize_camera(tflite::ErrorReporter* error_reporter, int image_width, int image_height, int channels, int8_t* image_data);
-extern unsigned char jpeg_buffer[4096];
+extern unsigned char* jpeg_buffer;
 extern int jpeg_length;                      
+//Luma to model input tables (see input_lut.cpp): quantized for the input tensor, and luma - 128 for the images sent to the gateway
+extern int8_t input_lut[256];
+extern int8_t luma_lut[256];
 
 #endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_IMAGE_PROVIDER_H_
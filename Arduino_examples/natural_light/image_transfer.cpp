@@ -0,0 +1,318 @@
+/*
+This script transfers the captured JPEG image to the IoT gateway over the txChar characteristic.
+
+Every chunk is framed (frame id, chunk index, total length and CRC, see frame_codec.cpp), so only jpeg_length bytes are sent and the gateway reassembles the image
+without guessing its end. In the original mode (TRANSFER_INDICATE) every chunk is sent as an indication, so every chunk waits for the confirmation from the gateway and
+the throughput is bounded by connection interval round trips. In the windowed mode (TRANSFER_NOTIFY_WINDOWED) chunks are sent as notifications, sized to the ATT MTU
+reported by the gateway, and up to TRANSFER_WINDOW chunks are in flight before the device waits for the gateway acknowledgement (flow control). The acknowledgement
+carries the next expected chunk; when the gateway sees a gap it sends a negative acknowledgement with a bitmap of the missing chunks, and only those are sent again.
+If no acknowledgement arrives in time, every chunk after the last acknowledged one that is not known to be received is sent again.
+The supply voltage is checked between windows (between chunks in the indicate mode). If the capacitor is drained mid-frame, the transfer pauses and the device sleeps
+until it is recharged, instead of browning out and wasting the energy already spent on the frame. An interrupted transfer (pause timeout or lost connection) keeps
+its state and is resumed from the last acknowledged chunk; after a reconnection the first acknowledgement of the gateway tells where its reassembly stopped.
+*/
+#include "application.h"
+#include "image_transfer.h"
+#include <string.h>
+
+struct TransferStats transfer_stats;
+
+static uint8_t frame_id = 0;
+static uint8_t chunk[TRANSFER_CHUNK_MAX];
+static volatile unsigned int acked_chunks = 0;
+static volatile unsigned int gateway_mtu = 0;
+static volatile bool resync = false;
+static bool transfer_pending = false;
+static unsigned int frame_payload = 0;
+//Per-chunk state of the current frame: received by the gateway (reported in a negative acknowledgement) and reported missing
+static uint8_t chunk_received[TRANSFER_MAX_CHUNKS / 8];
+static uint8_t chunk_lost[TRANSFER_MAX_CHUNKS / 8];
+static volatile bool nack_received = false;
+
+static void set_chunk_flag(uint8_t* flags, unsigned int index, bool value)
+{
+    if(index >= TRANSFER_MAX_CHUNKS)
+    {
+        return;
+    }
+    if(value)
+    {
+        flags[index / 8] |= 1 << (index % 8);
+    }
+    else
+    {
+        flags[index / 8] &= ~(1 << (index % 8));
+    }
+}
+
+static bool chunk_flag(const uint8_t* flags, unsigned int index)
+{
+    return index < TRANSFER_MAX_CHUNKS && (flags[index / 8] & (1 << (index % 8)));
+}
+
+static void clear_chunk_flags()
+{
+    memset(chunk_received, 0, sizeof(chunk_received));
+    memset(chunk_lost, 0, sizeof(chunk_lost));
+}
+
+//Called for every value written into rxChar, returns true if the message was a transfer acknowledgement
+bool transfer_on_message(const uint8_t* data, int length)
+{
+    struct FrameAck ack;
+    if(!frame_decode_ack(data, length, &ack))
+    {
+        return false;
+    }
+    gateway_mtu = ack.mtu;
+    if(resync)
+    {
+        //First acknowledgement after a reconnection: the gateway reports how much of the frame it kept
+        acked_chunks = (ack.frame_id == frame_id) ? ack.next : 0;
+        resync = false;
+    }
+    //Acknowledgements of an older frame only carry the MTU
+    else if(ack.frame_id == frame_id && ack.next > acked_chunks)
+    {
+        acked_chunks = ack.next;
+    }
+
+    if(ack.frame_id == frame_id && ack.span > 0)
+    {
+        for(unsigned int i = 0; i < ack.span; i++)
+        {
+            bool missing = ack.missing & ((uint32_t)1 << i);
+            set_chunk_flag(chunk_received, ack.next + i, !missing);
+            set_chunk_flag(chunk_lost, ack.next + i, missing);
+        }
+        nack_received = true;
+    }
+    return true;
+}
+
+static unsigned int chunk_size()
+{
+    unsigned int size = TRANSFER_CHUNK_DEFAULT;
+    if(gateway_mtu > 3)
+    {
+        size = gateway_mtu - 3;
+    }
+    if(size > TRANSFER_CHUNK_MAX)
+    {
+        size = TRANSFER_CHUNK_MAX;
+    }
+    return size;
+}
+
+//The MTU is negotiated for every connection, so it is forgotten when a new central connects
+void transfer_on_connect()
+{
+    gateway_mtu = 0;
+    resync = true;
+}
+
+//Sleeps until the capacitor is recharged, returns false if that takes longer than TRANSFER_MAX_PAUSE (the transfer state is kept)
+static bool wait_for_energy()
+{
+    if(read_voltage() >= TRANSFER_PAUSE_VOLTAGE)
+    {
+        return true;
+    }
+    unsigned long start = millis();
+    bool recharged = false;
+    while(!recharged && millis() - start < TRANSFER_MAX_PAUSE)
+    {
+        delay(TRANSFER_PAUSE_STEP);
+        BLE.poll();
+        recharged = read_voltage() >= TRANSFER_RESUME_VOLTAGE;
+    }
+    transfer_stats.paused_ms += millis() - start;
+    return recharged;
+}
+
+//Frames and sends the given chunk of the image, returns false if it could not be sent (for indications: not confirmed by the gateway)
+static bool send_chunk(const unsigned char* data, int length, unsigned int index, unsigned int payload)
+{
+    unsigned int offset = index * payload;
+    unsigned int bytes = (length - offset < payload) ? length - offset : payload;
+    int message_length = frame_encode_chunk(chunk, frame_id, index, length, data + offset, bytes);
+    transfer_stats.chunks++;
+    return txChar.writeValue(chunk, message_length);
+}
+
+//Waits until the gateway acknowledged at least the given number of chunks or reported missing chunks, returns false on timeout or disconnection
+static bool wait_for_ack(unsigned int chunks)
+{
+    unsigned long start = millis();
+    nack_received = false;
+    while(acked_chunks < chunks && !nack_received)
+    {
+        BLE.poll();
+        if(!BLE.connected() || millis() - start >= TRANSFER_ACK_TIMEOUT)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool transfer_indicate(const unsigned char* data, int length)
+{
+    unsigned int payload = TRANSFER_CHUNK_DEFAULT - FRAME_HEADER_LENGTH;
+    unsigned int total = (length + payload - 1) / payload;
+    //Every confirmed indication counts as acknowledged
+    while(acked_chunks < total)
+    {
+        if(!BLE.connected() || !wait_for_energy())
+        {
+            return false;
+        }
+        //A chunk lost with the connection is sent again when the transfer is resumed
+        if(!send_chunk(data, length, acked_chunks, payload))
+        {
+            return false;
+        }
+        acked_chunks++;
+    }
+    return true;
+}
+
+static bool transfer_windowed(const unsigned char* data, int length)
+{
+    //The gateway sends its first acknowledgement (with the negotiated MTU) right after subscribing
+    unsigned long start = millis();
+    while(gateway_mtu == 0 && BLE.connected() && millis() - start < TRANSFER_ACK_TIMEOUT)
+    {
+        BLE.poll();
+    }
+
+    //Chunk indices map to image offsets, so a resumed frame keeps its chunk size. If the new connection cannot carry it, the frame starts over.
+    unsigned int size = chunk_size();
+    if(frame_payload == 0 || frame_payload + FRAME_HEADER_LENGTH > size)
+    {
+        if(frame_payload != 0)
+        {
+            frame_id++;
+            acked_chunks = 0;
+        }
+        frame_payload = size - FRAME_HEADER_LENGTH;
+    }
+    unsigned int payload = frame_payload;
+    unsigned int total = (length + payload - 1) / payload;
+    unsigned int next = acked_chunks;
+    int retries = 0;
+    //Retransmissions of the first unacknowledged chunk, a chunk the gateway keeps reporting missing ends the transfer like a silent gateway
+    unsigned int base = acked_chunks;
+    int resends = 0;
+    transfer_stats.chunk_size = payload + FRAME_HEADER_LENGTH;
+    clear_chunk_flags();
+
+    while(acked_chunks < total)
+    {
+        if(!wait_for_energy())
+        {
+            return false;
+        }
+        if(acked_chunks != base)
+        {
+            base = acked_chunks;
+            resends = 0;
+        }
+        //Chunks reported missing are sent again first
+        for(unsigned int i = acked_chunks; i < next; i++)
+        {
+            if(chunk_flag(chunk_lost, i))
+            {
+                if(i == base && ++resends > TRANSFER_MAX_RESENDS)
+                {
+                    return false;
+                }
+                send_chunk(data, length, i, payload);
+                set_chunk_flag(chunk_lost, i, false);
+                transfer_stats.retransmitted++;
+            }
+        }
+        //Fill the window
+        while(next < total && next < acked_chunks + TRANSFER_WINDOW)
+        {
+            send_chunk(data, length, next, payload);
+            next++;
+        }
+
+        //The gateway acknowledges the whole frame as soon as all bytes of the announced total length arrived
+        unsigned int expected = (next == total) ? total : next - TRANSFER_WINDOW + 1;
+        if(!wait_for_ack(expected))
+        {
+            if(!BLE.connected() || ++retries > TRANSFER_MAX_RETRIES)
+            {
+                return false;
+            }
+            //No feedback from the gateway, every chunk in flight that is not known to be received is sent again
+            for(unsigned int i = acked_chunks; i < next; i++)
+            {
+                if(i >= TRANSFER_MAX_CHUNKS)
+                {
+                    //Not tracked, go back to this chunk
+                    transfer_stats.retransmitted += next - i;
+                    next = i;
+                    break;
+                }
+                if(!chunk_flag(chunk_received, i))
+                {
+                    set_chunk_flag(chunk_lost, i, true);
+                }
+            }
+        }
+        else
+        {
+            retries = 0;
+        }
+    }
+    return true;
+}
+
+//Sends the image, or resumes the interrupted transfer of the same image. Returns false if the transfer was interrupted, it can be resumed by
+//calling transfer_image() again or given up with transfer_abort().
+bool transfer_image(const unsigned char* data, int length)
+{
+    unsigned long start = millis();
+    if(!transfer_pending)
+    {
+        frame_id++;
+        acked_chunks = 0;
+        frame_payload = 0;
+        transfer_stats.duration_ms = 0;
+        transfer_stats.bytes = length;
+        transfer_stats.chunks = 0;
+        transfer_stats.retransmitted = 0;
+        transfer_stats.chunk_size = TRANSFER_CHUNK_DEFAULT;
+        transfer_stats.paused_ms = 0;
+        transfer_stats.resumes = 0;
+        transfer_pending = true;
+    }
+    else
+    {
+        transfer_stats.resumes++;
+    }
+
+#if TRANSFER_MODE == TRANSFER_NOTIFY_WINDOWED
+    bool delivered = transfer_windowed(data, length);
+#else
+    bool delivered = transfer_indicate(data, length);
+#endif
+
+    transfer_stats.duration_ms += millis() - start;
+    transfer_pending = !delivered;
+    return delivered;
+}
+
+void transfer_abort()
+{
+    transfer_pending = false;
+}
+
+//Frame id of the last (or current) transfer, the remote inference result of this frame carries the same id
+uint8_t transfer_frame_id()
+{
+    return frame_id;
+}
@@ -0,0 +1,55 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_IMAGE_TRANSFER_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_IMAGE_TRANSFER_H_
+
+#include <stdint.h>
+#include "frame_codec.h"
+
+//Transfer modes: every chunk (220 bytes including the frame header) confirmed by an indication (original), or notifications sent in
+//a sliding window and acknowledged periodically by the gateway. Both modes send framed chunks (see frame_codec.h).
+#define TRANSFER_INDICATE 0
+#define TRANSFER_NOTIFY_WINDOWED 1
+#ifndef TRANSFER_MODE
+#define TRANSFER_MODE TRANSFER_NOTIFY_WINDOWED
+#endif
+
+//Chunks in flight before the device waits for an acknowledgement
+#define TRANSFER_WINDOW 4
+//Chunk size (frame header included) used until the gateway reports the negotiated ATT MTU, and the largest chunk (ATT MTU 247 - 3 bytes header)
+#define TRANSFER_CHUNK_DEFAULT 220
+#define TRANSFER_CHUNK_MAX 244
+#define TRANSFER_ACK_TIMEOUT 2000
+//Chunks tracked for selective retransmission (MAX_JPEG_BYTES in chunks of the default size, chunks beyond are sent again go-back-N style)
+#define TRANSFER_MAX_CHUNKS 128
+//Acknowledgement timeouts in a row, and retransmissions of the first unacknowledged chunk, before the transfer is interrupted. The gateway
+//acknowledges only every few chunks, so a retransmission that arrived can still end in a timeout: the chunk gets more attempts than the timeouts.
+#define TRANSFER_MAX_RETRIES 3
+#define TRANSFER_MAX_RESENDS 8
+
+//The supply voltage is checked between windows: below TRANSFER_PAUSE_VOLTAGE mV the transfer pauses (the device sleeps in TRANSFER_PAUSE_STEP ms
+//steps, the transfer state is kept) until the capacitor is recharged to TRANSFER_RESUME_VOLTAGE mV, or gives up after TRANSFER_MAX_PAUSE ms
+#define TRANSFER_PAUSE_VOLTAGE 3800
+#define TRANSFER_RESUME_VOLTAGE 3950
+#define TRANSFER_PAUSE_STEP 3000
+#define TRANSFER_MAX_PAUSE 60000
+//Number of times an interrupted transfer is resumed (after a reconnection or a pause) before the frame is given up
+#define TRANSFER_MAX_RESUMES 3
+
+struct TransferStats
+{
+    unsigned long duration_ms;
+    unsigned int bytes;
+    unsigned int chunks;
+    unsigned int retransmitted;
+    unsigned int chunk_size;
+    unsigned long paused_ms;
+    unsigned int resumes;
+};
+
+extern struct TransferStats transfer_stats;
+extern void transfer_on_connect();
+extern bool transfer_on_message(const uint8_t* data, int length);
+extern bool transfer_image(const unsigned char* data, int length);
+extern void transfer_abort();
+extern uint8_t transfer_frame_id();
+
+#endif
@@ -0,0 +1,26 @@
+/*
+This script prepares the conversion of the decoded camera pixels into the model input. The luma of a pixel is computed in integer arithmetic
+(input_lut_luma) and a 256-entry table maps it to the quantized input value, so normalization (to -1..1) and quantization with the scale and zero point
+of the input tensor are one lookup per pixel. The table is rebuilt from input->params whenever the interpreter is set up, so a model with a different input
+quantization needs no change of the decoder. For the person model (scale 2/255, zero point -1) the table is luma - 128.
+*/
+#include "input_lut.h"
+#include <math.h>
+
+//Fills lut[256] with round((luma - INPUT_LUT_OFFSET) / INPUT_LUT_RANGE / scale) + zero_point, saturated to int8 as the TFLite quantizer does
+void input_lut_build(int8_t* lut, float scale, int zero_point)
+{
+    for(int luma = 0; luma < 256; luma++)
+    {
+        int value = (scale > 0.0f) ? (int)lroundf((luma - INPUT_LUT_OFFSET) / INPUT_LUT_RANGE / scale) + zero_point : luma - 128;
+        if(value < -128)
+        {
+            value = -128;
+        }
+        if(value > 127)
+        {
+            value = 127;
+        }
+        lut[luma] = (int8_t)value;
+    }
+}
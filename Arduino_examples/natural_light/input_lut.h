@@ -0,0 +1,28 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_INPUT_LUT_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_INPUT_LUT_H_
+
+#include <stdint.h>
+
+//Luminance weights (0.2126, 0.7152, 0.0722) in 16-bit fixed point, they sum up to 65536 so white stays 255
+#define INPUT_LUT_WEIGHT_R 13933
+#define INPUT_LUT_WEIGHT_G 46871
+#define INPUT_LUT_WEIGHT_B 4732
+//Normalized input the models take, (luma - INPUT_LUT_OFFSET) / INPUT_LUT_RANGE, -1..1. It is what the person model sees as luma - 128
+//with its input quantization (scale 1 / 127.5, zero point -1), which is also the quantization that builds the plain luma - 128 table.
+#define INPUT_LUT_OFFSET 127
+#define INPUT_LUT_RANGE 127.5f
+#define INPUT_LUT_LUMA_SCALE (1.0f / INPUT_LUT_RANGE)
+#define INPUT_LUT_LUMA_ZERO_POINT -1
+
+//Rounded luma (0..255) of a decoded RGB565 pixel, expanded to 8 bits per channel as before (r * 8, g * 4, b * 8)
+static inline uint8_t input_lut_luma(uint16_t color)
+{
+    uint32_t r = ((color & 0xF800) >> 11) * 8;
+    uint32_t g = ((color & 0x07E0) >> 5) * 4;
+    uint32_t b = (color & 0x001F) * 8;
+    return (uint8_t)((INPUT_LUT_WEIGHT_R * r + INPUT_LUT_WEIGHT_G * g + INPUT_LUT_WEIGHT_B * b + 32768) >> 16);
+}
+
+extern void input_lut_build(int8_t* lut, float scale, int zero_point);
+
+#endif
@@ -0,0 +1,361 @@
+/*
+This script encodes the decoded grayscale frame (int8 luma, the same format as the model input) into a small baseline JPEG. The camera JPEG is
+160x120 in colour, while the gateway only needs the 96x96 crop the model sees, so a re-encoded grayscale thumbnail is several times smaller and
+the radio (the largest energy cost of the offload path) is on for a shorter time. The encoder writes one component with the standard luminance
+quantization table scaled to the requested quality (as libjpeg does) and the standard Huffman tables, so any decoder on the gateway can read it.
+The frame can be downscaled first (2x2 or 4x4 pixel averaging) to trade detail for an even smaller payload.
+*/
+#include "jpeg_encoder.h"
+#include <math.h>
+
+//Natural order index of the coefficients in the zig-zag order
+static const uint8_t zigzag[64] = {
+    0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+   12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+   35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+   58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+//Luminance quantization table of the JPEG standard (Annex K), natural order
+static const uint8_t base_quant[64] = {
+   16, 11, 10, 16, 24, 40, 51, 61,
+   12, 12, 14, 19, 26, 58, 60, 55,
+   14, 13, 16, 24, 40, 57, 69, 56,
+   14, 17, 22, 29, 51, 87, 80, 62,
+   18, 22, 37, 56, 68,109,103, 77,
+   24, 35, 55, 64, 81,104,113, 92,
+   49, 64, 78, 87,103,121,120,101,
+   72, 92, 95, 98,112,100,103, 99
+};
+
+//Luminance Huffman tables of the JPEG standard: number of codes of every length (1 - 16 bits) and the symbols
+static const uint8_t dc_bits[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t dc_values[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+static const uint8_t ac_bits[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D};
+static const uint8_t ac_values[162] = {
+   0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+   0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+   0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+   0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+   0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+   0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+   0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+   0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+   0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+   0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+   0xF9, 0xFA
+};
+
+//Huffman code and its length for every symbol, built from the tables above
+static uint16_t dc_code[12];
+static uint8_t dc_length[12];
+static uint16_t ac_code[256];
+static uint8_t ac_length[256];
+static bool tables_ready = false;
+
+//cos((2x + 1) * u * pi / 16) * C(u) / 2, indexed by [u][x]
+static float dct_table[8][8];
+
+struct BitWriter
+{
+    uint8_t* out;
+    int length;
+    int max_length;
+    uint32_t buffer;
+    int bits;
+    bool overflow;
+};
+
+static void build_codes(const uint8_t* bits, const uint8_t* values, uint16_t* code, uint8_t* length)
+{
+    uint16_t next = 0;
+    int k = 0;
+    for(int size = 1; size <= 16; size++)
+    {
+        for(int i = 0; i < bits[size - 1]; i++)
+        {
+            code[values[k]] = next++;
+            length[values[k]] = size;
+            k++;
+        }
+        next <<= 1;
+    }
+}
+
+static void init_tables()
+{
+    build_codes(dc_bits, dc_values, dc_code, dc_length);
+    build_codes(ac_bits, ac_values, ac_code, ac_length);
+    for(int u = 0; u < 8; u++)
+    {
+        float scale = u == 0 ? sqrtf(0.5f) / 2 : 0.5f;
+        for(int x = 0; x < 8; x++)
+        {
+            dct_table[u][x] = scale * cosf((2 * x + 1) * u * (float)M_PI / 16);
+        }
+    }
+    tables_ready = true;
+}
+
+static void put_byte(struct BitWriter* writer, uint8_t value)
+{
+    if(writer->length >= writer->max_length)
+    {
+        writer->overflow = true;
+        return;
+    }
+    writer->out[writer->length++] = value;
+}
+
+static void put_u16(struct BitWriter* writer, uint16_t value)
+{
+    put_byte(writer, value >> 8);
+    put_byte(writer, value & 0xFF);
+}
+
+static void put_bits(struct BitWriter* writer, uint16_t code, int size)
+{
+    writer->buffer = (writer->buffer << size) | (code & ((1u << size) - 1));
+    writer->bits += size;
+    while(writer->bits >= 8)
+    {
+        uint8_t value = (writer->buffer >> (writer->bits - 8)) & 0xFF;
+        put_byte(writer, value);
+        //A 0xFF byte in the entropy coded data is followed by a stuffed zero byte
+        if(value == 0xFF)
+        {
+            put_byte(writer, 0);
+        }
+        writer->bits -= 8;
+    }
+}
+
+//Number of bits of the magnitude (JPEG category) of a coefficient
+static int category(int value)
+{
+    if(value < 0)
+    {
+        value = -value;
+    }
+    int size = 0;
+    while(value)
+    {
+        size++;
+        value >>= 1;
+    }
+    return size;
+}
+
+static void put_value(struct BitWriter* writer, int value, int size)
+{
+    //Negative values are sent as the one's complement of their magnitude
+    put_bits(writer, value < 0 ? value + (1 << size) - 1 : value, size);
+}
+
+static void write_headers(struct BitWriter* writer, int width, int height, const uint8_t* quant)
+{
+    //SOI and a minimal JFIF APP0 segment
+    put_u16(writer, 0xFFD8);
+    put_u16(writer, 0xFFE0);
+    put_u16(writer, 16);
+    static const uint8_t jfif[14] = {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0};
+    for(int i = 0; i < 14; i++)
+    {
+        put_byte(writer, jfif[i]);
+    }
+
+    //DQT: one 8-bit table (id 0) in zig-zag order
+    put_u16(writer, 0xFFDB);
+    put_u16(writer, 67);
+    put_byte(writer, 0);
+    for(int i = 0; i < 64; i++)
+    {
+        put_byte(writer, quant[zigzag[i]]);
+    }
+
+    //SOF0: 8-bit precision, one component (id 1, no subsampling, quantization table 0)
+    put_u16(writer, 0xFFC0);
+    put_u16(writer, 11);
+    put_byte(writer, 8);
+    put_u16(writer, height);
+    put_u16(writer, width);
+    put_byte(writer, 1);
+    put_byte(writer, 1);
+    put_byte(writer, 0x11);
+    put_byte(writer, 0);
+
+    //DHT: DC table 0 and AC table 0
+    put_u16(writer, 0xFFC4);
+    put_u16(writer, 2 + 1 + 16 + sizeof(dc_values) + 1 + 16 + sizeof(ac_values));
+    put_byte(writer, 0x00);
+    for(int i = 0; i < 16; i++)
+    {
+        put_byte(writer, dc_bits[i]);
+    }
+    for(unsigned int i = 0; i < sizeof(dc_values); i++)
+    {
+        put_byte(writer, dc_values[i]);
+    }
+    put_byte(writer, 0x10);
+    for(int i = 0; i < 16; i++)
+    {
+        put_byte(writer, ac_bits[i]);
+    }
+    for(unsigned int i = 0; i < sizeof(ac_values); i++)
+    {
+        put_byte(writer, ac_values[i]);
+    }
+
+    //SOS: one component using the Huffman tables 0, full spectral range
+    put_u16(writer, 0xFFDA);
+    put_u16(writer, 8);
+    put_byte(writer, 1);
+    put_byte(writer, 1);
+    put_byte(writer, 0x00);
+    put_byte(writer, 0);
+    put_byte(writer, 63);
+    put_byte(writer, 0);
+}
+
+//Transforms and quantizes one 8x8 block (the samples are already level shifted, int8 luma is pixel - 128) and writes its Huffman codes.
+//Returns the DC coefficient, which the next block is coded against.
+static int encode_block(struct BitWriter* writer, const int8_t* luma, int stride, const uint8_t* quant, int previous_dc)
+{
+    float rows[8][8];
+    int coefficients[64];
+
+    for(int y = 0; y < 8; y++)
+    {
+        for(int u = 0; u < 8; u++)
+        {
+            float sum = 0;
+            for(int x = 0; x < 8; x++)
+            {
+                sum += dct_table[u][x] * luma[y * stride + x];
+            }
+            rows[y][u] = sum;
+        }
+    }
+    for(int u = 0; u < 8; u++)
+    {
+        for(int v = 0; v < 8; v++)
+        {
+            float sum = 0;
+            for(int y = 0; y < 8; y++)
+            {
+                sum += dct_table[v][y] * rows[y][u];
+            }
+            coefficients[v * 8 + u] = (int)lroundf(sum / quant[v * 8 + u]);
+        }
+    }
+
+    int diff = coefficients[0] - previous_dc;
+    int size = category(diff);
+    put_bits(writer, dc_code[size], dc_length[size]);
+    put_value(writer, diff, size);
+
+    int run = 0;
+    for(int i = 1; i < 64; i++)
+    {
+        int value = coefficients[zigzag[i]];
+        if(value == 0)
+        {
+            run++;
+            continue;
+        }
+        //Runs longer than 15 zeros are split with ZRL symbols
+        while(run > 15)
+        {
+            put_bits(writer, ac_code[0xF0], ac_length[0xF0]);
+            run -= 16;
+        }
+        size = category(value);
+        int symbol = (run << 4) | size;
+        put_bits(writer, ac_code[symbol], ac_length[symbol]);
+        put_value(writer, value, size);
+        run = 0;
+    }
+    if(run > 0)
+    {
+        //End of block
+        put_bits(writer, ac_code[0x00], ac_length[0x00]);
+    }
+    return coefficients[0];
+}
+
+//Averages factor x factor pixels in place, the result is (width / factor) x (height / factor) at the start of luma
+void jpeg_downscale(int8_t* luma, int width, int height, int factor)
+{
+    if(factor <= 1)
+    {
+        return;
+    }
+    int out_width = width / factor;
+    int out_height = height / factor;
+    //Every output pixel is written at or before the first input pixel it reads, so the buffer can be reused
+    for(int y = 0; y < out_height; y++)
+    {
+        for(int x = 0; x < out_width; x++)
+        {
+            int sum = 0;
+            for(int dy = 0; dy < factor; dy++)
+            {
+                for(int dx = 0; dx < factor; dx++)
+                {
+                    sum += luma[(y * factor + dy) * width + x * factor + dx];
+                }
+            }
+            luma[y * out_width + x] = (int8_t)(sum / (factor * factor));
+        }
+    }
+}
+
+//Encodes width x height int8 luma (both multiples of 8) as a baseline grayscale JPEG at the given quality (1 - 100).
+//Returns the JPEG length, or -1 if it does not fit into max_length bytes.
+int jpeg_encode_gray(const int8_t* luma, int width, int height, int quality, uint8_t* out, int max_length)
+{
+    if(width % 8 != 0 || height % 8 != 0 || width <= 0 || height <= 0)
+    {
+        return -1;
+    }
+    if(!tables_ready)
+    {
+        init_tables();
+    }
+
+    //Quality scaling of the standard table as in libjpeg
+    if(quality < 1)
+    {
+        quality = 1;
+    }
+    if(quality > 100)
+    {
+        quality = 100;
+    }
+    int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    uint8_t quant[64];
+    for(int i = 0; i < 64; i++)
+    {
+        int value = (base_quant[i] * scale + 50) / 100;
+        quant[i] = value < 1 ? 1 : (value > 255 ? 255 : value);
+    }
+
+    struct BitWriter writer = {out, 0, max_length, 0, 0, false};
+    write_headers(&writer, width, height, quant);
+
+    int dc = 0;
+    for(int y = 0; y < height && !writer.overflow; y += 8)
+    {
+        for(int x = 0; x < width; x += 8)
+        {
+            dc = encode_block(&writer, luma + y * width + x, width, quant, dc);
+        }
+    }
+    //Pad the last byte with ones
+    if(writer.bits > 0)
+    {
+        put_bits(&writer, 0x7F, 8 - writer.bits);
+    }
+    put_u16(&writer, 0xFFD9);
+    return writer.overflow ? -1 : writer.length;
+}
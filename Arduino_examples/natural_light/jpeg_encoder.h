@@ -0,0 +1,15 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_JPEG_ENCODER_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_JPEG_ENCODER_H_
+
+#include <stdint.h>
+
+//Quality used when no other value is given (1 - 100, as in libjpeg)
+#define JPEG_QUALITY_DEFAULT 50
+//Length of the headers written in front of the entropy coded data (SOI, APP0, DQT, SOF0, DHT, SOS) and of the EOI marker
+#define JPEG_HEADER_LENGTH 324
+#define JPEG_TRAILER_LENGTH 2
+
+extern void jpeg_downscale(int8_t* luma, int width, int height, int factor);
+extern int jpeg_encode_gray(const int8_t* luma, int width, int height, int quality, uint8_t* out, int max_length);
+
+#endif
@@ -0,0 +1,66 @@
+/*
+This script keeps a running distribution of the measured offload (remote inference) latency. Every send_image cycle is timestamped from the moment the BLE stack is brought up
+until the result is received from the gateway (or until the transfer ends if no result arrives), and the duration is stored in a small ring of the most recent samples.
+The deadline check in the scheduler uses a chosen percentile of this distribution instead of the constant execution time measured once with the Power Profiler Kit 2.
+*/
+#include "latency_model.h"
+
+void latency_reset(struct LatencyModel *model)
+{
+    model->count = 0;
+    model->next = 0;
+    model->last = 0;
+}
+
+void latency_record(struct LatencyModel *model, unsigned long sample)
+{
+    model->samples[model->next] = sample;
+    model->next = (model->next + 1) % LATENCY_WINDOW;
+    if(model->count < LATENCY_WINDOW)
+    {
+        model->count++;
+    }
+    model->last = sample;
+}
+
+//Returns the requested percentile (nearest-rank) of the stored samples, or the fallback value until the first cycle was measured
+unsigned long latency_percentile(const struct LatencyModel *model, int percentile, unsigned long fallback)
+{
+    if(model->count == 0)
+    {
+        return fallback;
+    }
+
+    unsigned long sorted[LATENCY_WINDOW];
+    for(unsigned int i = 0; i < model->count; i++)
+    {
+        sorted[i] = model->samples[i];
+    }
+    //Insertion sort, the window is small
+    for(unsigned int i = 1; i < model->count; i++)
+    {
+        unsigned long value = sorted[i];
+        int j = i - 1;
+        while(j >= 0 && sorted[j] > value)
+        {
+            sorted[j + 1] = sorted[j];
+            j--;
+        }
+        sorted[j + 1] = value;
+    }
+
+    if(percentile < 0)
+    {
+        percentile = 0;
+    }
+    if(percentile > 100)
+    {
+        percentile = 100;
+    }
+    unsigned int rank = (percentile * model->count + 99) / 100;
+    if(rank == 0)
+    {
+        rank = 1;
+    }
+    return sorted[rank - 1];
+}
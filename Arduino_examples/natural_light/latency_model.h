@@ -0,0 +1,21 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_LATENCY_MODEL_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_LATENCY_MODEL_H_
+
+//Number of the most recent offload cycles kept in the latency distribution
+#define LATENCY_WINDOW 16
+//Percentile of the distribution used by the deadline check (90 -> p90)
+#define LATENCY_PERCENTILE 90
+
+struct LatencyModel
+{
+    unsigned long samples[LATENCY_WINDOW];
+    unsigned int count;
+    unsigned int next;
+    unsigned long last;
+};
+
+extern void latency_reset(struct LatencyModel *model);
+extern void latency_record(struct LatencyModel *model, unsigned long sample);
+extern unsigned long latency_percentile(const struct LatencyModel *model, int percentile, unsigned long fallback);
+
+#endif
@@ -0,0 +1,122 @@
+/*
+This script reads the model store, a flash region with several .tflite model variants next to the sketch. Every variant has an entry with its version, the
+tensor arena it needs, its input shape and the operators it uses, so the sketch can check before loading a model that the op resolver registers all of them,
+that it fits into the arena and that it takes the decoded frame as input. The flash is memory mapped, so the models are used in place without copying.
+The scheduler selects the model by the capacitor voltage before every local inference: the compiled-in model with enough energy, otherwise a variant
+(the entries are ordered from the most accurate variant to the cheapest one), and the interpreter is rebuilt when the selection changes, without a reboot.
+*/
+#include "model_store.h"
+#include <string.h>
+
+//CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320), start with crc = 0 (the same as zlib.crc32)
+uint32_t model_store_crc32(const uint8_t* data, uint32_t length, uint32_t crc)
+{
+    crc = ~crc;
+    for(uint32_t i = 0; i < length; i++)
+    {
+        crc ^= data[i];
+        for(int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+//Checks the store at base (size bytes of flash), returns the number of models or -1 if the region holds no valid store
+int model_store_open(struct ModelStore* store, const uint8_t* base, uint32_t size)
+{
+    store->base = base;
+    store->entries = nullptr;
+    store->count = 0;
+
+    struct ModelStoreHeader header;
+    memcpy(&header, base, sizeof(header));
+    if(header.magic != MODEL_STORE_MAGIC || header.format != MODEL_STORE_FORMAT || header.count > MODEL_STORE_MAX_MODELS)
+    {
+        return -1;
+    }
+    uint32_t table_end = MODEL_STORE_HEADER_LENGTH + MODEL_STORE_MAX_MODELS * MODEL_STORE_ENTRY_LENGTH;
+    if(header.length < table_end || header.length > size)
+    {
+        return -1;
+    }
+    if(model_store_crc32(base + MODEL_STORE_HEADER_LENGTH, header.length - MODEL_STORE_HEADER_LENGTH, 0) != header.crc)
+    {
+        return -1;
+    }
+    const struct ModelEntry* entries = (const struct ModelEntry*)(base + MODEL_STORE_HEADER_LENGTH);
+    for(int i = 0; i < header.count; i++)
+    {
+        const struct ModelEntry* entry = &entries[i];
+        //The offset is checked against the store length first, so the remaining length cannot wrap around
+        if(entry->offset < table_end || entry->offset > header.length || entry->offset % MODEL_STORE_ALIGNMENT != 0 ||
+           entry->length > header.length - entry->offset ||
+           entry->op_count > MODEL_STORE_MAX_OPS)
+        {
+            return -1;
+        }
+    }
+    store->entries = entries;
+    store->count = header.count;
+    return store->count;
+}
+
+//The .tflite blob of an entry, to be passed to tflite::GetModel()
+const uint8_t* model_store_data(const struct ModelStore* store, int index)
+{
+    if(index < 0 || index >= store->count)
+    {
+        return nullptr;
+    }
+    return store->base + store->entries[index].offset;
+}
+
+//A variant can be loaded if the resolver registers all its operators, it fits into the arena and takes the same int8 input as the compiled-in model
+bool model_store_compatible(const struct ModelEntry* entry, const uint8_t* ops, int op_count, uint32_t arena_size, int height, int width, int channels)
+{
+    if(entry->arena_bytes > arena_size || entry->input_type != 9 ||
+       entry->input_height != height || entry->input_width != width || entry->input_channels != channels)
+    {
+        return false;
+    }
+    for(int i = 0; i < entry->op_count; i++)
+    {
+        bool found = false;
+        for(int j = 0; j < op_count && !found; j++)
+        {
+            found = entry->ops[i] == ops[j];
+        }
+        if(!found)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//Returns -1 (the compiled-in model) at or above MODEL_STORE_FULL_MODEL_VOLTAGE, otherwise the first compatible variant whose min_voltage is
+//reached or the cheapest compatible one if the voltage is below all of them; -1 as well if no variant can be loaded
+int model_store_select(const struct ModelStore* store, int voltage, const uint8_t* ops, int op_count, uint32_t arena_size,
+                       int height, int width, int channels)
+{
+    if(voltage >= MODEL_STORE_FULL_MODEL_VOLTAGE)
+    {
+        return -1;
+    }
+    int cheapest = -1;
+    for(int i = 0; i < store->count; i++)
+    {
+        const struct ModelEntry* entry = &store->entries[i];
+        if(!model_store_compatible(entry, ops, op_count, arena_size, height, width, channels))
+        {
+            continue;
+        }
+        if(voltage >= entry->min_voltage)
+        {
+            return i;
+        }
+        cheapest = i;
+    }
+    return cheapest;
+}
@@ -0,0 +1,70 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_MODEL_STORE_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_MODEL_STORE_H_
+
+#include <stdint.h>
+
+//Cheaper variants of the person model stored in a dedicated flash region (written by Host_tools/model_store.py). The compiled-in person model
+//is the most accurate variant: it runs at or above MODEL_STORE_FULL_MODEL_VOLTAGE and while the region holds no valid store, the store
+//variants run below it. The sketch starts after the bootloader at MODEL_STORE_SKETCH_ADDRESS and has to end below MODEL_STORE_ADDRESS
+//(576 KB for the sketch): model_store.py checks the compiled sketch (--sketch), and the sketch ignores the store if its own image reaches
+//into the region. The region is the 320 KB up to the end of the application flash (0xF0000), 528 B of it the header and the entry table.
+#define MODEL_STORE_ENABLED 1
+#define MODEL_STORE_SKETCH_ADDRESS 0x00010000
+#define MODEL_STORE_ADDRESS 0x000A0000
+#define MODEL_STORE_SIZE 0x00050000
+//Capacitor voltage (mV, as read_voltage) from which the compiled-in model is selected instead of a store variant
+#define MODEL_STORE_FULL_MODEL_VOLTAGE 4100
+
+//Store layout (little endian): header, MODEL_STORE_MAX_MODELS entries, then the .tflite blobs aligned to MODEL_STORE_ALIGNMENT bytes.
+//The CRC-32 in the header covers everything after the header up to the store length.
+#define MODEL_STORE_MAGIC 0x3153544D    //"MTS1"
+#define MODEL_STORE_FORMAT 1
+#define MODEL_STORE_MAX_MODELS 8
+#define MODEL_STORE_MAX_OPS 16
+#define MODEL_STORE_ALIGNMENT 16
+#define MODEL_STORE_HEADER_LENGTH 16
+#define MODEL_STORE_ENTRY_LENGTH 64
+
+struct __attribute__((packed)) ModelStoreHeader
+{
+    uint32_t magic;
+    uint16_t format;
+    uint16_t count;
+    uint32_t length;            //bytes of the whole store, header included
+    uint32_t crc;
+};
+
+struct __attribute__((packed)) ModelEntry
+{
+    char name[16];              //zero padded
+    uint32_t offset;            //of the .tflite blob from the start of the store
+    uint32_t length;
+    uint16_t version;           //version of the model variant
+    uint16_t schema_version;    //TFLite schema version of the blob
+    uint32_t arena_bytes;       //tensor arena the model needs
+    uint16_t min_voltage;       //lowest capacitor voltage (mV, as read_voltage) at which this variant is selected, below MODEL_STORE_FULL_MODEL_VOLTAGE
+    uint16_t input_height;
+    uint16_t input_width;
+    uint16_t input_channels;
+    uint8_t input_type;         //TfLiteType of the input (kTfLiteInt8 = 9)
+    uint8_t op_count;
+    uint8_t ops[MODEL_STORE_MAX_OPS];   //BuiltinOperator codes used by the model
+    uint8_t reserved[6];
+};
+
+struct ModelStore
+{
+    const uint8_t* base;
+    const struct ModelEntry* entries;
+    int count;
+};
+
+extern uint32_t model_store_crc32(const uint8_t* data, uint32_t length, uint32_t crc);
+extern int model_store_open(struct ModelStore* store, const uint8_t* base, uint32_t size);
+extern const uint8_t* model_store_data(const struct ModelStore* store, int index);
+extern bool model_store_compatible(const struct ModelEntry* entry, const uint8_t* ops, int op_count, uint32_t arena_size,
+                                   int height, int width, int channels);
+extern int model_store_select(const struct ModelStore* store, int voltage, const uint8_t* ops, int op_count, uint32_t arena_size,
+                              int height, int width, int channels);
+
+#endif
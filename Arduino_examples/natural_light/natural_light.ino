@@ -36,7 +36,9 @@ to get new (fresh) data for next cycle.
 */
 
 #include "application.h"
+#include "arena_settings.h"
 #include <math.h> 
+#include <new>
 
 int E = 3.3;
 int C = 1500;
@@ -49,12 +51,57 @@ tflite::ErrorReporter* error_reporter = nullptr;
 const tflite::Model* model = nullptr;
 tflite::MicroInterpreter* interpreter = nullptr;
 TfLiteTensor* input = nullptr;   
-
-//An area of memory used for input, output, and intermediate arrays
-constexpr int kTensorArenaSize = 136*1024;
-static uint8_t tensor_arena[kTensorArenaSize];
+alignas(tflite::MicroInterpreter) uint8_t interpreter_storage[sizeof(tflite::MicroInterpreter)];
+//One resolver for the compiled-in model and every variant of the model store: the operators of the person model plus the ones small
+//variants commonly use
+constexpr int kResolverOps = 8;
+const uint8_t resolver_ops[kResolverOps] = {tflite::BuiltinOperator_AVERAGE_POOL_2D, tflite::BuiltinOperator_CONV_2D,
+                                            tflite::BuiltinOperator_DEPTHWISE_CONV_2D, tflite::BuiltinOperator_RESHAPE,
+                                            tflite::BuiltinOperator_SOFTMAX, tflite::BuiltinOperator_FULLY_CONNECTED,
+                                            tflite::BuiltinOperator_MAX_POOL_2D, tflite::BuiltinOperator_ADD};
+tflite::MicroMutableOpResolver<kResolverOps> micro_op_resolver;
+bool resolver_ready = false;
+//Model variant the interpreter runs (-1 is the compiled-in model) and the one selected for the next local inference
+struct ModelStore model_store;
+int loaded_model = -1;
+int active_model = -1;
+//End of the code and start / end of .data in RAM, defined by the linker script of the Mbed core (the initial values follow __etext in flash)
+extern "C" uint32_t __etext;
+extern "C" uint32_t __data_start__;
+extern "C" uint32_t __data_end__;
+//Second interpreter of the cascade, running the pre-filter model in its own arena (see prefilter.cpp)
+tflite::MicroInterpreter* prefilter = nullptr;
+alignas(tflite::MicroInterpreter) uint8_t prefilter_storage[sizeof(tflite::MicroInterpreter)];
+
+//An area of memory used for input, output, and intermediate arrays (sized in arena_settings.h)
+constexpr int kTensorArenaSize = TENSOR_ARENA_SIZE;
+static_assert(TENSOR_ARENA_USED_BYTES <= TENSOR_ARENA_SIZE, "The tensor arena is smaller than the usage measured on the board");
+uint8_t* tensor_arena = nullptr;
+
+//Capture, decoding, inference, transfer and result confirmation run strictly one after another, so the large buffers share
+//one pool according to the phases in which they are alive (see phase_arena.cpp). The receive buffer is only needed while the
+//tensor arena is not, so it overlays the arena; the JPEG buffer has to survive decoding and sits next to it. The thumbnail
+//buffers are also only used by the transfer and overlay the arena as well. The full camera frame of the multi-window search is
+//inferred window by window, so it has to live next to the arena and the JPEG buffer, as does the arena of the cascade pre-filter.
+constexpr int kSearchFrameBytes = SEARCH_ENABLED ? SEARCH_FRAME_BYTES : 0;
+constexpr int kPrefilterArenaSize = CASCADE_ENABLED ? PREFILTER_ARENA_SIZE : 0;
+constexpr int kPhasePoolSize = kTensorArenaSize + MAX_JPEG_BYTES + kSearchFrameBytes + kPrefilterArenaSize;
+alignas(PHASE_ARENA_ALIGNMENT) uint8_t phase_pool[kPhasePoolSize];
 }
 
+struct PhaseBuffer phase_buffers[BUF_COUNT] = {
+  {"tensor_arena", kTensorArenaSize, PHASE_BIT(PHASE_DECODE) | PHASE_BIT(PHASE_INFER)},
+  {"jpeg_buffer", MAX_JPEG_BYTES, PHASE_BIT(PHASE_CAPTURE) | PHASE_BIT(PHASE_DECODE) | PHASE_BIT(PHASE_INFER) | PHASE_BIT(PHASE_TX)},
+  {"rx_buffer", RX_BUFFER_BYTES, PHASE_BIT(PHASE_TX) | PHASE_BIT(PHASE_RESULT)},
+  {"luma", kNumCols * kNumRows, PHASE_BIT(PHASE_TX)},
+  {"thumbnail", THUMBNAIL_MAX_BYTES, PHASE_BIT(PHASE_TX)},
+  {"preview", PREVIEW_MAX_BYTES, PHASE_BIT(PHASE_TX)},
+  {"frame", kSearchFrameBytes, PHASE_BIT(PHASE_DECODE) | PHASE_BIT(PHASE_INFER)},
+  {"prefilter_arena", kPrefilterArenaSize, PHASE_BIT(PHASE_INFER)},
+};
+
+size_t arena_used_bytes = 0;
+
 #define MAX_TASK_AMOUNT 10
 struct TaskInstance TSK_LIST[MAX_TASK_AMOUNT];
 int OCC_LIST[MAX_TASK_AMOUNT] = {0};
@@ -63,6 +110,8 @@ int V_req;
 int t_deadline = 40000;
 int t_local;
 int t_remote;
+unsigned long boot_time_ms;
+unsigned long capture_time_ms = 0;
 //t_local = 32.4;
 //t_remote = 15.7;
 
@@ -88,6 +137,8 @@ int main(void){
 //Execute function 
 void execute(struct TaskInstance *selected_task)
 {
+    unsigned long task_start = millis();
+    phase_enter(phase_buffers, BUF_COUNT, task_phase(get_task_ti(selected_task)->task_name));
     switch (get_task_ti(selected_task)->task_name)
     {
     case F_camera:
@@ -95,13 +146,20 @@ void execute(struct TaskInstance *selected_task)
         //delay(2000);
         break;
 
+    case F_decode:
+        decode_task();
+        break;
+
     case F_image:
         send_image();
         break;
 
     case F_local:
-        inference();
+    {
+        struct SearchBudget budget = search_budget();
+        inference(&budget);
         break;
+    }
     
     case F_led:
         led_task();
@@ -114,6 +172,30 @@ void execute(struct TaskInstance *selected_task)
     default:
         break;
     }
+    //Per-task trace, reported through the telemetry characteristic
+    task_last_ms[get_task_ti(selected_task)->task_name] = millis() - task_start;
+}
+
+//Phase of the phase arena in which a task runs
+enum Phase task_phase(int task_name)
+{
+    switch (task_name)
+    {
+    case F_camera:
+        return PHASE_CAPTURE;
+    case F_decode:
+        return PHASE_DECODE;
+    case F_local:
+        return PHASE_INFER;
+    case F_image:
+        return PHASE_TX;
+    case F_led2:
+        return PHASE_RESULT;
+    //Local result confirmation only needs the scores, no pool buffer is handed out so the interpreter survives until the next cycle
+    case F_led:
+    default:
+        return PHASE_IDLE;
+    }
 }
 
 void low_power()
@@ -146,6 +228,9 @@ void getfirstTask()
 void setupScheduler()
 {
   app_init();
+  latency_reset(&remote_latency);
+  result_cache_reset(&result_cache);
+  score_filter_init(&score_filter, SCORE_FILTER_MODE, SCORE_FILTER_ALPHA, SCORE_FILTER_ON, SCORE_FILTER_OFF, SCORE_FILTER_K, SCORE_FILTER_N);
   getfirstTask();
 }
 
@@ -194,7 +279,7 @@ void addTask(int active_task)
           V_0 = read_voltage();
           V_req = get_task_ti(&(TSK_LIST[i]))->required_voltage;          
           t_local = time_function(Ih, Req, C, V_0, V_req);
-          t_local = t_local+1148+4000;
+          t_local = t_local + get_task_e(curr_child)->execution_time + application[F_local].execution_time + 4000;
           
           if(t_local < 0 )
           {
@@ -219,7 +304,7 @@ void addTask(int active_task)
           V_req = get_task_ti(&(TSK_LIST[i]))->required_voltage;
           
           t_remote = time_function(Ih, Req, C, V_0, V_req);
-          t_remote = t_remote + 8660 + 4000;
+          t_remote = t_remote + latency_percentile(&remote_latency, LATENCY_PERCENTILE, get_task_e(curr_child)->execution_time) + 4000;
 
           if(t_remote < 0 )
           {
@@ -298,7 +383,7 @@ void scheduleTask()
     V_0 = read_voltage();
     V_req = get_task_ti(&(TSK_LIST[loc]))->required_voltage;
     
-    if(get_task_ti(&(TSK_LIST[loc]))->task_name == F_local)
+    if(get_task_ti(&(TSK_LIST[loc]))->task_name == F_decode)
     {
       while(V_0 < V_req)
       {
@@ -308,8 +393,9 @@ void scheduleTask()
       execute(&TSK_LIST[loc]);
       addTask(loc);
       removeTask(loc);
+      //Local inference and LED confirmation follow the decoding directly
       int b = 0;
-      while(b < 1)
+      while(b < 2)
       {
         int loc = select_task();
         execute(&TSK_LIST[loc]);
@@ -332,8 +418,9 @@ void scheduleTask()
       while(s < 1)
       {
         int loc = select_task();
-        if(get_task_ti(&(TSK_LIST[loc]))->task_name == F_local)
+        if(get_task_ti(&(TSK_LIST[loc]))->task_name == F_decode)
         {
+          //Frame is offloaded, so it is never decoded
           removeTask(loc);
         }
         else
@@ -377,19 +464,221 @@ int read_voltage()
 void camera_task()
 {
     digitalWrite(2, HIGH);
-    initialize_camera(error_reporter, kNumCols, kNumRows, kNumChannels, input->data.int8);
+    capture_time_ms = millis();
+    capture_image(error_reporter);
     digitalWrite(2, LOW);
 }
 
-void inference()
+//Decoding runs only when the local inference path was selected for the captured frame
+void decode_task()
+{
+    //The model variant is chosen for the voltage read when the task was started, only here: the remote path keeps the loaded interpreter
+    select_model(V_0);
+    if(setup_interpreter() != kTfLiteOk)
+    {
+      return;
+    }
+#if SEARCH_ENABLED
+    //The whole frame is kept for the multi-window search, the windows are copied into the model input by the inference
+    decode_image(error_reporter, SEARCH_FRAME_WIDTH, SEARCH_FRAME_HEIGHT, (int8_t*)phase_buffers[BUF_FRAME].data, input_lut);
+#else
+    decode_image(error_reporter, kNumCols, kNumRows, input->data.int8, input_lut);
+#endif
+}
+
+//The gateway finishes the network of the compiled-in model (split_model.py), so the split computing mode only runs while it is the selected
+//model; with a model store variant the frame is offloaded as an image
+bool split_active()
+{
+    return split_layer > 0 && active_model < 0;
+}
+
+//Decodes the captured frame for the remote path once: into the model input in the split computing mode (the partial inference continues from
+//there, so the decode phase of the arena is entered), otherwise into the luma buffer. Returns the 96x96 frame, or nullptr if it was not decoded.
+int8_t* decode_frame()
 {
-    if(kTfLiteOk != interpreter->Invoke())
+    if(split_active())
+    {
+      phase_enter(phase_buffers, BUF_COUNT, PHASE_DECODE);
+      if(setup_interpreter() == kTfLiteOk && decode_image(error_reporter, kNumCols, kNumRows, input->data.int8, input_lut) == kTfLiteOk)
+      {
+        return input->data.int8;
+      }
+      phase_enter(phase_buffers, BUF_COUNT, PHASE_TX);
+      return nullptr;
+    }
+#if OFFLOAD_THUMBNAIL || RESULT_CACHE_ENABLED
+    int8_t* luma = (int8_t*)phase_buffers[BUF_LUMA].data;
+    //The gateway gets the plain luma, whatever the quantization of the local model
+    if(decode_image(error_reporter, kNumCols, kNumRows, luma, luma_lut) == kTfLiteOk)
+    {
+      return luma;
+    }
+#endif
+    return nullptr;
+}
+
+//Re-encodes the decoded 96x96 luma the model sees (decode_frame) as a small grayscale JPEG for the gateway, the luma is downscaled in place.
+//Returns the thumbnail length, or 0 if the camera JPEG has to be sent as it is.
+int encode_thumbnail(int8_t* luma, unsigned char** thumbnail)
+{
+#if OFFLOAD_THUMBNAIL
+    unsigned long start = millis();
+    jpeg_downscale(luma, kNumCols, kNumRows, THUMBNAIL_SCALE);
+    int length = jpeg_encode_gray(luma, kNumCols / THUMBNAIL_SCALE, kNumRows / THUMBNAIL_SCALE, THUMBNAIL_QUALITY,
+                                  phase_buffers[BUF_THUMBNAIL].data, THUMBNAIL_MAX_BYTES);
+    telemetry.thumbnail_encode_ms = millis() - start;
+    //The thumbnail is only worth sending if it is smaller than the camera JPEG
+    if(length <= 0 || length >= jpeg_length)
+    {
+      return 0;
+    }
+    *thumbnail = phase_buffers[BUF_THUMBNAIL].data;
+    return length;
+#else
+    return 0;
+#endif
+}
+
+//Progressive offload: encodes the luma left by encode_thumbnail once more, PREVIEW_SCALE times smaller than the frame. Returns the preview
+//length, or 0 if there is no preview smaller than max_length (the size of the full image it would be sent before).
+int encode_preview(int8_t* luma, int max_length, unsigned char** preview)
+{
+#if OFFLOAD_PROGRESSIVE && OFFLOAD_THUMBNAIL
+    if(PREVIEW_SCALE <= THUMBNAIL_SCALE)
+    {
+      return 0;
+    }
+    jpeg_downscale(luma, kNumCols / THUMBNAIL_SCALE, kNumRows / THUMBNAIL_SCALE, PREVIEW_SCALE / THUMBNAIL_SCALE);
+    int length = jpeg_encode_gray(luma, kNumCols / PREVIEW_SCALE, kNumRows / PREVIEW_SCALE, PREVIEW_QUALITY,
+                                  phase_buffers[BUF_PREVIEW].data, PREVIEW_MAX_BYTES);
+    if(length <= 0 || length >= max_length)
+    {
+      return 0;
+    }
+    *preview = phase_buffers[BUF_PREVIEW].data;
+    return length;
+#else
+    return 0;
+#endif
+}
+
+//Split computing: runs the first split_layer operators of the model on the frame decoded into the model input (decode_frame) and packs the
+//intermediate activation into jpeg_buffer (the camera JPEG is not needed once it is decoded). Returns the payload length, or 0 if the image
+//has to be offloaded.
+int encode_split(unsigned char** payload)
+{
+    telemetry.split_layer = 0;
+    if(!split_active() || phase_current() != PHASE_DECODE)
+    {
+      return 0;
+    }
+    phase_enter(phase_buffers, BUF_COUNT, PHASE_INFER);
+    unsigned long start = millis();
+    int length = split_run(interpreter, model, split_layer, jpeg_buffer, MAX_JPEG_BYTES);
+    telemetry.split_compute_ms = millis() - start;
+    phase_enter(phase_buffers, BUF_COUNT, PHASE_TX);
+    if(length > 0)
+    {
+      telemetry.split_layer = split_layer;
+    }
+    *payload = jpeg_buffer;
+    return length;
+}
+
+//Budget of the multi-window search: the time left until the deadline of the captured frame without the LED confirmation, and the voltage
+//the confirmation still needs after the search
+struct SearchBudget search_budget()
+{
+    struct SearchBudget budget;
+    long left = t_deadline - (long)(millis() - capture_time_ms) - application[F_led].execution_time;
+    budget.time_ms = left > 0 ? left : 0;
+    budget.min_voltage = application[F_led].required_voltage;
+    budget.read_voltage = read_voltage;
+    return budget;
+}
+
+void inference(const struct SearchBudget* budget)
+{
+    if(interpreter == nullptr)
+    {
+      return;
+    }
+#if CASCADE_ENABLED
+    //First stage: the full model only runs if the pre-filter finds a possible person in the decoded frame
+    if(setup_prefilter() == kTfLiteOk)
+    {
+      unsigned long start = millis();
+      int8_t score;
+#if SEARCH_ENABLED
+      //The frame is decoded with the input quantization of the person model, the pre-filter requantizes it to its own
+      TfLiteStatus status = prefilter_run(prefilter, (int8_t*)phase_buffers[BUF_FRAME].data, SEARCH_FRAME_WIDTH, SEARCH_FRAME_HEIGHT,
+                                          input->params.scale, input->params.zero_point, &score);
+#else
+      TfLiteStatus status = prefilter_run(prefilter, input->data.int8, kNumCols, kNumRows, input->params.scale, input->params.zero_point, &score);
+#endif
+      telemetry.prefilter_ms = millis() - start;
+      if(status == kTfLiteOk && score < PREFILTER_THRESHOLD)
+      {
+        telemetry.prefilter_rejects++;
+        telemetry.search_windows = 0;
+        person_score = -128;
+        no_person_score = 127;
+        score_local();
+        return;
+      }
+    }
+#endif
+#if SEARCH_ENABLED
+    struct SearchResult result;
+    if(kTfLiteOk != search_run(interpreter, (int8_t*)phase_buffers[BUF_FRAME].data, budget, &result))
     {
       TF_LITE_REPORT_ERROR(error_reporter, "Invoke failed!");
     }
+    person_score = result.person_score;
+    no_person_score = result.no_person_score;
+    telemetry.search_windows = result.windows_run;
+    telemetry.search_ms = result.duration_ms;
+#else
+    if(kTfLiteOk != op_profiler_invoke(interpreter))
+    {
+      TF_LITE_REPORT_ERROR(error_reporter, "Invoke failed!");
+    }
+    TfLiteTensor* output = interpreter->output(0);
+    person_score = output->data.int8[kPersonIndex];
+    no_person_score = output->data.int8[kNotAPersonIndex];
+#endif
+    score_local();
+    report_op_profile();
+}
+
+//Profiling mode: writes the operator table (op_profiler.cpp) to Serial every OP_PROFILER_REPORT_RUNS profiled runs
+void report_op_profile()
+{
+#if OP_PROFILER_ENABLED
+    static uint32_t reported_runs = 0;
+    if(op_profile.runs - reported_runs < OP_PROFILER_REPORT_RUNS)
+    {
+      return;
+    }
+    reported_runs = op_profile.runs;
+    char line[OP_PROFILER_LINE_LENGTH];
+    for(int i = 0; i < 2; i++)
+    {
+      Serial.write(line, op_profiler_csv_header(&op_profile, i, line, sizeof(line)));
+    }
+    for(int node = 0; node < op_profile.node_count; node++)
+    {
+      Serial.write(line, op_profiler_csv_row(&op_profile, node, line, sizeof(line)));
+    }
+#endif
+}
+
+//The person output is dequantized with the output parameters of the loaded model, so every variant decides on the same probability
+void score_local()
+{
     TfLiteTensor* output = interpreter->output(0);
-    person_score = output->data.uint8[kPersonIndex];
-    no_person_score = output->data.uint8[kNotAPersonIndex]; 
+    score_result(score_dequantize(person_score, output->params.scale, output->params.zero_point));
 }
 
 void led_task()
@@ -397,7 +686,7 @@ void led_task()
   pinMode(LEDR, OUTPUT);
   pinMode(LEDG, OUTPUT);
 
-  if (person_score > no_person_score) {
+  if (score_filter.decision) {
     digitalWrite(LEDG, LOW);
     digitalWrite(LEDR, HIGH);
     delay(500);
@@ -414,42 +703,177 @@ void setup()
 {
 //  Serial.begin(9600);
 //  while(!Serial);
+#if OP_PROFILER_ENABLED
+  //The operator table is read over USB, so the board is powered by it while profiling
+  Serial.begin(115200);
+  op_profiler_reset(&op_profile);
+#endif
   low_power();
   pinMode(2, OUTPUT);
   digitalWrite(2, LOW);
   pinMode(4, OUTPUT);
   digitalWrite(4, LOW);
 
-  tflite::MicroErrorReporter micro_error_reporter;
+  static tflite::MicroErrorReporter micro_error_reporter;
   error_reporter = &micro_error_reporter;
+
+  //Place the tensor arena, JPEG and receive buffers in the shared pool
+  int pool_used = phase_arena_layout(phase_buffers, BUF_COUNT, phase_pool, kPhasePoolSize);
+  if(pool_used < 0){
+    TF_LITE_REPORT_ERROR(error_reporter, "Phase arena layout does not fit into %d bytes!", kPhasePoolSize);
+    return;
+  }
+  tensor_arena = phase_buffers[BUF_TENSOR_ARENA].data;
+  jpeg_buffer = phase_buffers[BUF_JPEG].data;
+  tmp = phase_buffers[BUF_RX].data;
+  //luma - 128, the input of the person model until the interpreter is set up
+  input_lut_build(luma_lut, INPUT_LUT_LUMA_SCALE, INPUT_LUT_LUMA_ZERO_POINT);
+  input_lut_build(input_lut, INPUT_LUT_LUMA_SCALE, INPUT_LUT_LUMA_ZERO_POINT);
+
+#if MODEL_STORE_ENABLED
+  //Model variants flashed next to the sketch, none if the region was never written. A sketch that grew into the region would be read as a
+  //(corrupted) store, so the store is only opened below the end of the flash image: the code and the initial values of .data after it.
+  uint32_t sketch_end = (uint32_t)&__etext + ((uint32_t)&__data_end__ - (uint32_t)&__data_start__);
+  if(sketch_end > MODEL_STORE_ADDRESS){
+    TF_LITE_REPORT_ERROR(error_reporter, "Sketch ends at 0x%x, inside the model store, using the compiled-in model", sketch_end);
+  }
+  else if(model_store_open(&model_store, (const uint8_t*)MODEL_STORE_ADDRESS, MODEL_STORE_SIZE) < 0){
+    TF_LITE_REPORT_ERROR(error_reporter, "No model store, using the compiled-in model");
+  }
+#endif
+  //The interpreter is set up lazily by the first task that needs it (see setup_interpreter)
+  setupScheduler();
+  boot_time_ms = millis();
+  telemetry.boot_ms = boot_time_ms;
+  telemetry.ram_reserved_bytes = kPhasePoolSize;
+}
+
+//Maps the model, builds the op resolver and interpreter and allocates the tensors. This is done on the first cycle that selects the
+//local inference path, so boots (and cycles) that only offload frames do not pay for it. The tensor arena shares memory with buffers
+//used by the remote path, so the interpreter is rebuilt (AllocateTensors() again) whenever the arena content was clobbered.
+TfLiteStatus setup_interpreter()
+{
+  if(interpreter != nullptr && !phase_buffers[BUF_TENSOR_ARENA].clobbered && loaded_model == active_model)
+  {
+    return kTfLiteOk;
+  }
+  if(interpreter != nullptr)
+  {
+    interpreter->~MicroInterpreter();
+    interpreter = nullptr;
+    input = nullptr;
+  }
+
   //Map the model into a usable data structure. This is a very lightweight operation!
-  model = tflite::GetModel(g_person_detect_model_data);
+  const uint8_t* model_data = active_model >= 0 ? model_store_data(&model_store, active_model) : g_person_detect_model_data;
+  model = tflite::GetModel(model_data);
   if(model->version() != TFLITE_SCHEMA_VERSION){
     TF_LITE_REPORT_ERROR(error_reporter, "Model provided is schema version %d not equal "
                           "to supported version %d.", model->version(), TFLITE_SCHEMA_VERSION);
-    return;
+    return kTfLiteError;
   }
-  static tflite::MicroMutableOpResolver<5> micro_op_resolver;
-  micro_op_resolver.AddAveragePool2D();
-  micro_op_resolver.AddConv2D();
-  micro_op_resolver.AddDepthwiseConv2D();
-  micro_op_resolver.AddReshape();
-  micro_op_resolver.AddSoftmax();
+  setup_resolver();
 
   //Interpreter used to run the model 
-  static tflite::MicroInterpreter static_interpreter(model, micro_op_resolver, tensor_arena, kTensorArenaSize, error_reporter);
-  interpreter = &static_interpreter;
+  tflite::MicroInterpreter* new_interpreter = new (interpreter_storage) tflite::MicroInterpreter(model, micro_op_resolver, tensor_arena, kTensorArenaSize, error_reporter);
 
   //Allocate the memory from the tensor_arena for the model's tensors.
-  TfLiteStatus allocate_status = interpreter->AllocateTensors();
+  TfLiteStatus allocate_status = new_interpreter->AllocateTensors();
   if(allocate_status != kTfLiteOk){
     TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors () failed!");
-    return;
+    new_interpreter->~MicroInterpreter();
+    return allocate_status;
   }
+  interpreter = new_interpreter;
+  loaded_model = active_model;
+  phase_buffers[BUF_TENSOR_ARENA].clobbered = false;
+  report_arena_usage();
 
   //Information about the memory area used for the model's input 
   input = interpreter->input(0);
-  setupScheduler();
+  //Preprocessing follows the input quantization of the loaded model
+  input_lut_build(input_lut, input->params.scale, input->params.zero_point);
+  telemetry.arena_used_bytes = arena_used_bytes;
+  return kTfLiteOk;
+}
+
+//The operators of all models (resolver_ops), shared by the main interpreter and the cascade pre-filter
+void setup_resolver()
+{
+  if(resolver_ready){
+    return;
+  }
+  micro_op_resolver.AddAveragePool2D();
+  micro_op_resolver.AddConv2D();
+  micro_op_resolver.AddDepthwiseConv2D();
+  micro_op_resolver.AddReshape();
+  micro_op_resolver.AddSoftmax();
+  micro_op_resolver.AddFullyConnected();
+  micro_op_resolver.AddMaxPool2D();
+  micro_op_resolver.AddAdd();
+  //Kernels wrapped so the split computing mode can stop the graph after the split point (see split_inference.cpp)
+  tflite::BuiltinOperator split_ops[kResolverOps];
+  for(int i = 0; i < kResolverOps; i++)
+  {
+    split_ops[i] = (tflite::BuiltinOperator)resolver_ops[i];
+  }
+  split_wrap_resolver(micro_op_resolver, split_ops, kResolverOps);
+  resolver_ready = true;
+}
+
+//Selects the model variant for the energy available before a local inference, setup_interpreter() loads it if it is not the one running
+void select_model(int voltage)
+{
+#if MODEL_STORE_ENABLED
+  int selected = model_store_select(&model_store, voltage, resolver_ops, kResolverOps, kTensorArenaSize, kNumRows, kNumCols, kNumChannels);
+  if(selected != active_model)
+  {
+    active_model = selected;
+    telemetry.model_switches++;
+#if OP_PROFILER_ENABLED
+    //The operator table belongs to one model
+    op_profiler_reset(&op_profile);
+#endif
+  }
+  telemetry.model_index = active_model + 1;
+#endif
+}
+
+//Builds the interpreter of the cascade pre-filter in its own arena, rebuilt like the main one when the arena was clobbered.
+//Fails while no pre-filter model is compiled in, which disables the cascade.
+TfLiteStatus setup_prefilter()
+{
+  if(!CASCADE_ENABLED || g_prefilter_model_data_len == 0)
+  {
+    return kTfLiteError;
+  }
+  if(prefilter != nullptr && !phase_buffers[BUF_PREFILTER_ARENA].clobbered)
+  {
+    return kTfLiteOk;
+  }
+  if(prefilter != nullptr)
+  {
+    prefilter->~MicroInterpreter();
+    prefilter = nullptr;
+  }
+  const tflite::Model* prefilter_model = tflite::GetModel(g_prefilter_model_data);
+  if(prefilter_model->version() != TFLITE_SCHEMA_VERSION){
+    TF_LITE_REPORT_ERROR(error_reporter, "Pre-filter model is schema version %d not equal to supported version %d.",
+                         prefilter_model->version(), TFLITE_SCHEMA_VERSION);
+    return kTfLiteError;
+  }
+  setup_resolver();
+  tflite::MicroInterpreter* new_prefilter = new (prefilter_storage) tflite::MicroInterpreter(prefilter_model, micro_op_resolver,
+                                                  phase_buffers[BUF_PREFILTER_ARENA].data, kPrefilterArenaSize, error_reporter);
+  TfLiteStatus allocate_status = new_prefilter->AllocateTensors();
+  if(allocate_status != kTfLiteOk){
+    TF_LITE_REPORT_ERROR(error_reporter, "Pre-filter AllocateTensors () failed!");
+    new_prefilter->~MicroInterpreter();
+    return allocate_status;
+  }
+  prefilter = new_prefilter;
+  phase_buffers[BUF_PREFILTER_ARENA].clobbered = false;
+  return kTfLiteOk;
 }
 
 void loop()
@@ -458,3 +882,19 @@ void loop()
   unsigned int next_time = fmax(get_time(), 5);
   delay(next_time);
 }
+
+//Reports the tensor arena high-water mark after AllocateTensors(). The used value is the input for Host_tools/arena_report.py --measured,
+//which sizes TENSOR_ARENA_SIZE in arena_settings.h with a safety margin.
+void report_arena_usage()
+{
+  arena_used_bytes = interpreter->arena_used_bytes();
+  TF_LITE_REPORT_ERROR(error_reporter, "Tensor arena: %d of %d bytes used, %d bytes headroom",
+                       (int)arena_used_bytes, kTensorArenaSize, kTensorArenaSize - (int)arena_used_bytes);
+#if TENSOR_ARENA_USED_BYTES > 0
+  //The arena was sized from an earlier measurement, a model or library change that needs more makes the margin smaller than intended
+  if(arena_used_bytes > TENSOR_ARENA_USED_BYTES){
+    TF_LITE_REPORT_ERROR(error_reporter, "Tensor arena use grew from the %d bytes arena_settings.h was sized from, regenerate it",
+                         TENSOR_ARENA_USED_BYTES);
+  }
+#endif
+}
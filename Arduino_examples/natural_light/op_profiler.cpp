@@ -0,0 +1,141 @@
+/*
+This script measures the time of every operator of the person model. The kernels of the resolver are already wrapped for the split computing mode (see
+split_inference.cpp), so the wrapper reads the clock around the original invoke function and records the ticks for the node being run; nodes are counted in
+execution order from the start of op_profiler_invoke(), which runs the main interpreter (the cascade pre-filter shares the kernels but is not profiled).
+On the board the clock is the DWT cycle counter of the Cortex-M4 (CPU cycles at SystemCoreClock), on the host a steady clock in nanoseconds, so the same
+table comes out of the sketch and of a host build. Every node gets its operator, invocations and the total, minimum and maximum ticks, written as CSV.
+*/
+#include "op_profiler.h"
+#include <stdio.h>
+#include <string.h>
+#include "tensorflow/lite/schema/schema_generated.h"
+
+#if defined(ARDUINO) && defined(__arm__)
+#include <Arduino.h>
+#define OP_PROFILER_UNIT "cycles"
+#else
+#include <chrono>
+#define OP_PROFILER_UNIT "ns"
+#endif
+
+struct OpProfile op_profile;
+
+void op_profiler_reset(struct OpProfile* profile)
+{
+    memset(profile, 0, sizeof(*profile));
+#if defined(ARDUINO) && defined(__arm__)
+    //Trace has to be enabled for the cycle counter to run
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+//Wraps every 2^32 ticks (67 s at 64 MHz, 4.3 s on the host), differences of a single operator stay correct
+uint32_t op_profiler_now()
+{
+#if defined(ARDUINO) && defined(__arm__)
+    return DWT->CYCCNT;
+#else
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static uint32_t op_profiler_rate()
+{
+#if defined(ARDUINO) && defined(__arm__)
+    return SystemCoreClock;
+#else
+    return 1000000000;
+#endif
+}
+
+//Called by the kernel wrapper after every operator of a profiled run
+void op_profiler_record(struct OpProfile* profile, uint8_t op, uint32_t ticks)
+{
+    if(profile->node >= OP_PROFILER_MAX_NODES)
+    {
+        return;
+    }
+    struct OpRecord* record = &profile->nodes[profile->node++];
+    record->op = op;
+    record->total += ticks;
+    if(record->invocations == 0 || ticks < record->min)
+    {
+        record->min = ticks;
+    }
+    if(ticks > record->max)
+    {
+        record->max = ticks;
+    }
+    record->invocations++;
+    if(profile->node > profile->node_count)
+    {
+        profile->node_count = profile->node;
+    }
+}
+
+//Invoke() of the main interpreter, with the time of every operator recorded when OP_PROFILER_ENABLED
+TfLiteStatus op_profiler_invoke(tflite::MicroInterpreter* interpreter)
+{
+#if OP_PROFILER_ENABLED
+    op_profile.node = 0;
+    op_profile.active = true;
+    TfLiteStatus status = interpreter->Invoke();
+    op_profile.active = false;
+    op_profile.runs++;
+    return status;
+#else
+    return interpreter->Invoke();
+#endif
+}
+
+//snprintf of the embedded C libraries may lack %llu
+static int put_u64(char* out, uint64_t value)
+{
+    char digits[20];
+    int count = 0;
+    do
+    {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while(value > 0);
+    for(int i = 0; i < count; i++)
+    {
+        out[i] = digits[count - 1 - i];
+    }
+    return count;
+}
+
+//Header line 0 or 1, returns the length written into out (0 if line is out of range)
+int op_profiler_csv_header(const struct OpProfile* profile, int line, char* out, int max_length)
+{
+    if(line == 0)
+    {
+        return snprintf(out, max_length, "#op_profile,%s,%lu,%lu\n", OP_PROFILER_UNIT, (unsigned long)op_profiler_rate(), (unsigned long)profile->runs);
+    }
+    if(line == 1)
+    {
+        return snprintf(out, max_length, "node,op,name,invocations,total,min,max\n");
+    }
+    return 0;
+}
+
+//Row of a node, returns the length written into out (0 if the node was not run)
+int op_profiler_csv_row(const struct OpProfile* profile, int node, char* out, int max_length)
+{
+    if(node < 0 || node >= profile->node_count || max_length < 64)
+    {
+        return 0;
+    }
+    const struct OpRecord* record = &profile->nodes[node];
+    int length = snprintf(out, max_length, "%d,%u,%s,%lu,", node, record->op, tflite::EnumNameBuiltinOperator((tflite::BuiltinOperator)record->op),
+                          (unsigned long)record->invocations);
+    if(length < 0 || length + 44 > max_length)
+    {
+        return 0;
+    }
+    length += put_u64(out + length, record->total);
+    length += snprintf(out + length, max_length - length, ",%lu,%lu\n", (unsigned long)record->min, (unsigned long)record->max);
+    return length;
+}
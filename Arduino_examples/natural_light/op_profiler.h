@@ -0,0 +1,43 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_OP_PROFILER_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_OP_PROFILER_H_
+
+#include <stdint.h>
+#include "tensorflow/lite/micro/micro_interpreter.h"
+
+//Profiling mode: the time of every operator of the person model is measured (DWT cycle counter on the board, steady clock on the host) and the
+//table is written to Serial as CSV every OP_PROFILER_REPORT_RUNS inferences (Host_tools/op_profile_report.py reads it). Costs a few cycles per operator.
+#ifndef OP_PROFILER_ENABLED
+#define OP_PROFILER_ENABLED 0
+#endif
+#define OP_PROFILER_REPORT_RUNS 5
+#define OP_PROFILER_MAX_NODES 64
+#define OP_PROFILER_LINE_LENGTH 96
+
+//CSV: "#op_profile,<unit>,<ticks per second>,<runs>", then "node,op,name,invocations,total,min,max" and one row per node (ticks)
+struct OpRecord
+{
+    uint8_t op;                 //BuiltinOperator code
+    uint32_t invocations;
+    uint64_t total;
+    uint32_t min;
+    uint32_t max;
+};
+
+struct OpProfile
+{
+    struct OpRecord nodes[OP_PROFILER_MAX_NODES];
+    int node_count;             //nodes seen in a run
+    int node;                   //node of the next recorded invocation
+    uint32_t runs;
+    bool active;                //an Invoke() of the profiled interpreter is running
+};
+
+extern struct OpProfile op_profile;
+extern void op_profiler_reset(struct OpProfile* profile);
+extern uint32_t op_profiler_now();
+extern void op_profiler_record(struct OpProfile* profile, uint8_t op, uint32_t ticks);
+extern TfLiteStatus op_profiler_invoke(tflite::MicroInterpreter* interpreter);
+extern int op_profiler_csv_header(const struct OpProfile* profile, int line, char* out, int max_length);
+extern int op_profiler_csv_row(const struct OpProfile* profile, int node, char* out, int max_length);
+
+#endif
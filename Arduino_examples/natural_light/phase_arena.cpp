@@ -0,0 +1,145 @@
+/*
+This script implements a phase-based static memory allocator. Capture, decoding, inference, BLE transfer and result confirmation are executed strictly one after another,
+so the large buffers used by these tasks (tensor arena, JPEG buffer, BLE receive buffer, ...) do not have to be disjoint statics. Every buffer declares the phases in
+which its content has to be preserved, and buffers whose lifetimes never intersect are placed on top of each other in a single pool.
+The layout is computed once at boot (largest buffers first, lowest offset that does not overlap a buffer alive in a common phase) and verified against the pool size.
+When memory of a dead buffer is handed out to another buffer, the dead one is marked as clobbered, so its owner knows it has to rebuild the content (e.g. the
+interpreter has to allocate the tensors again). With PHASE_ARENA_DEBUG enabled, buffers are poisoned when their lifetime ends and accesses outside of the declared
+lifetime are counted, which makes overlap bugs visible.
+*/
+#include "phase_arena.h"
+#include <string.h>
+
+static enum Phase current_phase = PHASE_IDLE;
+static unsigned int violation_count = 0;
+
+static bool ranges_overlap(unsigned int a_offset, unsigned int a_size, unsigned int b_offset, unsigned int b_size)
+{
+    return a_offset < b_offset + b_size && b_offset < a_offset + a_size;
+}
+
+bool phase_buffers_overlap(const struct PhaseBuffer* a, const struct PhaseBuffer* b)
+{
+    return ranges_overlap(a->offset, a->size, b->offset, b->size);
+}
+
+//Returns the number of pool bytes used by the layout, or -1 if the buffers do not fit into the pool
+int phase_arena_layout(struct PhaseBuffer* buffers, int count, uint8_t* pool, unsigned int pool_size)
+{
+    bool placed[PHASE_ARENA_MAX_BUFFERS];
+    unsigned int high_water = 0;
+
+    if(count > PHASE_ARENA_MAX_BUFFERS)
+    {
+        return -1;
+    }
+
+    for(int i = 0; i < count; i++)
+    {
+        placed[i] = false;
+    }
+
+    for(int n = 0; n < count; n++)
+    {
+        //Pick the largest buffer that is not placed yet
+        int current = -1;
+        for(int i = 0; i < count; i++)
+        {
+            if(!placed[i] && (current < 0 || buffers[i].size > buffers[current].size))
+            {
+                current = i;
+            }
+        }
+
+        //Lowest aligned offset that does not overlap a placed buffer alive in a common phase
+        unsigned int offset = 0;
+        bool moved = true;
+        while(moved)
+        {
+            moved = false;
+            for(int i = 0; i < count; i++)
+            {
+                if(placed[i] && (buffers[i].phases & buffers[current].phases) &&
+                   ranges_overlap(offset, buffers[current].size, buffers[i].offset, buffers[i].size))
+                {
+                    offset = buffers[i].offset + buffers[i].size;
+                    offset = (offset + PHASE_ARENA_ALIGNMENT - 1) / PHASE_ARENA_ALIGNMENT * PHASE_ARENA_ALIGNMENT;
+                    moved = true;
+                }
+            }
+        }
+
+        buffers[current].offset = offset;
+        buffers[current].data = pool + offset;
+        buffers[current].clobbered = false;
+        placed[current] = true;
+        if(offset + buffers[current].size > high_water)
+        {
+            high_water = offset + buffers[current].size;
+        }
+    }
+
+    if(high_water > pool_size)
+    {
+        return -1;
+    }
+    return high_water;
+}
+
+void phase_enter(struct PhaseBuffer* buffers, int count, enum Phase phase)
+{
+    unsigned int previous = PHASE_BIT(current_phase);
+    unsigned int next = PHASE_BIT(phase);
+
+    for(int i = 0; i < count; i++)
+    {
+        bool was_live = buffers[i].phases & previous;
+        bool is_live = buffers[i].phases & next;
+
+#if PHASE_ARENA_DEBUG
+        if(was_live && !is_live)
+        {
+            //The content is gone, so whatever was built in the buffer (the interpreter in the tensor arena) has to be rebuilt
+            memset(buffers[i].data, PHASE_ARENA_POISON, buffers[i].size);
+            buffers[i].clobbered = true;
+        }
+#endif
+
+        if(!was_live && is_live)
+        {
+            //Buffer memory is handed out again, any dead buffer sharing it loses its content
+            for(int j = 0; j < count; j++)
+            {
+                if(j != i && !(buffers[j].phases & next) && phase_buffers_overlap(&buffers[i], &buffers[j]))
+                {
+                    buffers[j].clobbered = true;
+                }
+            }
+        }
+    }
+
+    current_phase = phase;
+}
+
+enum Phase phase_current()
+{
+    return current_phase;
+}
+
+//Checks that the buffer may be accessed in the current phase (counts a violation otherwise when PHASE_ARENA_DEBUG is enabled)
+bool phase_buffer_live(const struct PhaseBuffer* buffer)
+{
+    bool live = buffer->phases & PHASE_BIT(current_phase);
+#if PHASE_ARENA_DEBUG
+    if(!live)
+    {
+        violation_count++;
+    }
+#endif
+    return live;
+}
+
+unsigned int phase_violations()
+{
+    return violation_count;
+}
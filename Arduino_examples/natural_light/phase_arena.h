@@ -0,0 +1,43 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_PHASE_ARENA_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_PHASE_ARENA_H_
+
+#include <stdint.h>
+
+//Set to 1 to poison buffers when their lifetime ends and to report accesses outside of the declared lifetime
+#define PHASE_ARENA_DEBUG 0
+#define PHASE_ARENA_POISON 0xA5
+#define PHASE_ARENA_ALIGNMENT 16
+#define PHASE_ARENA_MAX_BUFFERS 8
+
+//Application phases, the tasks run strictly one after another so only one phase is active at a time
+enum Phase
+{
+    PHASE_IDLE,
+    PHASE_CAPTURE,
+    PHASE_DECODE,
+    PHASE_INFER,
+    PHASE_TX,
+    PHASE_RESULT,
+    PHASE_COUNT
+};
+
+#define PHASE_BIT(phase) (1u << (phase))
+
+struct PhaseBuffer
+{
+    const char* name;
+    unsigned int size;
+    unsigned int phases;    //bitmask of the phases in which the buffer content has to be preserved
+    unsigned int offset;    //assigned by phase_arena_layout
+    uint8_t* data;          //assigned by phase_arena_layout
+    bool clobbered;         //set when memory shared with another buffer was handed out while this one was dead
+};
+
+extern int phase_arena_layout(struct PhaseBuffer* buffers, int count, uint8_t* pool, unsigned int pool_size);
+extern void phase_enter(struct PhaseBuffer* buffers, int count, enum Phase phase);
+extern enum Phase phase_current();
+extern bool phase_buffer_live(const struct PhaseBuffer* buffer);
+extern bool phase_buffers_overlap(const struct PhaseBuffer* a, const struct PhaseBuffer* b);
+extern unsigned int phase_violations();
+
+#endif
@@ -0,0 +1,75 @@
+/*
+This script runs the first stage of the local inference cascade. Most frames of a battery-less camera show no person, so a pre-filter model with a 32x32 or
+48x48 input, which costs a small fraction of the full model, decides first whether the full person detection model has to run at all. The decoded frame is
+reduced to the pre-filter input by averaging the source pixels that fall into every output pixel, so any frame size can be fed to any input size, and the
+average is requantized from the quantization of the frame (the one of the person model input) to the one of the pre-filter input (the same resampling is
+done by Host_tools/cascade_benchmark.py, which chooses the threshold).
+*/
+#include "prefilter.h"
+#include <math.h>
+
+//Area average resampling of an int8 frame to width x height (not larger than the source), requantized from source_scale / source_zero_point to
+//scale / zero_point. A scale of 0 (no quantization parameters) keeps the values.
+void prefilter_resize(const int8_t* source, int source_width, int source_height, float source_scale, int source_zero_point,
+                      int8_t* out, int width, int height, float scale, int zero_point)
+{
+    if(source_scale <= 0.0f || scale <= 0.0f)
+    {
+        source_scale = scale = 1.0f;
+        source_zero_point = zero_point = 0;
+    }
+    float factor = source_scale / scale;
+    for(int y = 0; y < height; y++)
+    {
+        int y0 = y * source_height / height;
+        int y1 = (y + 1) * source_height / height;
+        for(int x = 0; x < width; x++)
+        {
+            int x0 = x * source_width / width;
+            int x1 = (x + 1) * source_width / width;
+            int32_t sum = 0;
+            for(int sy = y0; sy < y1; sy++)
+            {
+                for(int sx = x0; sx < x1; sx++)
+                {
+                    sum += source[sy * source_width + sx];
+                }
+            }
+            int count = (y1 - y0) * (x1 - x0);
+            //Rounded to the nearest value and saturated to int8 as the TFLite quantizer does
+            int value = (int)lroundf(((float)sum / count - source_zero_point) * factor) + zero_point;
+            if(value < -128)
+            {
+                value = -128;
+            }
+            if(value > 127)
+            {
+                value = 127;
+            }
+            out[y * width + x] = (int8_t)value;
+        }
+    }
+}
+
+//Runs the pre-filter on a decoded width x height frame quantized with frame_scale / frame_zero_point, the score is the person output (the second
+//output of a two-class model, like the person model, or the only one)
+TfLiteStatus prefilter_run(tflite::MicroInterpreter* interpreter, const int8_t* frame, int width, int height, float frame_scale, int frame_zero_point,
+                           int8_t* score)
+{
+    TfLiteTensor* input = interpreter->input(0);
+    TfLiteTensor* output = interpreter->output(0);
+    if(input->dims->size != 4 || input->dims->data[3] != 1 || input->dims->data[1] > height || input->dims->data[2] > width)
+    {
+        return kTfLiteError;
+    }
+    prefilter_resize(frame, width, height, frame_scale, frame_zero_point, input->data.int8, input->dims->data[2], input->dims->data[1],
+                     input->params.scale, input->params.zero_point);
+    TfLiteStatus status = interpreter->Invoke();
+    if(status != kTfLiteOk)
+    {
+        return status;
+    }
+    int classes = output->dims->data[output->dims->size - 1];
+    *score = output->data.int8[classes > 1 ? 1 : 0];
+    return kTfLiteOk;
+}
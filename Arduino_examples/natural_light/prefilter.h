@@ -0,0 +1,21 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_PREFILTER_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_PREFILTER_H_
+
+#include <stdint.h>
+#include "tensorflow/lite/micro/micro_interpreter.h"
+
+//Two-stage cascade of the local path: a small pre-filter model (prefilter_model_data.cpp) runs on a downscaled frame first, and the full person
+//detection model only if the pre-filter person score reaches PREFILTER_THRESHOLD (int8 output, -128 - 127). The pre-filter has its own
+//interpreter and arena, takes an int8 grayscale input (with its own quantization) and may only use the operators registered for it.
+//Enabling the cascade adds PREFILTER_ARENA_SIZE bytes to the phase pool; the build fails while prefilter_model_data.cpp is the placeholder.
+#define CASCADE_ENABLED 0
+#define PREFILTER_ARENA_SIZE (24*1024)
+//Low enough to let nearly every person through (about 0.25), the full model removes the false positives
+#define PREFILTER_THRESHOLD -64
+
+extern void prefilter_resize(const int8_t* source, int source_width, int source_height, float source_scale, int source_zero_point,
+                             int8_t* out, int width, int height, float scale, int zero_point);
+extern TfLiteStatus prefilter_run(tflite::MicroInterpreter* interpreter, const int8_t* frame, int width, int height, float frame_scale, int frame_zero_point,
+                                  int8_t* score);
+
+#endif
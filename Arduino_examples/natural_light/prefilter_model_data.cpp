@@ -0,0 +1,13 @@
+//Placeholder until a pre-filter model is trained: replace this file with the output of
+//python Host_tools/cascade_benchmark.py <frames> --prefilter <model>.tflite --write-source Arduino_examples/natural_light/prefilter_model_data.cpp
+
+#include "prefilter_model_data.h"
+#include "prefilter.h"
+
+#if CASCADE_ENABLED
+#error "CASCADE_ENABLED needs a trained pre-filter model, replace prefilter_model_data.cpp with the output of cascade_benchmark.py --write-source"
+#endif
+
+//Keep model aligned to 8 bytes to guarantee aligned 64-bit accesses.
+alignas(8) const unsigned char g_prefilter_model_data[] = {0x00};
+const int g_prefilter_model_data_len = 0;
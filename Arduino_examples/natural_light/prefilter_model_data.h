@@ -0,0 +1,9 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_PREFILTER_MODEL_DATA_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_PREFILTER_MODEL_DATA_H_
+
+//Pre-filter model of the two-stage cascade (see prefilter.cpp), generated by Host_tools/cascade_benchmark.py --write-source.
+//The placeholder in the repository stops the build if CASCADE_ENABLED is set, an empty model (length 0) disables the cascade at runtime.
+extern const unsigned char g_prefilter_model_data[];
+extern const int g_prefilter_model_data_len;
+
+#endif
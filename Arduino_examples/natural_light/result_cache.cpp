@@ -0,0 +1,142 @@
+/*
+This script keeps the remote results of recently offloaded frames, so a static scene is not sent to the gateway and inferred again in every cycle. Every decoded
+96x96 frame is reduced to a 64-bit average hash (8x8 blocks, one bit per block that is brighter than the frame mean), which does not change with small noise or
+uniform brightness changes. If the hash of a new frame is within RESULT_CACHE_MAX_DISTANCE bits of a cached one, the cached result is used and the radio stays
+off. Entries expire after RESULT_CACHE_MAX_AGE and are refreshed after RESULT_CACHE_MAX_REUSES reuses in a row, so a wrong result is not kept forever; the least
+recently used entry is replaced when the cache is full.
+*/
+#include "result_cache.h"
+
+#define HASH_GRID 8
+
+//Average hash of a width x height int8 frame (both multiples of 8)
+uint64_t frame_hash(const int8_t* luma, int width, int height)
+{
+    int block_width = width / HASH_GRID;
+    int block_height = height / HASH_GRID;
+    int32_t sums[HASH_GRID * HASH_GRID];
+    int64_t total = 0;
+    for(int by = 0; by < HASH_GRID; by++)
+    {
+        for(int bx = 0; bx < HASH_GRID; bx++)
+        {
+            int32_t sum = 0;
+            for(int y = by * block_height; y < (by + 1) * block_height; y++)
+            {
+                for(int x = bx * block_width; x < (bx + 1) * block_width; x++)
+                {
+                    sum += luma[y * width + x];
+                }
+            }
+            sums[by * HASH_GRID + bx] = sum;
+            total += sum;
+        }
+    }
+
+    uint64_t hash = 0;
+    for(int i = 0; i < HASH_GRID * HASH_GRID; i++)
+    {
+        //Compared with the mean block sum without dividing
+        if((int64_t)sums[i] * HASH_GRID * HASH_GRID > total)
+        {
+            hash |= (uint64_t)1 << i;
+        }
+    }
+    return hash;
+}
+
+int hash_distance(uint64_t a, uint64_t b)
+{
+    uint64_t difference = a ^ b;
+    int distance = 0;
+    while(difference)
+    {
+        difference &= difference - 1;
+        distance++;
+    }
+    return distance;
+}
+
+void result_cache_reset(struct ResultCache* cache)
+{
+    for(int i = 0; i < RESULT_CACHE_SIZE; i++)
+    {
+        cache->entries[i].valid = false;
+    }
+    cache->hits = 0;
+    cache->misses = 0;
+}
+
+//Looks for the closest valid entry within RESULT_CACHE_MAX_DISTANCE, returns true and its score on a hit
+bool result_cache_lookup(struct ResultCache* cache, uint64_t hash, uint32_t now, uint16_t* score)
+{
+    struct CacheEntry* best = nullptr;
+    int best_distance = RESULT_CACHE_MAX_DISTANCE + 1;
+    for(int i = 0; i < RESULT_CACHE_SIZE; i++)
+    {
+        struct CacheEntry* entry = &cache->entries[i];
+        if(!entry->valid)
+        {
+            continue;
+        }
+        if(now - entry->time_ms >= RESULT_CACHE_MAX_AGE)
+        {
+            entry->valid = false;
+            continue;
+        }
+        int distance = hash_distance(hash, entry->hash);
+        if(distance < best_distance)
+        {
+            best = entry;
+            best_distance = distance;
+        }
+    }
+    if(best == nullptr || best->reuses >= RESULT_CACHE_MAX_REUSES)
+    {
+        cache->misses++;
+        return false;
+    }
+    best->reuses++;
+    best->used_ms = now;
+    *score = best->score;
+    cache->hits++;
+    return true;
+}
+
+//Stores the result of an offloaded frame, replacing an entry of the same scene, a free one or the least recently used one
+void result_cache_insert(struct ResultCache* cache, uint64_t hash, uint16_t score, uint32_t now)
+{
+    struct CacheEntry* slot = nullptr;
+    for(int i = 0; i < RESULT_CACHE_SIZE && slot == nullptr; i++)
+    {
+        struct CacheEntry* entry = &cache->entries[i];
+        if(entry->valid && hash_distance(hash, entry->hash) <= RESULT_CACHE_MAX_DISTANCE)
+        {
+            slot = entry;
+        }
+    }
+    for(int i = 0; i < RESULT_CACHE_SIZE && slot == nullptr; i++)
+    {
+        if(!cache->entries[i].valid)
+        {
+            slot = &cache->entries[i];
+        }
+    }
+    if(slot == nullptr)
+    {
+        slot = &cache->entries[0];
+        for(int i = 1; i < RESULT_CACHE_SIZE; i++)
+        {
+            if(now - cache->entries[i].used_ms > now - slot->used_ms)
+            {
+                slot = &cache->entries[i];
+            }
+        }
+    }
+    slot->hash = hash;
+    slot->score = score;
+    slot->time_ms = now;
+    slot->used_ms = now;
+    slot->reuses = 0;
+    slot->valid = true;
+}
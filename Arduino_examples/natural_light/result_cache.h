@@ -0,0 +1,39 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_RESULT_CACHE_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_RESULT_CACHE_H_
+
+#include <stdint.h>
+
+//Reuse remote results of recently offloaded frames that look the same (see result_cache.cpp)
+#define RESULT_CACHE_ENABLED 1
+#define RESULT_CACHE_SIZE 8
+//Largest Hamming distance between two 64-bit frame hashes that still counts as the same scene
+#define RESULT_CACHE_MAX_DISTANCE 4
+//Results older than RESULT_CACHE_MAX_AGE ms are not reused, and an entry is reused at most RESULT_CACHE_MAX_REUSES times in a row before
+//the frame is offloaded again to refresh it
+#define RESULT_CACHE_MAX_AGE 120000
+#define RESULT_CACHE_MAX_REUSES 5
+
+struct CacheEntry
+{
+    uint64_t hash;
+    uint16_t score;         //remote result, 0 - 1000
+    uint32_t time_ms;       //when the result was received
+    uint32_t used_ms;       //last insertion or reuse (LRU order)
+    uint8_t reuses;
+    bool valid;
+};
+
+struct ResultCache
+{
+    struct CacheEntry entries[RESULT_CACHE_SIZE];
+    uint16_t hits;
+    uint16_t misses;
+};
+
+extern uint64_t frame_hash(const int8_t* luma, int width, int height);
+extern int hash_distance(uint64_t a, uint64_t b);
+extern void result_cache_reset(struct ResultCache* cache);
+extern bool result_cache_lookup(struct ResultCache* cache, uint64_t hash, uint32_t now, uint16_t* score);
+extern void result_cache_insert(struct ResultCache* cache, uint64_t hash, uint16_t score, uint32_t now);
+
+#endif
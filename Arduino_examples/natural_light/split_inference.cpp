@@ -0,0 +1,192 @@
+/*
+This script implements the split computing mode of the remote path. Instead of the image, the device runs the first split_layer operators of the person
+detection model and sends the intermediate activation, and the gateway finishes the network (Host_tools/split_model.py). Later split points cost more device
+compute but the activations get smaller, so the split point trades computation against radio bytes; it can be changed by the gateway at runtime.
+
+TFLM always invokes every operator of the graph, so the invoke functions of the registered kernels are wrapped: while a split run is active, the operators
+after the split point return without computing. Their outputs are never read, and the activation of the split point is not overwritten because no later
+operator runs. The activation is sent as a bitmap of the values different from the zero point followed by those values (optionally requantized to 4 bits).
+*/
+#include "split_inference.h"
+#include "op_profiler.h"
+#include <string.h>
+
+#define SPLIT_MAX_OPS 8
+
+typedef TfLiteStatus (*InvokeFunction)(TfLiteContext* context, TfLiteNode* node);
+
+int split_layer = SPLIT_LAYER_DEFAULT;
+
+static InvokeFunction original_invoke[SPLIT_MAX_OPS];
+static uint8_t wrapped_ops[SPLIT_MAX_OPS];
+//Index of the first operator that is skipped (-1 when no split run is active) and the operators invoked so far
+static int split_stop = -1;
+static int node_index = 0;
+
+template <int slot>
+static TfLiteStatus split_invoke(TfLiteContext* context, TfLiteNode* node)
+{
+    if(split_stop >= 0)
+    {
+        if(node_index >= split_stop)
+        {
+            return kTfLiteOk;
+        }
+        node_index++;
+    }
+#if OP_PROFILER_ENABLED
+    //The same wrapper times the operators in the profiling mode (see op_profiler.cpp)
+    if(op_profile.active)
+    {
+        uint32_t start = op_profiler_now();
+        TfLiteStatus status = original_invoke[slot](context, node);
+        op_profiler_record(&op_profile, wrapped_ops[slot], op_profiler_now() - start);
+        return status;
+    }
+#endif
+    return original_invoke[slot](context, node);
+}
+
+static const InvokeFunction wrappers[SPLIT_MAX_OPS] = {
+    split_invoke<0>, split_invoke<1>, split_invoke<2>, split_invoke<3>,
+    split_invoke<4>, split_invoke<5>, split_invoke<6>, split_invoke<7>
+};
+
+//Wraps the kernels of the given operators, has to be called once after they were added to the resolver and before the interpreter is built
+void split_wrap_resolver(tflite::MicroOpResolver& resolver, const tflite::BuiltinOperator* ops, int count)
+{
+    for(int i = 0; i < count && i < SPLIT_MAX_OPS; i++)
+    {
+        //The registrations are stored in the resolver itself, so the invoke function can be replaced in place
+        TfLiteRegistration* registration = const_cast<TfLiteRegistration*>(resolver.FindOp(ops[i]));
+        if(registration == nullptr || registration->invoke == wrappers[i])
+        {
+            continue;
+        }
+        original_invoke[i] = registration->invoke;
+        wrapped_ops[i] = ops[i];
+        registration->invoke = wrappers[i];
+    }
+}
+
+static void put_u16(uint8_t* out, uint16_t value)
+{
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+//Level of a value above the zero point with the given number of bits (0 is sent as a clear bit in the bitmap)
+static int split_level(int8_t value, int zero_point, int bits)
+{
+    int level = value - zero_point;
+    if(level < 0)
+    {
+        level = 0;
+    }
+    if(bits < 8)
+    {
+        int shift = 8 - bits;
+        level = (level + (1 << (shift - 1))) >> shift;
+        if(level > (1 << bits) - 1)
+        {
+            level = (1 << bits) - 1;
+        }
+    }
+    return level;
+}
+
+//Packs an int8 activation tensor ([1, height, width, channels]) into a split payload, returns its length or 0 if it does not fit into max_length bytes
+int split_encode(const TfLiteTensor* tensor, int layer, int bits, uint8_t* out, int max_length)
+{
+    if(tensor == nullptr || tensor->type != kTfLiteInt8 || tensor->dims->size != 4 || (bits != 8 && bits != 4))
+    {
+        return 0;
+    }
+    int height = tensor->dims->data[1];
+    int width = tensor->dims->data[2];
+    int channels = tensor->dims->data[3];
+    int count = height * width * channels;
+    int zero_point = tensor->params.zero_point;
+    const int8_t* values = tensor->data.int8;
+
+    int nonzero = 0;
+    for(int i = 0; i < count; i++)
+    {
+        nonzero += split_level(values[i], zero_point, bits) != 0;
+    }
+    int bitmap_length = (count + 7) / 8;
+    int length = SPLIT_HEADER_LENGTH + bitmap_length + (nonzero * bits + 7) / 8;
+    if(length > max_length)
+    {
+        return 0;
+    }
+
+    out[0] = SPLIT_MESSAGE;
+    out[1] = layer;
+    out[2] = bits;
+    out[3] = (uint8_t)(int8_t)zero_point;
+    put_u16(out + 4, height);
+    put_u16(out + 6, width);
+    put_u16(out + 8, channels);
+    uint32_t scale;
+    memcpy(&scale, &tensor->params.scale, sizeof(scale));
+    put_u16(out + 10, scale & 0xFFFF);
+    put_u16(out + 12, scale >> 16);
+
+    uint8_t* bitmap = out + SPLIT_HEADER_LENGTH;
+    uint8_t* packed = bitmap + bitmap_length;
+    memset(bitmap, 0, length - SPLIT_HEADER_LENGTH);
+    int bit = 0;
+    for(int i = 0; i < count; i++)
+    {
+        int level = split_level(values[i], zero_point, bits);
+        if(level == 0)
+        {
+            continue;
+        }
+        bitmap[i / 8] |= 1 << (i % 8);
+        if(bits == 8)
+        {
+            packed[bit / 8] = level;
+        }
+        else
+        {
+            packed[bit / 8] |= level << (bit % 8);
+        }
+        bit += bits;
+    }
+    return length;
+}
+
+//Runs the first layer operators of the model on the input already in the interpreter and packs the activation of the split point into out.
+//Returns the payload length, or 0 if the split point is not valid or the payload does not fit.
+int split_run(tflite::MicroInterpreter* interpreter, const tflite::Model* model, int layer, uint8_t* out, int max_length)
+{
+    const flatbuffers::Vector<flatbuffers::Offset<tflite::Operator>>* operators = model->subgraphs()->Get(0)->operators();
+    if(interpreter == nullptr || layer <= 0 || layer >= (int)operators->size())
+    {
+        return 0;
+    }
+    split_stop = layer;
+    node_index = 0;
+    //Not profiled: the skipped nodes would count as runs of a few ticks in the operator table of the full inference
+    TfLiteStatus status = interpreter->Invoke();
+    split_stop = -1;
+    if(status != kTfLiteOk)
+    {
+        return 0;
+    }
+    TfLiteTensor* activation = interpreter->tensor(operators->Get(layer - 1)->outputs()->Get(0));
+    return split_encode(activation, layer, SPLIT_BITS, out, max_length);
+}
+
+//Called for every value written into rxChar, returns true if the message selected a new split point
+bool split_on_message(const uint8_t* data, int length)
+{
+    if(length != SPLIT_CONFIG_LENGTH || data[0] != SPLIT_MESSAGE)
+    {
+        return false;
+    }
+    split_layer = data[1];
+    return true;
+}
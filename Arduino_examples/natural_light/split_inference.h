@@ -0,0 +1,28 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_SPLIT_INFERENCE_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_SPLIT_INFERENCE_H_
+
+#include <stdint.h>
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_op_resolver.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+//Number of model operators run on the device before the intermediate activation is offloaded (0 offloads the image). The gateway can
+//change it at runtime with a [SPLIT_MESSAGE, layer] write into rxChar.
+#define SPLIT_LAYER_DEFAULT 0
+//Bits per transmitted activation value (8 keeps the int8 values, 4 requantizes them to 16 levels above the zero point)
+#define SPLIT_BITS 8
+
+//Payload sent instead of the JPEG: [SPLIT_MESSAGE, layer, bits, zero point (int8), height (uint16 LE), width (uint16 LE), channels (uint16 LE),
+//scale (float32 LE)], a bitmap with a set bit for every value different from the zero point (ReLU outputs are mostly at the zero point),
+//then the values of the set bits packed with the given number of bits (LSB first)
+#define SPLIT_MESSAGE 0x5C
+#define SPLIT_HEADER_LENGTH 14
+#define SPLIT_CONFIG_LENGTH 2
+
+extern int split_layer;
+extern void split_wrap_resolver(tflite::MicroOpResolver& resolver, const tflite::BuiltinOperator* ops, int count);
+extern int split_run(tflite::MicroInterpreter* interpreter, const tflite::Model* model, int layer, uint8_t* out, int max_length);
+extern int split_encode(const TfLiteTensor* tensor, int layer, int bits, uint8_t* out, int max_length);
+extern bool split_on_message(const uint8_t* data, int length);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_TELEMETRY_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_TELEMETRY_H_
+
+#include <stdint.h>
+
+//Number of task slots in the per-task trace (indexed by TaskName)
+#define TELEMETRY_TASKS 8
+
+//Snapshot exposed to the gateway through the read-only telemetry characteristic (little-endian, packed)
+struct __attribute__((packed)) Telemetry
+{
+    uint16_t latency_samples;     //number of offload cycles in the latency distribution
+    uint32_t latency_last_ms;     //duration of the last offload cycle
+    uint32_t latency_p50_ms;      //median offload latency
+    uint32_t latency_estimate_ms; //percentile used by the deadline check
+    uint16_t task_last_ms[TELEMETRY_TASKS]; //last measured duration of every task, indexed by TaskName
+    uint32_t boot_ms;             //time from reset until the scheduler was ready
+    uint32_t arena_used_bytes;    //tensor arena used by AllocateTensors (0 until the interpreter is set up)
+    uint32_t ram_reserved_bytes;  //static RAM reserved for the tensor arena, JPEG and receive buffers
+    uint32_t transfer_ms;         //duration of the last image transfer (connection established until delivered)
+    uint16_t transfer_bytes;      //image bytes in the last transfer
+    uint16_t transfer_chunks;     //chunks sent in the last transfer, including retransmissions
+    uint16_t transfer_retransmitted; //chunks sent again after an acknowledgement timeout
+    uint16_t transfer_chunk_size; //chunk size used in the last transfer
+    uint32_t connect_first_byte_ms; //time from the connection (or the start of the cycle on a reused connection) to the first byte sent
+    uint32_t transfer_paused_ms;  //time the last transfer was paused waiting for the capacitor to recharge
+    uint16_t transfer_resumes;    //times the last transfer was resumed after a pause timeout or a lost connection
+    uint16_t thumbnail_source_bytes; //camera JPEG bytes of the last offloaded frame (transfer_bytes is the size actually sent)
+    uint16_t thumbnail_encode_ms; //time to re-encode the last thumbnail (decoding not included)
+    uint16_t split_layer;         //split point of the last offloaded frame (0 if the image was sent)
+    uint16_t split_compute_ms;    //time to run the model up to the split point and pack the activation
+    uint16_t result_gateway_ms;   //time the gateway needed for the last remote result (last chunk received to result sent)
+    uint16_t stale_results;       //results ignored because they belonged to an earlier frame or were repeated
+    uint16_t cache_hits;          //frames whose result was reused from the result cache instead of being offloaded
+    uint16_t cache_misses;        //frames that were offloaded although the result cache was checked
+    uint16_t preview_bytes;       //preview sent first by the progressive offload of the last frame (0 if the full image was sent directly)
+    uint16_t refinements;         //previews the gateway could not decide on and asked for the full image
+    uint16_t search_windows;      //windows of the multi-window search run for the last local inference
+    uint16_t search_ms;           //duration of the last multi-window search
+    uint16_t prefilter_ms;        //duration of the last cascade pre-filter run
+    uint16_t prefilter_rejects;   //frames on which the full model did not run because the pre-filter found no person
+    uint16_t model_index;         //model variant selected for the local inference (0 is the compiled-in model, n the n-th model store entry)
+    uint16_t model_switches;      //times the scheduler switched to another model variant
+    uint16_t decision_changes;    //changes of the smoothed person decision (see score_filter.h)
+    uint16_t decision_flicker;    //changes of the per-frame decision, suppressed by the filter when they do not last
+};
+
+#endif
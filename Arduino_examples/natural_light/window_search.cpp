@@ -0,0 +1,87 @@
+/*
+This script implements the multi-window person search of the local inference path. The model only takes a 96x96 input, so with a single centre crop a person
+standing at the edge of the 160x120 camera frame is missed. The frame is decoded once into a compact luma buffer (see phase_buffers in natural_light.ino), and
+the windows in search_windows are copied one after another into the model input and inferred, starting with the centre crop (the original behaviour). The search
+stops at the first window with a confident person score, or before a window that would not fit into the time or energy budget given by the scheduler, so
+a frame costs one inference in the best case and search_window_count inferences in the worst case.
+*/
+#include "window_search.h"
+#include "model_settings.h"
+#include "op_profiler.h"
+#include <Arduino.h>
+#include <string.h>
+
+//The centre window is the crop of DecodeAndProcessImage: it keeps whole MCUs and skips half of the others (rounded down) before them, (32, 8)
+static constexpr int centre_x = (SEARCH_FRAME_WIDTH / SEARCH_MCU_WIDTH - kNumCols / SEARCH_MCU_WIDTH) / 2 * SEARCH_MCU_WIDTH;
+static constexpr int centre_y = (SEARCH_FRAME_HEIGHT / SEARCH_MCU_HEIGHT - kNumRows / SEARCH_MCU_HEIGHT) / 2 * SEARCH_MCU_HEIGHT;
+
+//Centre crop first, then the four corners; neighbouring windows overlap by 32 (horizontally) and 72 (vertically) pixels
+const struct SearchWindow search_windows[] = {
+    {centre_x, centre_y},
+    {0, 0},
+    {64, 0},
+    {0, 24},
+    {64, 24},
+};
+const int search_window_count = sizeof(search_windows) / sizeof(search_windows[0]);
+
+//Measured duration of one window, used to decide if the next one still fits into the time budget
+static unsigned long window_ms = SEARCH_WINDOW_MS_DEFAULT;
+
+void search_crop(const int8_t* frame, int frame_width, const struct SearchWindow* window, int8_t* out, int width, int height)
+{
+    for(int y = 0; y < height; y++)
+    {
+        memcpy(out + y * width, frame + (window->y + y) * frame_width + window->x, width);
+    }
+}
+
+//Runs the model on the windows of a decoded SEARCH_FRAME_WIDTH x SEARCH_FRAME_HEIGHT frame within the budget, the result holds the scores of the
+//window most likely to contain a person
+TfLiteStatus search_run(tflite::MicroInterpreter* interpreter, const int8_t* frame, const struct SearchBudget* budget, struct SearchResult* result)
+{
+    TfLiteTensor* input = interpreter->input(0);
+    TfLiteTensor* output = interpreter->output(0);
+    unsigned long start = millis();
+    result->person_score = -128;
+    result->no_person_score = 127;
+    result->window = -1;
+    result->windows_run = 0;
+    result->confident = false;
+
+    TfLiteStatus status = kTfLiteOk;
+    for(int i = 0; i < search_window_count && !result->confident; i++)
+    {
+        if(result->windows_run > 0)
+        {
+            if(millis() - start + window_ms > budget->time_ms)
+            {
+                break;
+            }
+            if(budget->read_voltage != nullptr && budget->read_voltage() < budget->min_voltage)
+            {
+                break;
+            }
+        }
+        unsigned long window_start = millis();
+        search_crop(frame, SEARCH_FRAME_WIDTH, &search_windows[i], input->data.int8, kNumCols, kNumRows);
+        status = op_profiler_invoke(interpreter);
+        if(status != kTfLiteOk)
+        {
+            break;
+        }
+        window_ms = millis() - window_start;
+        result->windows_run++;
+
+        int8_t person = output->data.int8[kPersonIndex];
+        if(result->window < 0 || person > result->person_score)
+        {
+            result->person_score = person;
+            result->no_person_score = output->data.int8[kNotAPersonIndex];
+            result->window = i;
+        }
+        result->confident = person >= SEARCH_CONFIDENT_SCORE;
+    }
+    result->duration_ms = millis() - start;
+    return status;
+}
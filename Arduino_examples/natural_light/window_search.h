@@ -0,0 +1,52 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_WINDOW_SEARCH_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_WINDOW_SEARCH_H_
+
+#include <stdint.h>
+#include "tensorflow/lite/micro/micro_interpreter.h"
+
+//Multi-window person search: the local path decodes the whole camera frame (OV2640_160x120) once and runs the model on overlapping
+//96x96 windows of it (search_windows in window_search.cpp), instead of only on the centre crop
+#define SEARCH_ENABLED 1
+#define SEARCH_FRAME_WIDTH 160
+#define SEARCH_FRAME_HEIGHT 120
+#define SEARCH_FRAME_BYTES (SEARCH_FRAME_WIDTH * SEARCH_FRAME_HEIGHT)
+//JPEGDecoder MCU of the camera frames, DecodeAndProcessImage crops whole MCUs
+#define SEARCH_MCU_WIDTH 16
+#define SEARCH_MCU_HEIGHT 8
+//The search stops at the first window whose person score (int8 output, -128 - 127) reaches SEARCH_CONFIDENT_SCORE (about 0.8)
+#define SEARCH_CONFIDENT_SCORE 77
+//Duration of one window before the first one was measured (execution_time of F_local)
+#define SEARCH_WINDOW_MS_DEFAULT 1148
+
+struct SearchWindow
+{
+    int16_t x;
+    int16_t y;
+};
+
+//Limits handed to the search by the scheduler: a window is only started if it is expected to end within time_ms of the start of the search
+//and the voltage read before it is at least min_voltage. The first window always runs.
+struct SearchBudget
+{
+    unsigned long time_ms;
+    int min_voltage;
+    int (*read_voltage)();
+};
+
+struct SearchResult
+{
+    int8_t person_score;        //scores of the window with the highest person score
+    int8_t no_person_score;
+    int8_t window;              //index of that window in search_windows
+    uint8_t windows_run;
+    uint16_t duration_ms;
+    bool confident;             //stopped early on a confident window
+};
+
+extern const struct SearchWindow search_windows[];
+extern const int search_window_count;
+
+extern void search_crop(const int8_t* frame, int frame_width, const struct SearchWindow* window, int8_t* out, int width, int height);
+extern TfLiteStatus search_run(tflite::MicroInterpreter* interpreter, const int8_t* frame, const struct SearchBudget* budget, struct SearchResult* result);
+
+#endif
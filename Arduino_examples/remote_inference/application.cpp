@@ -17,22 +17,29 @@ struct Task application[TASK_AMOUNT];
 //Parameters used for the BLE communication
 char* uuidOftxChar = "UUID_TX_CHAR"; // example -> char* uuidOftxChar = "2d2F88c4-f244-5a80-21f1-ee0224e80658"
 char* uuidOfrxChar = "UUID_RX_CHAR"; // example -> char* uuidOfrxChar = "00002A3D-0000-1000-8000-00805f9b34fb"
+char* uuidOftelemetryChar = "UUID_TELEMETRY_CHAR"; // example -> char* uuidOftelemetryChar = "6e7b2c31-4f0a-4d8e-9a51-3c2d7f1e0b44"
 char* uuidOfService = "UUID_SERVICE"; // example -> char* uuidOfService = "180F"
 char* nameofPeripheral = "NAME_PERIPHERAL"; // example -> char* nameofPeripheral = "BLESender"
 int RX_BUFFER_SIZE = 220;
 bool RX_BUFFER_FIXED_LENGTH = false;
-char prediction_status[]="";
-unsigned long prevNow = 0;
-bool wasConnected = false;
 byte tmp[256];
+bool result_received = false;
+struct FrameResult remote_result;
+struct Telemetry telemetry;
 BLEService bleService(uuidOfService);
+#if TRANSFER_MODE == TRANSFER_NOTIFY_WINDOWED
+BLECharacteristic txChar(uuidOftxChar, BLENotify, TRANSFER_CHUNK_MAX, RX_BUFFER_FIXED_LENGTH);
+#else
 BLECharacteristic txChar(uuidOftxChar, BLEIndicate, RX_BUFFER_SIZE, RX_BUFFER_FIXED_LENGTH);
+#endif
 BLECharacteristic rxChar(uuidOfrxChar, BLEWriteWithoutResponse | BLEWrite, RX_BUFFER_SIZE, RX_BUFFER_FIXED_LENGTH);
+BLECharacteristic telemetryChar(uuidOftelemetryChar, BLERead, sizeof(struct Telemetry), true);
 
 void app_init()
 {
     application[F_camera].task_name = F_camera;
-    application[F_camera].execution_time = 1049;
+    //Capture only, the measured 1049 ms included decoding which the remote path does not need (to be re-measured with the PPK2)
+    application[F_camera].execution_time = 749;
     application[F_camera].task_priority = 3;
     application[F_camera].first_task = 1;
     application[F_camera].children = 2;
@@ -66,6 +73,12 @@ void app_init()
 
 }
 
+//Time between two captures: camera execution plus the wait edge back to the camera task
+unsigned long capture_period()
+{
+    return application[F_camera].execution_time + application[F_camera].child[0].constraint_value;
+}
+
 struct Task *get_task_ti(struct TaskInstance *ti)
 {
     return &(application[ti->task_id]);
@@ -78,18 +91,57 @@ struct Task *get_task_e(struct Edge *e)
 
 void blePeripheralConnectHandler(BLEDevice central)
 {
-  //empty callback 
+  transfer_on_connect();
+  session_on_connect(central);
 }
 
 void blePeripheralDisconnectHandler(BLEDevice central)
 {
-  //empty callback
+  session_on_disconnect();
+}
 
+//Transfers start as soon as the gateway subscribed to txChar
+void onTxCharSubscriptionChanged(BLEDevice central, BLECharacteristic characteristic)
+{
+  session_on_subscribe(characteristic.subscribed());
 }
 
 void onRxCharValueUpdate(BLEDevice central, BLECharacteristic characteristic) {
 
-  int dataLength = rxChar.readValue(tmp, 256);
+  byte message[256];
+  int dataLength = rxChar.readValue(message, 256);
+  if(transfer_on_message(message, dataLength))
+  {
+    return;
+  }
+  //A late result of an earlier frame (or a repeated one) is ignored
+  int match = frame_match_result(message, dataLength, transfer_frame_id(), result_received, &remote_result);
+  if(match != FRAME_MATCH_NONE)
+  {
+    result_received = result_received || match == FRAME_MATCH_ACCEPTED;
+    return;
+  }
+  memcpy(tmp, message, dataLength);
+}
+
+//Publish the boot time and RAM report of this configuration
+void update_telemetry(void)
+{
+  telemetryChar.writeValue((byte*)&telemetry, sizeof(struct Telemetry));
+}
+
+//Throughput of the last image transfer (bytes / duration) as seen by the device
+void update_transfer_telemetry(void)
+{
+  telemetry.transfer_ms = transfer_stats.duration_ms;
+  telemetry.transfer_bytes = transfer_stats.bytes;
+  telemetry.transfer_chunks = transfer_stats.chunks;
+  telemetry.transfer_retransmitted = transfer_stats.retransmitted;
+  telemetry.transfer_chunk_size = transfer_stats.chunk_size;
+  telemetry.connect_first_byte_ms = session_connect_latency();
+  telemetry.transfer_paused_ms = transfer_stats.paused_ms;
+  telemetry.transfer_resumes = transfer_stats.resumes;
+  telemetryChar.writeValue((byte*)&telemetry, sizeof(struct Telemetry));
 }
 
 void initBLE(void){
@@ -98,63 +150,58 @@ void initBLE(void){
   BLE.setAdvertisedService(bleService);
   bleService.addCharacteristic(rxChar);
   bleService.addCharacteristic(txChar); 
+  bleService.addCharacteristic(telemetryChar);
+  update_telemetry();
   BLE.addService(bleService);
   BLE.setEventHandler(BLEConnected, blePeripheralConnectHandler);
   BLE.setEventHandler(BLEDisconnected, blePeripheralDisconnectHandler);
+  txChar.setEventHandler(BLESubscribed, onTxCharSubscriptionChanged);
+  txChar.setEventHandler(BLEUnsubscribed, onTxCharSubscriptionChanged);
   rxChar.setEventHandler(BLEWritten, onRxCharValueUpdate);
   BLE.advertise(); 
 }
 
-void send_image()
+//Keeps the connection until the result of the transferred frame arrives or the timeout passes
+static void wait_for_result(unsigned long timeout)
 {
-    initBLE();
-    while(wasConnected == false)
+    unsigned long start = millis();
+    while(!result_received && BLE.connected() && millis() - start < timeout)
     {
         BLE.poll();
-        long now = millis();
-        if(now-prevNow >= 5000)
+    }
+}
+
+void send_image()
+{
+    result_received = false;
+    //Keep the connection of the previous cycle if the next capture follows soon and there is enough energy
+    bool reused = session_start(session_select(capture_period(), read_voltage()));
+    if(reused)
+    {
+        update_telemetry();
+    }
+    //An interrupted transfer (capacitor drained or connection lost) is resumed from the last acknowledged chunk, also after a reconnection
+    bool delivered = false;
+    int attempts = 0;
+    while(!delivered && attempts <= TRANSFER_MAX_RESUMES && session_wait_subscribed(SESSION_CONNECT_TIMEOUT))
+    {
+        if(attempts == 0)
         {
-            prevNow = now;
-            if(BLE.connected() && wasConnected == false)
-            {
-                if(jpeg_length == 3080)
-                {
-                  int i=0;
-                  while(i<jpeg_length)
-                  {
-                    txChar.writeValue(jpeg_buffer+i, 220);
-                    i+=220;
-                  }
-                  wasConnected = true;
-                }
-                else
-                {
-                  int i=0;
-                  while(i<jpeg_length)
-                  {
-                    txChar.writeValue(jpeg_buffer+i, 220);
-                    i+=220;
-                  }
-                  int k = 7;
-                  sprintf(prediction_status, "%d", k);
-                  int j=0;
-                  while(j<1)
-                  {
-                    txChar.writeValue(prediction_status+j);
-                    j+=1;
-                  }
-                  wasConnected = true;
-                }
-
-                delay(1000);
-                
-                BLE.disconnect();
-                BLE.end();
-            }
+            session_first_byte();
         }
+        delivered = transfer_image(jpeg_buffer, jpeg_length);
+        attempts++;
     }
-
-    wasConnected = false;
+    if(delivered)
+    {
+        wait_for_result(RESULT_TIMEOUT);
+    }
+    else
+    {
+        transfer_abort();
+    }
+    update_transfer_telemetry();
+    session_end();
 }
 
 void led2_task()
@@ -162,7 +209,8 @@ void led2_task()
   pinMode(LEDR, OUTPUT);
   pinMode(LEDG, OUTPUT);
 
-  if (char(tmp[0])=='5' || char(tmp[0])=='6' || char(tmp[0])=='7' || char(tmp[0])=='8' || char(tmp[0])=='9') {
+  //No result (timeout or stale answers only) is shown as no person
+  if (result_received && remote_result.score >= RESULT_PERSON_THRESHOLD) {
     digitalWrite(LEDG, LOW);
     digitalWrite(LEDR, HIGH);
     delay(500);
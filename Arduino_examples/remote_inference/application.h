@@ -14,17 +14,28 @@
 #include "tensorflow/lite/version.h"
 #include <ArduinoBLE.h>
 #include "tasks.h"
+#include "telemetry.h"
+#include "image_transfer.h"
+#include "ble_session.h"
 
 extern int RX_BUFFER_SIZE;
 extern bool RX_BUFFER_FIXED_LENGTH;
-extern unsigned long prevNow;
-extern bool wasConnected;
 extern char* uuidOftxChar;
 extern char* uuidOfrxChar;
+extern char* uuidOftelemetryChar;
 extern char* uuidOfService;
 extern char* nameofPeripheral;
 extern byte tmp[256];
 
+//Remote inference result (see frame_codec.h): person if the score is at least RESULT_PERSON_THRESHOLD per mille. After the transfer the device
+//waits up to RESULT_TIMEOUT ms for the result of the frame it sent.
+#define RESULT_PERSON_THRESHOLD 500
+#define RESULT_TIMEOUT 1000
+extern struct FrameResult remote_result;
+extern bool result_received;
+
+extern struct Telemetry telemetry;
+
 #define TASK_AMOUNT 3
 
 typedef enum TaskName
@@ -41,13 +52,19 @@ extern struct Task *get_task_e(struct Edge *e);
 extern void execute(struct TaskInstance *selected_task);
 
 //BLE functions
+extern BLECharacteristic txChar;
+extern BLECharacteristic rxChar;
 extern void blePeripheralConnectHandler(BLEDevice central);
 extern void blePeripheralDisconnectHandler(BLEDevice central);
+extern void onTxCharSubscriptionChanged(BLEDevice central, BLECharacteristic characteristic);
 extern void onRxCharValueUpdate(BLEDevice central, BLECharacteristic characteristic);
 extern void initBLE(void);
+extern void update_telemetry(void);
+extern void update_transfer_telemetry(void);
 
 //All defined functions
 extern void send_image();
+extern unsigned long capture_period();
 extern int read_voltage();
 extern void led2_task();
 
@@ -26,9 +26,6 @@ decoding and processing the captured image as an input for the next task in the
 #error Please select the hardware platform and camera module in the Arduino/libraries/ArduCAM/memorysaver.h
 #endif
 
-// The size of our temporary buffer for holding
-// JPEG data received from the Arducam module
-#define MAX_JPEG_BYTES 4096
 // The pin connected to the Arducam Chip Select
 #define CS 7
 
@@ -244,6 +241,7 @@ TfLiteStatus GetImage(tflite::ErrorReporter* error_reporter, int image_width,
   TfLiteStatus read_data_status = ReadData(error_reporter);
   if (read_data_status != kTfLiteOk) {
     //TF_LITE_REPORT_ERROR(error_reporter, "ReadData failed");
+    jpeg_length = 0;
     return read_data_status;
   }
 
@@ -258,9 +256,11 @@ TfLiteStatus GetImage(tflite::ErrorReporter* error_reporter, int image_width,
 }
 
 // Enables the camera initialization after it is turned off when the load switch is used
-void initialize_camera(tflite::ErrorReporter* error_reporter, int image_width, int image_height, int channels, int8_t* image_data) {
+// Capture stage: initialize the camera, take a picture and read the raw JPEG into jpeg_buffer.
+// The frame is not decoded here, so cycles that only offload the JPEG skip the decoding cost.
+TfLiteStatus capture_image(tflite::ErrorReporter* error_reporter) {
 
-  //Serial.println("I am in initialize camera!");
+  //Serial.println("I am in capture image!");
   TfLiteStatus init_status = InitCamera(error_reporter);
   if (init_status != kTfLiteOk) {
     //TF_LITE_REPORT_ERROR(error_reporter, "InitCamera failed");
@@ -276,16 +276,36 @@ void initialize_camera(tflite::ErrorReporter* error_reporter, int image_width, i
   TfLiteStatus read_data_status = ReadData(error_reporter);
   if (read_data_status != kTfLiteOk) {
     //TF_LITE_REPORT_ERROR(error_reporter, "ReadData failed");
-    //return read_data_status;
+    jpeg_length = 0;
+    return read_data_status;
+  }
+
+  return kTfLiteOk;
+}
+
+// Decode stage: decode the JPEG already held in jpeg_buffer into the model input
+TfLiteStatus decode_image(tflite::ErrorReporter* error_reporter, int image_width, int image_height, int8_t* image_data) {
+
+  if (jpeg_length == 0) {
+    return kTfLiteError;
   }
 
   TfLiteStatus decode_status = DecodeAndProcessImage(error_reporter, image_width, image_height, image_data);
   if (decode_status != kTfLiteOk) {
     //TF_LITE_REPORT_ERROR(error_reporter, "DecodeAndProcessImage failed");
-    //return decode_status;
+    return decode_status;
   }
 
-  //return kTfLiteOk;
+  return kTfLiteOk;
+}
+
+// Full cycle (capture and decode) kept for the examples that always run inference locally
+void initialize_camera(tflite::ErrorReporter* error_reporter, int image_width, int image_height, int channels, int8_t* image_data) {
+
+  if (capture_image(error_reporter) != kTfLiteOk) {
+    return;
+  }
+  decode_image(error_reporter, image_width, image_height, image_data);
 }
 
 #endif  // ARDUINO_EXCLUDE_CODE
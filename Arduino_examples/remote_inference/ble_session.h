@@ -0,0 +1,34 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_BLE_SESSION_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_BLE_SESSION_H_
+
+#include <ArduinoBLE.h>
+
+//Set to 0 to always bring the BLE stack up and down for every transfer (original behaviour)
+#define SESSION_PERSISTENT_ENABLED 1
+
+//The connection is kept alive between cycles only if the next capture follows within SESSION_MAX_PERIOD ms and the storage voltage
+//is at least SESSION_MIN_VOLTAGE mV, otherwise keeping the radio connected costs more than establishing a new connection
+#define SESSION_MAX_PERIOD 15000
+#define SESSION_MIN_VOLTAGE 4200
+
+//Connection parameters requested for persistent sessions: interval in 1.25 ms units, slave latency in connection events
+//(connection events the device may skip when it has nothing to send) and supervision timeout in 10 ms units
+#define SESSION_INTERVAL_MIN 40
+#define SESSION_INTERVAL_MAX 80
+#define SESSION_SLAVE_LATENCY 4
+#define SESSION_SUPERVISION_TIMEOUT 400
+//Time the transfer task waits for a central to connect and subscribe before it gives up
+#define SESSION_CONNECT_TIMEOUT 30000
+
+extern bool session_select(unsigned long capture_period, int voltage);
+extern bool session_start(bool persistent);
+extern void session_end();
+extern void session_on_connect(BLEDevice central);
+extern void session_on_disconnect();
+extern void session_on_subscribe(bool subscribed);
+extern bool session_wait_subscribed(unsigned long timeout);
+extern void session_first_byte();
+extern unsigned long session_connect_latency();
+extern uint16_t session_mtu();
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_FRAME_CODEC_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_FRAME_CODEC_H_
+
+#include <stdint.h>
+
+//Message types (first byte of every message exchanged over txChar and rxChar)
+#define FRAME_DATA 0xD0
+#define FRAME_ACK 0xAC
+#define FRAME_NACK 0xAE
+#define FRAME_RESULT 0xE5
+#define FRAME_REFINE 0xE6
+
+//Data chunk sent by the device: [FRAME_DATA, frame id, chunk index (uint16 LE), total length (uint16 LE), CRC-16 (uint16 LE), payload]
+//The CRC covers the first 6 header bytes and the payload
+#define FRAME_HEADER_LENGTH 8
+//Acknowledgement written by the gateway: [FRAME_ACK, frame id, next expected chunk (uint16 LE), ATT MTU (uint16 LE)]
+#define FRAME_ACK_LENGTH 6
+//Negative acknowledgement written by the gateway when chunks are missing: [FRAME_NACK, frame id, next expected chunk (uint16 LE), ATT MTU (uint16 LE),
+//span, bitmap (uint32 LE)]. The bitmap covers the span chunks starting with the next expected one, a set bit marks a missing chunk and a clear bit
+//a received one. Everything before the next expected chunk is acknowledged, as with FRAME_ACK.
+#define FRAME_NACK_LENGTH 11
+#define FRAME_NACK_SPAN 32
+//Result of the remote inference written by the gateway: [FRAME_RESULT, frame id, person score in per mille (uint16 LE), gateway latency ms (uint16 LE),
+//flags, bounding box x0, y0, x1, y1]. The box coordinates are fractions of the image width and height (0 - 255) and only valid with FRAME_RESULT_BOX.
+#define FRAME_RESULT_LENGTH 11
+#define FRAME_RESULT_BOX 0x01
+//What a received message is for the device waiting for the result of its last frame (frame_match_result)
+#define FRAME_MATCH_NONE 0          //not a result message
+#define FRAME_MATCH_ACCEPTED 1      //the result of the frame
+#define FRAME_MATCH_STALE 2         //result of another frame, or a repeated one after the result was taken
+//Refinement request written by the gateway instead of a result when the preview of a progressive offload is not enough for a confident decision:
+//[FRAME_REFINE, frame id of the preview]. The device answers with the next, larger image of the same capture.
+#define FRAME_REFINE_LENGTH 2
+
+struct FrameChunk
+{
+    uint8_t frame_id;
+    uint16_t index;
+    uint16_t total_length;
+    const uint8_t* payload;
+    int payload_length;
+};
+
+struct FrameAck
+{
+    uint8_t frame_id;
+    uint16_t next;
+    uint16_t mtu;
+    uint8_t span;       //0 for FRAME_ACK
+    uint32_t missing;   //bitmap of missing chunks (FRAME_NACK only)
+};
+
+struct FrameResult
+{
+    uint8_t frame_id;       //frame the result belongs to
+    uint16_t score;         //person score, 0 - 1000
+    uint16_t latency_ms;    //time from the last chunk to the result on the gateway
+    uint8_t flags;
+    uint8_t box[4];         //x0, y0, x1, y1
+};
+
+extern uint16_t frame_crc16(const uint8_t* data, int length, uint16_t crc);
+extern int frame_encode_chunk(uint8_t* out, uint8_t frame_id, uint16_t index, uint16_t total_length, const uint8_t* payload, int payload_length);
+extern bool frame_decode_chunk(const uint8_t* data, int length, struct FrameChunk* chunk);
+extern int frame_encode_ack(uint8_t* out, uint8_t frame_id, uint16_t next, uint16_t mtu);
+extern int frame_encode_nack(uint8_t* out, uint8_t frame_id, uint16_t next, uint16_t mtu, uint8_t span, uint32_t missing);
+extern bool frame_decode_ack(const uint8_t* data, int length, struct FrameAck* ack);
+extern int frame_encode_result(uint8_t* out, const struct FrameResult* result);
+extern bool frame_decode_result(const uint8_t* data, int length, struct FrameResult* result);
+extern int frame_match_result(const uint8_t* data, int length, uint8_t frame_id, bool received, struct FrameResult* result);
+extern int frame_encode_refine(uint8_t* out, uint8_t frame_id);
+extern bool frame_decode_refine(const uint8_t* data, int length, uint8_t* frame_id);
+
+#endif
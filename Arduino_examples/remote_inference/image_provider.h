@@ -4,9 +4,17 @@
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/micro/micro_error_reporter.h"
 
+// The size of our temporary buffer for holding
+// JPEG data received from the Arducam module
+// No tensor arena is reserved in the remote-only task graph, so part of that RAM is
+// given to the JPEG buffer (larger/higher quality frames can be offloaded)
+#define MAX_JPEG_BYTES (16*1024)
+
 TfLiteStatus GetImage(tflite::ErrorReporter* error_reporter, int image_width, int image_height, int channels, int8_t* image_data);
+extern TfLiteStatus capture_image(tflite::ErrorReporter* error_reporter);
+extern TfLiteStatus decode_image(tflite::ErrorReporter* error_reporter, int image_width, int image_height, int8_t* image_data);
 extern void initialize_camera(tflite::ErrorReporter* error_reporter, int image_width, int image_height, int channels, int8_t* image_data);
-extern unsigned char jpeg_buffer[4096];
+extern unsigned char jpeg_buffer[MAX_JPEG_BYTES];
 extern int jpeg_length;                      
 
 #endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_IMAGE_PROVIDER_H_
@@ -31,15 +31,10 @@ Once the enough energy is collected in the capacitor, the scheduled application
 #include "application.h"
 
 //Globals used for compatibility with Arduino-style sketches
+//The remote-only task graph never runs Invoke(), so no model, interpreter or tensor arena is set up
+//and the RAM otherwise taken by the arena is available for the JPEG buffer (see MAX_JPEG_BYTES)
 namespace{
 tflite::ErrorReporter* error_reporter = nullptr;
-const tflite::Model* model = nullptr;
-tflite::MicroInterpreter* interpreter = nullptr;
-TfLiteTensor* input = nullptr;   
-
-//An area of memory used for input, output, and intermediate arrays
-constexpr int kTensorArenaSize = 136*1024;
-static uint8_t tensor_arena[kTensorArenaSize];
 }
 
 #define MAX_TASK_AMOUNT 10
@@ -47,6 +42,7 @@ struct TaskInstance TSK_LIST[MAX_TASK_AMOUNT];
 int OCC_LIST[MAX_TASK_AMOUNT] = {0};
 int V_0;
 int V_req;
+unsigned long boot_time_ms;
 
 int main(void){
 
@@ -277,7 +273,8 @@ int read_voltage()
 void camera_task()
 {
     digitalWrite(2, HIGH);
-    initialize_camera(error_reporter, kNumCols, kNumRows, kNumChannels, input->data.int8);
+    //Only the raw JPEG is offloaded, so the frame is never decoded on the device
+    capture_image(error_reporter);
     digitalWrite(2, LOW);
 }
 
@@ -292,36 +289,13 @@ void setup()
   pinMode(4, OUTPUT);
   digitalWrite(4, LOW);
 
-  tflite::MicroErrorReporter micro_error_reporter;
+  static tflite::MicroErrorReporter micro_error_reporter;
   error_reporter = &micro_error_reporter;
-  //Map the model into a usable data structure. This is a very lightweight operation!
-  model = tflite::GetModel(g_person_detect_model_data);
-  if(model->version() != TFLITE_SCHEMA_VERSION){
-    TF_LITE_REPORT_ERROR(error_reporter, "Model provided is schema version %d not equal "
-                          "to supported version %d.", model->version(), TFLITE_SCHEMA_VERSION);
-    return;
-  }
-  static tflite::MicroMutableOpResolver<5> micro_op_resolver;
-  micro_op_resolver.AddAveragePool2D();
-  micro_op_resolver.AddConv2D();
-  micro_op_resolver.AddDepthwiseConv2D();
-  micro_op_resolver.AddReshape();
-  micro_op_resolver.AddSoftmax();
-
-  //Interpreter used to run the model 
-  static tflite::MicroInterpreter static_interpreter(model, micro_op_resolver, tensor_arena, kTensorArenaSize, error_reporter);
-  interpreter = &static_interpreter;
-
-  //Allocate the memory from the tensor_arena for the model's tensors.
-  TfLiteStatus allocate_status = interpreter->AllocateTensors();
-  if(allocate_status != kTfLiteOk){
-    TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors () failed!");
-    return;
-  }
-
-  //Information about the memory area used for the model's input 
-  input = interpreter->input(0);
   setupScheduler();
+  boot_time_ms = millis();
+  telemetry.boot_ms = boot_time_ms;
+  telemetry.arena_used_bytes = 0;
+  telemetry.ram_reserved_bytes = MAX_JPEG_BYTES + sizeof(tmp);
 }
 
 void loop()
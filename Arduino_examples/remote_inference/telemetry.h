@@ -0,0 +1,30 @@
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_TELEMETRY_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_TELEMETRY_H_
+
+#include <stdint.h>
+
+//Number of task slots in the per-task trace (indexed by TaskName)
+#define TELEMETRY_TASKS 8
+
+//Snapshot exposed to the gateway through the read-only telemetry characteristic (little-endian, packed)
+struct __attribute__((packed)) Telemetry
+{
+    uint16_t latency_samples;     //number of offload cycles in the latency distribution
+    uint32_t latency_last_ms;     //duration of the last offload cycle
+    uint32_t latency_p50_ms;      //median offload latency
+    uint32_t latency_estimate_ms; //percentile used by the deadline check
+    uint16_t task_last_ms[TELEMETRY_TASKS]; //last measured duration of every task, indexed by TaskName
+    uint32_t boot_ms;             //time from reset until the scheduler was ready
+    uint32_t arena_used_bytes;    //tensor arena used by AllocateTensors (0 until the interpreter is set up)
+    uint32_t ram_reserved_bytes;  //static RAM reserved for the tensor arena, JPEG and receive buffers
+    uint32_t transfer_ms;         //duration of the last image transfer (connection established until delivered)
+    uint16_t transfer_bytes;      //image bytes in the last transfer
+    uint16_t transfer_chunks;     //chunks sent in the last transfer, including retransmissions
+    uint16_t transfer_retransmitted; //chunks sent again after an acknowledgement timeout
+    uint16_t transfer_chunk_size; //chunk size used in the last transfer
+    uint32_t connect_first_byte_ms; //time from the connection (or the start of the cycle on a reused connection) to the first byte sent
+    uint32_t transfer_paused_ms;  //time the last transfer was paused waiting for the capacitor to recharge
+    uint16_t transfer_resumes;    //times the last transfer was resumed after a pause timeout or a lost connection
+};
+
+#endif
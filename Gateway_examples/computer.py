@@ -1,13 +1,16 @@
 """
 This script enables the IoT gateway to receieve the capture image or final local inference results from the Arduino board (or any other connected device).
+The local inference results of local_inference_send are either written over a connection, or (RESULT_REPORT_ADVERTISING on the Arduino board) carried in the
+manufacturer data of advertisements, which the gateway receives by scanning without connecting to the board.
 """
 import asyncio
-from datetime import datetime
+from datetime import datetime, timedelta
 import os 
 import io
 from typing import Any, Callable
 from PIL import Image
-from bleak import BleakClient
+from bleak import BleakClient, BleakScanner
+import struct
 
 #BLE configuration
 #Must be the same as service uuid used with the Arduino board
@@ -17,8 +20,71 @@ message_uuid = "MESSAGE_UUID" #example -> message_uuid = "2d2F88c4-f244-5a80-21f
 #MAC address of the Arduino board
 address = "MAC_ADDRESS" #example -> address = "8D:3E:BD:BE:13:3E"
 data_buffer_size = 4096
+#How the local inference results are received, must match RESULT_REPORT_MODE on the Arduino board: "advertising" (scanning) or "connected"
+report_mode = "advertising"
+#Must be the same as ADVERT_COMPANY_ID used with the Arduino board
+advert_company_id = 0xFFFF
+ADVERT_REPORT_VERSION = 1
+#Batch of logged results (see result_log.h)
+RESULT_LOG_MESSAGE = 0xB1
+RESULT_LOG_HEADER_LENGTH = 8
+RESULT_LOG_ENTRY_LENGTH = 9
+RESULT_STRATEGIES = {0: "local", 1: "remote"}
 output_file = "captured_data.txt"
 
+#Decodes the manufacturer data of a result advertisement (see advert_report.h), returns None if it is not a result report
+def decode_result_report(data):
+    if len(data) < 10 or data[0] != ADVERT_REPORT_VERSION:
+        return None
+    version, result, confidence, sequence, voltage, radio_on, flags = struct.unpack("<BBBHHHB", bytes(data[0:10]))
+    return {"result": result, "confidence": confidence, "sequence": sequence, "voltage_mv": voltage,
+            "radio_on_ms": radio_on, "previous_connected": bool(flags & 0x01)}
+
+#Decodes a batch of logged results, the device time of every entry is converted to the gateway time using the device time sent with the batch
+def decode_result_log(data, received=None):
+    data = bytes(data)
+    if len(data) < RESULT_LOG_HEADER_LENGTH or data[0] != RESULT_LOG_MESSAGE:
+        return None
+    received = received or datetime.now()
+    _, count, dropped, device_now = struct.unpack("<BBHI", data[0:RESULT_LOG_HEADER_LENGTH])
+    if len(data) < RESULT_LOG_HEADER_LENGTH + count * RESULT_LOG_ENTRY_LENGTH:
+        return None
+    entries = []
+    for i in range(count):
+        offset = RESULT_LOG_HEADER_LENGTH + i * RESULT_LOG_ENTRY_LENGTH
+        time_ms, person, no_person, voltage, strategy = struct.unpack("<IbbHB", data[offset:offset + RESULT_LOG_ENTRY_LENGTH])
+        entries.append({"time": received - timedelta(milliseconds=(device_now - time_ms) & 0xFFFFFFFF),
+                        "person_score": person, "no_person_score": no_person, "result": 1 if person > no_person else 0,
+                        "voltage_mv": voltage, "strategy": RESULT_STRATEGIES.get(strategy, strategy)})
+    return {"dropped": dropped, "entries": entries}
+
+class AdvertisementReceiver:
+
+    def __init__(self):
+        self.last_sequence = None
+
+    #Every burst repeats the same report, so only the first advertisement of a sequence number is used
+    def detection_callback(self, device, advertisement_data):
+        if device.address != address:
+            return
+        data = advertisement_data.manufacturer_data.get(advert_company_id)
+        report = decode_result_report(data) if data else None
+        if report is None or report["sequence"] == self.last_sequence:
+            return
+        self.last_sequence = report["sequence"]
+        if report["result"] == 1:
+            print("Person is detected -> Local inference! (confidence {}%)".format(report["confidence"]))
+        else:
+            print("Person is not detected -> Local inference! (confidence {}%)".format(report["confidence"]))
+        print("Report {}: voltage {} mV, radio on for the previous report: {} ms ({})".format(report["sequence"], report["voltage_mv"],
+              report["radio_on_ms"], "connected" if report["previous_connected"] else "advertising"))
+
+    async def scan(self):
+        scanner = BleakScanner(detection_callback=self.detection_callback)
+        await scanner.start()
+        while True:
+            await asyncio.sleep(1.0)
+
 class ArduinoConnection:
 
     client: BleakClient = None
@@ -61,6 +127,8 @@ class ArduinoConnection:
     def on_disconnect(self, client: BleakClient):
         self.connected = False
         self.onConnection = False
+        #Connected reporting path: time the board kept the connection, compare with the radio-on time of the advertising path
+        print("Connection lasted {} ms".format(int((datetime.now() - self.last_packet_time).total_seconds() * 1000)))
 
         # print("I am in the on_disconnect function!")
     
@@ -68,7 +136,17 @@ class ArduinoConnection:
         
         # print(len(data))
 
-        if (len(data) == 220):
+        batch = decode_result_log(data)
+        if batch is not None:
+            if batch["dropped"]:
+                print("{} results were overwritten on the device before they were sent".format(batch["dropped"]))
+            for entry in batch["entries"]:
+                print("{} Person is {}detected -> {} inference! (scores {}/{}, {} mV)".format(entry["time"].strftime("%Y-%m-%d %H:%M:%S"),
+                      "" if entry["result"] else "not ", entry["strategy"].capitalize(), entry["person_score"], entry["no_person_score"], entry["voltage_mv"]))
+                self.data_buffer_cleaner("{},{},{},{},{}".format(entry["time"].isoformat(), entry["result"], entry["person_score"],
+                                         entry["no_person_score"], entry["voltage_mv"]))
+
+        elif (len(data) == 220):
             self.dataByte = data
             self.dataMap[self.m:self.n] = self.dataByte
             self.counter=self.counter+1
@@ -144,6 +222,7 @@ class ArduinoConnection:
                     self.char_object = char
                     self.connected = await self.client.is_connected()
                     if self.connected:
+                        self.last_packet_time = datetime.now()
                         print("Connected to Device")
                         self.client.set_disconnected_callback(self.on_disconnect)
                         await self.client.start_notify(
@@ -195,11 +274,14 @@ if __name__ == "__main__":
     os.environ["PYTHONASYNCIODEBUG"] = str(1)
     loop = asyncio.get_event_loop()
     data_to_file = DataToFile(output_file)
-    connection = ArduinoConnection(loop, message_uuid, service_uuid, data_buffer_size, data_to_file.write_to_txt)
+    connection = ArduinoConnection(loop, message_uuid, service_uuid, data_to_file.write_to_txt, data_buffer_size)
 
     try:
         asyncio.ensure_future(main())
-        asyncio.ensure_future(connection.manager())
+        if report_mode == "advertising":
+            asyncio.ensure_future(AdvertisementReceiver().scan())
+        else:
+            asyncio.ensure_future(connection.manager())
         loop.run_forever()
     except KeyboardInterrupt:
         print("User stopped the connection!")
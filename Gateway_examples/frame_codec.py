@@ -0,0 +1,161 @@
+"""
+This script is the gateway side of the image transfer protocol (Arduino_examples/*/frame_codec.cpp). Every image chunk sent by the Arduino board starts with a header
+[FRAME_DATA, frame id, chunk index (uint16 LE), total length (uint16 LE), CRC-16 (uint16 LE)] followed by the payload, and the gateway acknowledges the chunks with
+[FRAME_ACK, frame id, next expected chunk (uint16 LE), ATT MTU (uint16 LE)]. When chunks are missing, the acknowledgement is a FRAME_NACK with an additional
+span and bitmap (uint32 LE) of the missing chunks, starting with the next expected chunk, so the board sends again only what was lost. The FrameReassembler collects the chunks of a frame (in any order, duplicates and
+chunks with a wrong CRC are dropped) and returns the image once all bytes of the announced total length arrived.
+The result of the remote inference is written back as [FRAME_RESULT, frame id, score in per mille (uint16 LE), gateway latency ms (uint16 LE), flags, bounding box
+x0, y0, x1, y1 (0 - 255)], the board ignores results whose frame id is not the one of the frame it just sent. In the progressive mode the gateway can answer a preview with
+[FRAME_REFINE, frame id] instead, and the board sends a larger image of the same capture.
+"""
+import struct
+
+FRAME_DATA = 0xD0
+FRAME_ACK = 0xAC
+FRAME_NACK = 0xAE
+FRAME_NACK_SPAN = 32
+FRAME_HEADER_LENGTH = 8
+FRAME_RESULT = 0xE5
+FRAME_RESULT_LENGTH = 11
+FRAME_RESULT_BOX = 0x01
+FRAME_REFINE = 0xE6
+FRAME_REFINE_LENGTH = 2
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT-FALSE, the same as frame_crc16 on the Arduino board."""
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def is_chunk(data):
+    return len(data) > FRAME_HEADER_LENGTH and data[0] == FRAME_DATA
+
+
+def decode_chunk(data):
+    """Returns (frame_id, index, total_length, payload), or None if the message is not a valid chunk."""
+    if not is_chunk(data):
+        return None
+    data = bytes(data)
+    _, frame_id, index, total_length, crc = struct.unpack("<BBHHH", data[0:FRAME_HEADER_LENGTH])
+    payload = data[FRAME_HEADER_LENGTH:]
+    if crc16(payload, crc16(data[0:6])) != crc:
+        return None
+    return frame_id, index, total_length, payload
+
+
+def encode_chunk(frame_id, index, total_length, payload):
+    header = struct.pack("<BBHH", FRAME_DATA, frame_id, index, total_length)
+    return header + struct.pack("<H", crc16(payload, crc16(header))) + bytes(payload)
+
+
+def encode_ack(frame_id, next_chunk, mtu):
+    return struct.pack("<BBHH", FRAME_ACK, frame_id, next_chunk, mtu)
+
+
+def encode_nack(frame_id, next_chunk, mtu, span, missing):
+    return struct.pack("<BBHHBI", FRAME_NACK, frame_id, next_chunk, mtu, span, missing)
+
+
+def encode_result(frame_id, score, latency_ms, box=None):
+    """score is the person probability (0 - 1), box the optional (x0, y0, x1, y1) as fractions of the image size."""
+    score = min(max(int(round(score * 1000)), 0), 1000)
+    latency_ms = min(max(int(latency_ms), 0), 0xFFFF)
+    flags = 0
+    coordinates = (0, 0, 0, 0)
+    if box is not None:
+        flags |= FRAME_RESULT_BOX
+        coordinates = tuple(min(max(int(round(value * 255)), 0), 255) for value in box)
+    return struct.pack("<BBHHB4B", FRAME_RESULT, frame_id, score, latency_ms, flags, *coordinates)
+
+
+def decode_result(data):
+    """Returns (frame_id, score 0 - 1, latency_ms, box or None), or None if the message is not a result."""
+    if len(data) != FRAME_RESULT_LENGTH or data[0] != FRAME_RESULT:
+        return None
+    _, frame_id, score, latency_ms, flags, x0, y0, x1, y1 = struct.unpack("<BBHHB4B", bytes(data))
+    box = (x0 / 255, y0 / 255, x1 / 255, y1 / 255) if flags & FRAME_RESULT_BOX else None
+    return frame_id, min(score, 1000) / 1000, latency_ms, box
+
+
+def encode_refine(frame_id):
+    return struct.pack("<BB", FRAME_REFINE, frame_id)
+
+
+def decode_refine(data):
+    """Returns the frame id of the preview to refine, or None if the message is not a refinement request."""
+    if len(data) != FRAME_REFINE_LENGTH or data[0] != FRAME_REFINE:
+        return None
+    return data[1]
+
+
+class FrameReassembler:
+    def __init__(self):
+        self.frame_id = None
+        self.completed_id = None
+        self.completed_chunks = 0
+        self.total_length = 0
+        self.chunks = {}
+        self.received = 0
+        self.crc_errors = 0
+        self.duplicates = 0
+        self.dropped_frames = 0
+
+    def next_expected(self):
+        """Number of chunks received without a gap, sent back as the cumulative acknowledgement."""
+        index = 0
+        while index in self.chunks:
+            index += 1
+        return index
+
+    def ack(self, mtu):
+        """Acknowledgement for the frame in progress, or for the last delivered frame (also re-sent when its retransmissions arrive)."""
+        if self.chunks:
+            next_chunk = self.next_expected()
+            highest = max(self.chunks)
+            if highest > next_chunk:
+                #Gap in the received chunks, report the missing ones
+                span = min(highest - next_chunk + 1, FRAME_NACK_SPAN)
+                missing = sum(1 << i for i in range(span) if next_chunk + i not in self.chunks)
+                return encode_nack(self.frame_id, next_chunk, mtu, span, missing)
+            return encode_ack(self.frame_id, next_chunk, mtu)
+        return encode_ack(self.completed_id or 0, self.completed_chunks, mtu)
+
+    def add(self, data):
+        """Adds a received notification, returns the complete image (bytes) when the last missing chunk arrived, otherwise None."""
+        chunk = decode_chunk(data)
+        if chunk is None:
+            self.crc_errors += 1
+            return None
+        frame_id, index, total_length, payload = chunk
+
+        if frame_id == self.completed_id:
+            #Retransmission of a frame that was already delivered
+            self.duplicates += 1
+            return None
+        if frame_id != self.frame_id or total_length != self.total_length:
+            if self.chunks:
+                self.dropped_frames += 1
+            self.frame_id = frame_id
+            self.total_length = total_length
+            self.chunks = {}
+            self.received = 0
+        if index in self.chunks:
+            self.duplicates += 1
+            return None
+
+        self.chunks[index] = payload
+        self.received += len(payload)
+        if self.received < self.total_length or self.next_expected() != len(self.chunks):
+            return None
+
+        image = b"".join(self.chunks[i] for i in range(len(self.chunks)))
+        self.completed_id = frame_id
+        self.completed_chunks = len(self.chunks)
+        self.chunks = {}
+        self.received = 0
+        return image[0:self.total_length]
@@ -17,6 +17,11 @@ import tensorflow as tf
 import numpy as np
 from tensorflow.keras.models import load_model
 import time
+import struct
+import sys
+import frame_codec
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Host_tools"))
+import split_model
 
 #BLE configuration
 #Must be the same as service uuid used with the Arduino board
@@ -25,9 +30,23 @@ service_uuid = "SERVICE_UUID" #example -> service_uuid = "0000180f-0000-1000-800
 message_uuid = "MESSAGE_UUID" #example -> message_uuid = "2d2F88c4-f244-5a80-21f1-ee0224e80658"
 #Must be the same as RX CHAR UUID used with the Arduino board
 write_characteristic = "WRITE_CHAR" #example -> write_characteristic = "00002A3D-0000-1000-8000-00805f9b34fb"
+#Must be the same as TELEMETRY CHAR UUID used with the Arduino board (natural_light and remote_inference examples)
+telemetry_characteristic = "TELEMETRY_CHAR" #example -> telemetry_characteristic = "6e7b2c31-4f0a-4d8e-9a51-3c2d7f1e0b44"
 #MAC address of the Arduino board 
 address = "MAC_ADDRESS" #example -> address = "8D:3E:BD:BE:13:3E"
 data_buffer_size = 4096
+#Image transfer mode, must match TRANSFER_MODE on the Arduino board: "windowed" (notifications + acknowledgements) or "indicate" (original)
+transfer_mode = "windowed"
+#Acknowledge every ack_every chunks, must not be larger than TRANSFER_WINDOW on the Arduino board
+ack_every = 2
+#Split computing: operators of the person detection model run on the Arduino board before the activation is sent (0 sends the image),
+#the gateway finishes the network with the reference model in Host_tools/split_model.py
+split_layer = 0
+person_model = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Arduino_examples", "natural_light", "person_detect_model_data.cpp")
+#Progressive offload (natural_light): images narrower than preview_width are previews, a preview whose score falls into refine_band is not
+#decided on and the larger image of the same capture is requested instead (see Host_tools/progressive_sim.py to choose the band)
+preview_width = 96
+refine_band = (0.3, 0.7)
 output_file = "captured_data.txt"
 
 class ArduinoConnection:
@@ -70,6 +89,8 @@ class ArduinoConnection:
         self.m = 0
         self.n = 219 
         self.results_counter = 0
+        self.reassembler = frame_codec.FrameReassembler()
+        self.frame_time = time.perf_counter()
 
         filename = 'facetracker.h5'
         with h5py.File(filename, 'r') as f:
@@ -77,6 +98,7 @@ class ArduinoConnection:
             data = list(f[a_group_key])
         
         self.facetracker = load_model('facetracker.h5')
+        self.split_model = split_model.ReferenceModel(person_model) if split_layer else None
 
     #This function is called every time the BleakClient loses the connection with the remote device!
     def on_disconnect(self, client: BleakClient):
@@ -84,103 +106,10 @@ class ArduinoConnection:
         self.onConnection = False
     
     async def notification_handler(self, sender: str, data: Any):
-    
-        if (len(data) == 220):
-            self.dataByte = data
-            self.dataMap[self.m:self.n] = self.dataByte
-            self.counter=self.counter+1
-            self.bytecounter=self.bytecounter+1
-            self.m = self.m+220
-            self.n = self.n+220
-
-            if(self.counter==14 and len(self.dataMap) == 3080):
-                
-                st = time.process_time()
-                picture_stream = io.BytesIO(self.dataMap)
-                data_to_send = Image.open(picture_stream)
-                data_to_send = data_to_send.resize((320, 240))
-                timestr = time.strftime("%Y-%m-%d_%H-%M-%S")
-
-                img_name = "{date}-result.jpg".format(date=timestr)
-                data_to_send.save(img_name)
-
-                cap = cv2.imread(data_to_send)
-                rgb = cv2.cvtColor(cap, cv2.COLOR_BGR2RGB)
-                resized = tf.image.resize(rgb, (120,120))
-                yhat = self.facetracker.predict(np.expand_dims(resized/255,0))
-                sample_coords = yhat[1][0] 
-                if yhat[0] > 0.5: 
-                    cv2.rectangle(cap, 
-                                tuple(np.multiply(sample_coords[:2], [cap.shape[1],cap.shape[0]]).astype(int)),
-                                tuple(np.multiply(sample_coords[2:], [cap.shape[1],cap.shape[0]]).astype(int)), 
-                                        (255,0,0), 2)
-                    cv2.rectangle(cap, 
-                                tuple(np.add(np.multiply(sample_coords[:2], [cap.shape[1],cap.shape[0]]).astype(int), 
-                                        [0,-30])),
-                                tuple(np.add(np.multiply(sample_coords[:2], [cap.shape[1],cap.shape[0]]).astype(int),
-                                        [80,0])), 
-                                    (255,0,0), -1)
-                    cv2.putText(cap, 'face', tuple(np.add(np.multiply(sample_coords[:2], [cap.shape[1],cap.shape[0]]).astype(int),
-                                        [0,-5])),
-                                    cv2.FONT_HERSHEY_SIMPLEX, 1, (255,255,255), 2, cv2.LINE_AA)
-                
-                remote_inference = int(yhat[0]*1000)
-                res = str(remote_inference)
-                result = res.encode()
-                await self.client.write_gatt_char(self.write_characteristic, result)
-                self.results_counter = self.results_counter+1
-                currtime = time.strftime("%Y-%m-%d_%H-%M-%S")
-                current_time = "{date}".format(date=currtime)
-                # print("Remote inference time is: ")
-                # print(current_time)
-
-        elif(len(data) == 1 and data.decode("utf-8") == "7"):
-            
-            if(len(self.dataMap)) < 2050:
-               pass
 
-            else:
-                self.dataMap = self.dataMap[0:2056]
-
-                st = time.process_time()
-                picture_stream = io.BytesIO(self.dataMap)
-                data_to_send = Image.open(picture_stream)
-                data_to_send = data_to_send.resize((320, 240))
-                timestring = time.strftime("%Y-%m-%d_%H-%M-%S")
-
-                image_name = "{date}-result.jpg".format(date=timestring)
-                data_to_send.save(image_name)
-
-                cap = cv2.imread(data_to_send)
-                rgb = cv2.cvtColor(cap, cv2.COLOR_BGR2RGB)
-                resized = tf.image.resize(rgb, (120,120))
-                yhat = self.facetracker.predict(np.expand_dims(resized/255,0))
-                sample_coords = yhat[1][0] 
-                if yhat[0] > 0.5: 
-                    cv2.rectangle(cap, 
-                            tuple(np.multiply(sample_coords[:2], [cap.shape[1],cap.shape[0]]).astype(int)),
-                            tuple(np.multiply(sample_coords[2:], [cap.shape[1],cap.shape[0]]).astype(int)), 
-                                    (255,0,0), 2)
-                    cv2.rectangle(cap, 
-                            tuple(np.add(np.multiply(sample_coords[:2], [cap.shape[1],cap.shape[0]]).astype(int), 
-                                    [0,-30])),
-                            tuple(np.add(np.multiply(sample_coords[:2], [cap.shape[1],cap.shape[0]]).astype(int),
-                                    [80,0])), 
-                                    (255,0,0), -1)
-                    cv2.putText(cap, 'face', tuple(np.add(np.multiply(sample_coords[:2], [cap.shape[1],cap.shape[0]]).astype(int),
-                                    [0,-5])),
-                                cv2.FONT_HERSHEY_SIMPLEX, 1, (255,255,255), 2, cv2.LINE_AA)
-                
-                remote_inference = int(yhat[0]*1000)
-                res = str(remote_inference)
-                result = res.encode()
-                await self.client.write_gatt_char(self.write_characteristic, result)
-                self.results_counter = self.results_counter+1
-                currtime2 = time.strftime("%Y-%m-%d_%H-%M-%S")
-                current_time = "{date}".format(date=currtime2)
-                # print("Remote inference time is: ")
-                # print(current_time)
-        
+        if frame_codec.is_chunk(data):
+            await self.frame_notification(data)
+    
         elif(len(data) == 1):
             self.dataLocal = data.decode("utf-8")
             if self.dataLocal == "1":
@@ -192,6 +121,84 @@ class ArduinoConnection:
         else:
             print("No data available at the moment!")
 
+    #Runs the heavy-weight model on a received JPEG image and sends the result back to the Arduino board
+    async def remote_inference(self, image_bytes):
+        st = time.process_time()
+        picture_stream = io.BytesIO(image_bytes)
+        data_to_send = Image.open(picture_stream)
+        preview = data_to_send.size[0] < preview_width
+        data_to_send = data_to_send.resize((320, 240))
+        timestr = time.strftime("%Y-%m-%d_%H-%M-%S")
+
+        img_name = "{date}-result.jpg".format(date=timestr)
+        data_to_send.save(img_name)
+
+        cap = cv2.imread(img_name)
+        rgb = cv2.cvtColor(cap, cv2.COLOR_BGR2RGB)
+        resized = tf.image.resize(rgb, (120,120))
+        yhat = self.facetracker.predict(np.expand_dims(resized/255,0))
+        sample_coords = yhat[1][0] 
+        if preview and refine_band[0] < yhat[0][0] < refine_band[1]:
+            print("Preview of {} B is not conclusive ({:.2f}), requesting the full image".format(len(image_bytes), float(yhat[0][0])))
+            await self.client.write_gatt_char(self.write_characteristic, frame_codec.encode_refine(self.reassembler.completed_id))
+            return
+        if yhat[0] > 0.5: 
+            cv2.rectangle(cap, 
+                        tuple(np.multiply(sample_coords[:2], [cap.shape[1],cap.shape[0]]).astype(int)),
+                        tuple(np.multiply(sample_coords[2:], [cap.shape[1],cap.shape[0]]).astype(int)), 
+                                (255,0,0), 2)
+            cv2.rectangle(cap, 
+                        tuple(np.add(np.multiply(sample_coords[:2], [cap.shape[1],cap.shape[0]]).astype(int), 
+                                [0,-30])),
+                        tuple(np.add(np.multiply(sample_coords[:2], [cap.shape[1],cap.shape[0]]).astype(int),
+                                [80,0])), 
+                            (255,0,0), -1)
+            cv2.putText(cap, 'face', tuple(np.add(np.multiply(sample_coords[:2], [cap.shape[1],cap.shape[0]]).astype(int),
+                                [0,-5])),
+                            cv2.FONT_HERSHEY_SIMPLEX, 1, (255,255,255), 2, cv2.LINE_AA)
+        
+        box = tuple(float(value) for value in sample_coords) if yhat[0] > 0.5 else None
+        result = frame_codec.encode_result(self.reassembler.completed_id, float(yhat[0][0]), self.result_latency_ms(), box)
+        await self.client.write_gatt_char(self.write_characteristic, result)
+        self.results_counter = self.results_counter+1
+        currtime = time.strftime("%Y-%m-%d_%H-%M-%S")
+        current_time = "{date}".format(date=currtime)
+        # print("Remote inference time is: ")
+        # print(current_time)
+
+    #Time since the last chunk of the frame arrived, sent back with the result
+    def result_latency_ms(self):
+        return (time.perf_counter() - self.frame_time) * 1000
+
+    #Writes the transfer acknowledgement (frame id, next expected chunk, negotiated ATT MTU and missing chunks) into the RX characteristic (see frame_codec.h)
+    async def send_ack(self):
+        mtu = getattr(self.client, "mtu_size", 23)
+        await self.client.write_gatt_char(self.write_characteristic, self.reassembler.ack(mtu))
+
+    #Image chunks are reassembled by frame id and chunk index, the image is complete once all bytes of the announced total length arrived
+    async def frame_notification(self, data):
+        image_bytes = self.reassembler.add(data)
+        self.counter = self.counter + 1
+        if transfer_mode == "windowed" and (image_bytes is not None or self.counter % ack_every == 0):
+            await self.send_ack()
+        if image_bytes is not None:
+            self.counter = 0
+            self.frame_time = time.perf_counter()
+            if split_model.is_split(image_bytes):
+                await self.split_inference(image_bytes)
+            else:
+                await self.remote_inference(image_bytes)
+
+    #Finishes the person detection model on the intermediate activation sent in the split computing mode and sends the result back
+    async def split_inference(self, payload):
+        if self.split_model is None:
+            self.split_model = split_model.ReferenceModel(person_model)
+        probability = self.split_model.finish(payload)
+        print("Split inference from layer {} ({} B): person {:.2f}".format(payload[1], len(payload), probability))
+        result = frame_codec.encode_result(self.reassembler.completed_id, probability, self.result_latency_ms())
+        await self.client.write_gatt_char(self.write_characteristic, result)
+        self.results_counter = self.results_counter + 1
+
     async def manager(self):
         while True:
             if self.client and self.onConnection==True:
@@ -217,9 +224,19 @@ class ArduinoConnection:
                     self.connected = await self.client.is_connected()
                     if self.connected:
                         self.client.set_disconnected_callback(self.on_disconnect)
+                        await self.read_telemetry()
                         await self.client.start_notify(
                             self.char_object, self.notification_handler,
                         )
+                        #A frame interrupted by a lost connection is kept, so the board can resume it from the next expected chunk
+                        if not self.reassembler.chunks:
+                            self.reassembler = frame_codec.FrameReassembler()
+                        #Selects the split point (natural_light example only), used from the next frame the board prepares
+                        if split_layer:
+                            await self.client.write_gatt_char(self.write_characteristic, bytes([split_model.SPLIT_MESSAGE, split_layer]))
+                        if transfer_mode == "windowed":
+                            #Tells the board that the gateway is subscribed and which MTU was negotiated
+                            await self.send_ack()
                         self.counter=0
                         self.bytecounter=0
                         self.m = 0
@@ -238,6 +255,64 @@ class ArduinoConnection:
         else:
             await self.manager()
     
+    #Reads the offload latency estimate the device uses in its deadline check (see telemetry.h)
+    async def read_telemetry(self):
+        try:
+            raw = await self.client.read_gatt_char(telemetry_characteristic)
+        except Exception:
+            return
+        if len(raw) >= 14:
+            samples, last, p50, estimate = struct.unpack("<HIII", bytes(raw[0:14]))
+            print("Offload latency: samples={} last={} ms p50={} ms estimate={} ms".format(samples, last, p50, estimate))
+        if len(raw) >= 30:
+            #Per-task trace indexed by TaskName (F_camera, F_image, F_local, F_led, F_led2, F_decode, ...)
+            task_ms = struct.unpack("<8H", bytes(raw[14:30]))
+            print("Last task durations [ms]: {}".format(list(task_ms)))
+        if len(raw) >= 42:
+            boot_ms, arena_used, ram_reserved = struct.unpack("<III", bytes(raw[30:42]))
+            print("Boot time: {} ms, tensor arena used: {} B, static buffers: {} B".format(boot_ms, arena_used, ram_reserved))
+        if len(raw) >= 54:
+            transfer_ms, transfer_bytes, chunks, retransmitted, chunk_size = struct.unpack("<IHHHH", bytes(raw[42:54]))
+            throughput = transfer_bytes * 1000 / transfer_ms if transfer_ms else 0
+            goodput = transfer_bytes / (chunks * chunk_size) if chunks and chunk_size else 0
+            print("Last transfer: {} B in {} ms ({:.0f} B/s), {} chunks of {} B, {} retransmitted, goodput {:.0%}".format(
+                transfer_bytes, transfer_ms, throughput, chunks, chunk_size, retransmitted, goodput))
+        if len(raw) >= 58:
+            connect_first_byte, = struct.unpack("<I", bytes(raw[54:58]))
+            print("Connection to first byte: {} ms".format(connect_first_byte))
+        if len(raw) >= 64:
+            paused_ms, resumes = struct.unpack("<IH", bytes(raw[58:64]))
+            print("Last transfer paused for {} ms, resumed {} times".format(paused_ms, resumes))
+        if len(raw) >= 68:
+            source_bytes, encode_ms = struct.unpack("<HH", bytes(raw[64:68]))
+            print("Camera JPEG: {} B, thumbnail encoding: {} ms".format(source_bytes, encode_ms))
+        if len(raw) >= 72:
+            layer, compute_ms = struct.unpack("<HH", bytes(raw[68:72]))
+            if layer:
+                print("Split computing: {} operators on the device in {} ms".format(layer, compute_ms))
+        if len(raw) >= 76:
+            gateway_ms, stale = struct.unpack("<HH", bytes(raw[72:76]))
+            print("Last result: {} ms on the gateway, {} stale results ignored".format(gateway_ms, stale))
+        if len(raw) >= 80:
+            hits, misses = struct.unpack("<HH", bytes(raw[76:80]))
+            checked = hits + misses
+            print("Result cache: {} hits, {} misses ({:.0%} of the frames not offloaded)".format(hits, misses, hits / checked if checked else 0))
+        if len(raw) >= 84:
+            preview_bytes, refinements = struct.unpack("<HH", bytes(raw[80:84]))
+            print("Last preview: {} B, {} previews refined".format(preview_bytes, refinements))
+        if len(raw) >= 88:
+            windows, search_ms = struct.unpack("<HH", bytes(raw[84:88]))
+            print("Last local search: {} windows in {} ms".format(windows, search_ms))
+        if len(raw) >= 92:
+            prefilter_ms, rejects = struct.unpack("<HH", bytes(raw[88:92]))
+            print("Cascade pre-filter: {} ms, {} frames rejected".format(prefilter_ms, rejects))
+        if len(raw) >= 96:
+            model_index, switches = struct.unpack("<HH", bytes(raw[92:96]))
+            print("Local model: {}, switched {} times".format("store entry {}".format(model_index - 1) if model_index else "compiled-in", switches))
+        if len(raw) >= 100:
+            changes, flicker = struct.unpack("<HH", bytes(raw[96:100]))
+            print("Person decision changed {} times, per-frame decision {} times".format(changes, flicker))
+
     async def cleanup(self):
         if self.client:
 
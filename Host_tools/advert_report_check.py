@@ -0,0 +1,172 @@
+"""
+This script tests the result advertisements of local_inference_send: the codec of the sketch (advert_report.cpp, compiled on the host) against the decoder of
+the gateway (decode_result_report and AdvertisementReceiver in Gateway_examples/computer.py).
+
+Random reports are encoded and decoded by the sketch, decoded by the gateway and packed the way the gateway unpacks them, and reports of another version or
+too short have to be rejected by both sides. The receiver is then fed bursts of advertisements (every report repeated ADVERT_BURST_MS / advertising interval
+times, mixed with advertisements of other devices and company identifiers, with the sequence number wrapping around) and has to print every report once.
+Requires g++ and Pillow (imported by computer.py, bleak is replaced by a stand-in).
+
+Examples:
+    python advert_report_check.py
+    python advert_report_check.py --reports 5000
+"""
+import argparse
+import contextlib
+import ctypes
+import io
+import os
+import random
+import struct
+import sys
+import tempfile
+import types
+
+from sketch_build import sketch_library
+
+SKETCH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Arduino_examples", "local_inference_send")
+GATEWAY = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Gateway_examples")
+#Must be the same as in advert_report.h
+ADVERT_REPORT_VERSION = 1
+ADVERT_REPORT_LENGTH = 10
+ADVERT_FLAG_PREVIOUS_CONNECTED = 0x01
+ADVERT_BURST_MS = 600
+ADVERT_INTERVAL_MS = 100
+
+WRAPPER = """
+#include "advert_report.h"
+//fields: result, confidence, sequence, voltage, radio-on time, flags
+extern "C" int check_encode(uint8_t* out, const long* fields)
+{
+    struct ResultReport report = {(uint8_t)fields[0], (uint8_t)fields[1], (uint16_t)fields[2], (uint16_t)fields[3], (uint16_t)fields[4],
+                                  (uint8_t)fields[5]};
+    return advert_encode(out, &report);
+}
+extern "C" bool check_decode(const uint8_t* data, int length, long* fields)
+{
+    struct ResultReport report;
+    if(!advert_decode(data, length, &report))
+    {
+        return false;
+    }
+    long values[] = {report.result, report.confidence, report.sequence, report.voltage_mv, report.radio_on_ms, report.flags};
+    for(int i = 0; i < 6; i++) fields[i] = values[i];
+    return true;
+}
+"""
+
+
+def load_computer():
+    """Imports Gateway_examples/computer.py with a stand-in for bleak, which is only needed to talk to a real board."""
+    if "bleak" not in sys.modules:
+        bleak = types.ModuleType("bleak")
+        bleak.BleakClient = bleak.BleakScanner = object
+        sys.modules["bleak"] = bleak
+    sys.path.insert(0, GATEWAY)
+    import computer
+    return computer
+
+
+def build_library(build_dir):
+    """Compiles advert_report.cpp of the sketch into a shared library and returns it loaded with ctypes."""
+    library = sketch_library(build_dir, SKETCH, ["advert_report.cpp"], WRAPPER)
+    library.check_decode.restype = ctypes.c_bool
+    return library
+
+
+class Codec:
+    def __init__(self, library):
+        self.library = library
+        self.out = ctypes.create_string_buffer(32)
+        self.fields = (ctypes.c_long * 6)()
+
+    def encode(self, fields):
+        length = self.library.check_encode(self.out, (ctypes.c_long * 6)(*fields))
+        return self.out.raw[:length]
+
+    def decode(self, data):
+        return tuple(self.fields) if self.library.check_decode(data, len(data), self.fields) else None
+
+
+def random_report(rng):
+    return (rng.randrange(2), rng.randrange(101), rng.randrange(65536), rng.randrange(2500, 5500), rng.randrange(65536),
+            rng.choice([0, ADVERT_FLAG_PREVIOUS_CONNECTED]))
+
+
+def check_codec(codec, computer, rng, count):
+    failures = {}
+
+    def expect(name, condition):
+        failures.setdefault(name, 0)
+        failures[name] += not condition
+
+    for _ in range(count):
+        report = random_report(rng)
+        data = codec.encode(report)
+        expect("length ADVERT_REPORT_LENGTH", len(data) == ADVERT_REPORT_LENGTH)
+        expect("sketch round trip", codec.decode(data) == report)
+        decoded = computer.decode_result_report(data)
+        expect("decoded by the gateway", decoded == {"result": report[0], "confidence": report[1], "sequence": report[2], "voltage_mv": report[3],
+                                                     "radio_on_ms": report[4], "previous_connected": bool(report[5] & ADVERT_FLAG_PREVIOUS_CONNECTED)})
+        expect("same bytes as the gateway layout", data == struct.pack("<BBBHHHB", ADVERT_REPORT_VERSION, *report))
+        wrong_version = bytes([rng.choice([0, 2, 0xFF])]) + data[1:]
+        expect("other version rejected", codec.decode(wrong_version) is None and computer.decode_result_report(wrong_version) is None)
+        short = data[:rng.randrange(ADVERT_REPORT_LENGTH)]
+        expect("short report rejected", codec.decode(short) is None and computer.decode_result_report(short) is None)
+    for name, failed in failures.items():
+        print("  {:<36} {:>5} cases  {}".format(name, count, "ok" if not failed else "FAIL ({})".format(failed)))
+    return not any(failures.values())
+
+
+def check_receiver(codec, computer, rng, bursts):
+    """Bursts of repeated advertisements, returns True if every report was printed once."""
+    computer.address = "8D:3E:BD:BE:13:3E"
+    receiver = computer.AdvertisementReceiver()
+    repeats = ADVERT_BURST_MS // ADVERT_INTERVAL_MS
+    sequence = 65536 - bursts // 2
+    expected = []
+    output = io.StringIO()
+    with contextlib.redirect_stdout(output):
+        for _ in range(bursts):
+            sequence &= 0xFFFF
+            report = (rng.randrange(2), rng.randrange(101), sequence, 4200, rng.randrange(2000), 0)
+            expected.append(sequence)
+            data = codec.encode(report)
+            for _ in range(repeats):
+                #Advertisements of other devices and of other company identifiers are ignored
+                other = codec.encode(random_report(rng))
+                receiver.detection_callback(types.SimpleNamespace(address="11:22:33:44:55:66"),
+                                            types.SimpleNamespace(manufacturer_data={computer.advert_company_id: other}))
+                receiver.detection_callback(types.SimpleNamespace(address=computer.address),
+                                            types.SimpleNamespace(manufacturer_data={0x004C: other}))
+                receiver.detection_callback(types.SimpleNamespace(address=computer.address),
+                                            types.SimpleNamespace(manufacturer_data={computer.advert_company_id: data}))
+            sequence += 1
+    printed = [int(line.split()[1].rstrip(":")) for line in output.getvalue().splitlines() if line.startswith("Report ")]
+    ok = printed == expected
+    print("  {} bursts of {} advertisements, sequence wrapping at 65535: {} reports printed  {}".format(
+        bursts, repeats, len(printed), "ok" if ok else "FAIL, expected {}".format(len(expected))))
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--reports", type=int, default=1000)
+    parser.add_argument("--bursts", type=int, default=20)
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    computer = load_computer()
+    with tempfile.TemporaryDirectory() as build_dir:
+        codec = Codec(build_library(build_dir))
+        print("Codec (advert_report.cpp and computer.py)")
+        ok = check_codec(codec, computer, rng, args.reports)
+        print("Gateway receiver")
+        ok &= check_receiver(codec, computer, rng, args.bursts)
+    print("All checks passed" if ok else "Some checks FAILED")
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
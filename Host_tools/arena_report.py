@@ -0,0 +1,124 @@
+"""
+This script reports how the tensor arena is used by a TensorFlow Lite Micro model (by default the person detection model compiled into the Arduino sketches).
+For every tensor that has to live in the arena it prints the size and lifetime (first and last operator that touches it), then it plans the activation memory the
+same way as the greedy memory planner of TFLM (largest buffers first, lowest offset that does not overlap a buffer alive at the same time) and adds an estimate of
+the persistent allocations (eval tensors, nodes and per-channel quantization data).
+
+The result is compared with the kTensorArenaSize of the sketch to show the headroom. The value measured on the board (interpreter->arena_used_bytes(), reported
+after AllocateTensors()) is always more accurate than the host estimate, and can be passed with --measured. Using --write-header, the arena size (measured or
+estimated value plus a safety margin) is written to arena_settings.h of the given sketch, so the freed RAM can be used for frame buffers.
+
+Examples:
+    python arena_report.py
+    python arena_report.py --measured 81520 --margin 10 --write-header ../Arduino_examples/natural_light/arena_settings.h
+"""
+import argparse
+import os
+
+from tflite_model import ModelInfo, load_model_bytes
+
+DEFAULT_MODEL = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Arduino_examples", "natural_light", "person_detect_model_data.cpp")
+CURRENT_ARENA_SIZE = 136 * 1024
+ALIGNMENT = 16
+
+#Rough sizes of the persistent TFLM structures on a 32-bit target
+EVAL_TENSOR_BYTES = 12
+NODE_BYTES = 48
+IO_TENSOR_BYTES = 64
+PER_CHANNEL_OP_BYTES = 8
+OP_DATA_BYTES = 48
+
+
+def align(value):
+    return (value + ALIGNMENT - 1) // ALIGNMENT * ALIGNMENT
+
+
+def plan_activations(model):
+    """Greedy first-fit-decreasing placement of the non-persistent tensors, returns ({tensor: offset}, planned_bytes)."""
+    spans = model.lifetimes()
+    order = sorted(spans.keys(), key=lambda index: (-model.tensors[index].bytes, spans[index][0]))
+    placed = []
+    offsets = {}
+    high_water = 0
+    for index in order:
+        size = align(model.tensors[index].bytes)
+        first, last = spans[index]
+        alive = sorted((offset, align(model.tensors[other].bytes)) for other, offset in placed
+                       if not (spans[other][1] < first or last < spans[other][0]))
+        candidate = 0
+        for offset, other_size in alive:
+            if candidate + size <= offset:
+                break
+            candidate = max(candidate, offset + other_size)
+        offsets[index] = candidate
+        placed.append((index, candidate))
+        high_water = max(high_water, candidate + size)
+    return offsets, high_water
+
+
+def estimate_persistent(model):
+    total = len(model.tensors) * EVAL_TENSOR_BYTES
+    total += len(model.operators) * (NODE_BYTES + OP_DATA_BYTES)
+    total += (len(model.inputs) + len(model.outputs)) * IO_TENSOR_BYTES
+    for op in model.operators:
+        if op.name in ("CONV_2D", "DEPTHWISE_CONV_2D") and op.outputs:
+            channels = model.tensors[op.outputs[0]].shape[-1]
+            total += channels * PER_CHANNEL_OP_BYTES
+    return align(total)
+
+
+def write_header(path, arena_bytes, measured, margin):
+    with open(path, "w") as f:
+        f.write("#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_ARENA_SETTINGS_H_\n")
+        f.write("#define TENSORFLOW_LITE_MICRO_EXAMPLES_PERSON_DETECTION_ARENA_SETTINGS_H_\n\n")
+        f.write("//Generated by Host_tools/arena_report.py from the {} arena usage plus a {}% safety margin\n".format(
+            "measured" if measured else "estimated", margin))
+        f.write("//TENSOR_ARENA_USED_BYTES is the measurement (0 if estimated), report_arena_usage() warns when the usage grows beyond it\n")
+        f.write("#define TENSOR_ARENA_USED_BYTES {}\n".format(measured if measured else 0))
+        f.write("#define TENSOR_ARENA_SIZE {}\n\n".format(arena_bytes))
+        f.write("#endif\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Tensor arena usage report and sizing for the person detection model")
+    parser.add_argument("model", nargs="?", default=DEFAULT_MODEL, help=".tflite file or C array source (default: person_detect_model_data.cpp)")
+    parser.add_argument("--arena", type=int, default=CURRENT_ARENA_SIZE, help="current kTensorArenaSize in bytes")
+    parser.add_argument("--measured", type=int, default=0, help="arena_used_bytes() reported by the board")
+    parser.add_argument("--margin", type=int, default=10, help="safety margin in percent")
+    parser.add_argument("--write-header", help="path of the arena_settings.h to generate")
+    parser.add_argument("--quiet", action="store_true", help="do not print the per-tensor table")
+    args = parser.parse_args()
+
+    model = ModelInfo(load_model_bytes(args.model))
+    spans = model.lifetimes()
+    offsets, planned = plan_activations(model)
+    persistent = estimate_persistent(model)
+
+    if not args.quiet:
+        print("{:>4}  {:<48} {:>8} {:>7} {:>9} {:>8}".format("idx", "tensor", "type", "bytes", "lifetime", "offset"))
+        for index in sorted(spans.keys(), key=lambda i: (spans[i][0], i)):
+            tensor = model.tensors[index]
+            print("{:>4}  {:<48} {:>8} {:>7} {:>4}-{:<4} {:>8}".format(index, tensor.name[:48], tensor.type_name, tensor.bytes,
+                                                                   spans[index][0], spans[index][1], offsets[index]))
+        print("")
+
+    estimate = planned + persistent
+    used = args.measured if args.measured else estimate
+    sized = align(used * (100 + args.margin) // 100)
+
+    print("Operators: {} ({})".format(len(model.operators), ", ".join(model.op_names)))
+    print("Planned activations (high-water mark): {} B".format(planned))
+    print("Persistent allocations (estimate): {} B".format(persistent))
+    print("Arena estimate: {} B (kernel scratch buffers not included, prefer --measured)".format(estimate))
+    if args.measured:
+        print("Arena measured on the board: {} B".format(args.measured))
+    print("Configured arena: {} B, headroom: {} B".format(args.arena, args.arena - used))
+    print("Suggested arena with {}% margin: {} B (frees {} B)".format(args.margin, sized, args.arena - sized))
+
+    if args.write_header:
+        write_header(args.write_header, sized, args.measured, args.margin)
+        print("Written {}".format(args.write_header))
+
+
+if __name__ == "__main__":
+    main()
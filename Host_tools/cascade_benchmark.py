@@ -0,0 +1,161 @@
+"""
+This script chooses the threshold of the two-stage cascade of the natural_light sketch (see prefilter.cpp). The pre-filter and the full person detection model
+are run with the reference int8 kernels (split_model.py) on a set of camera frames, the pre-filter on the frame resampled and requantized to its input exactly
+as on the device. For every threshold it reports the share of frames on which the full model still runs, the recall and false positive rate of the cascade
+(against the person / no_person subdirectories, or against the full model alone for unlabelled frames), and the expected local inference time and energy per
+frame.
+
+The times are estimated from the multiply-accumulate operations of both models, scaled to the measured duration of the full inference (execution_time of
+F_local in application.cpp); the pre-filter time measured on the board is reported in the telemetry (prefilter_ms). The energy is the time multiplied by
+--power-mw. The pre-filter may only use the operators the sketch registers (AVERAGE_POOL_2D, CONV_2D, DEPTHWISE_CONV_2D, RESHAPE, SOFTMAX).
+
+With --write-source the pre-filter is written as the C array compiled into the sketch (prefilter_model_data.cpp).
+Requires numpy and Pillow.
+
+Examples:
+    python cascade_benchmark.py frames --prefilter prefilter.tflite
+    python cascade_benchmark.py frames --prefilter prefilter.tflite --thresholds -100 -64 -32 0 --write-source ../Arduino_examples/natural_light/prefilter_model_data.cpp
+"""
+import argparse
+import os
+
+import numpy as np
+from PIL import Image
+
+from split_benchmark import load_frames
+from split_model import ReferenceModel
+from thumbnail_benchmark import crop_origin
+from tflite_model import load_model_bytes
+
+DEFAULT_MODEL = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Arduino_examples", "natural_light", "person_detect_model_data.cpp")
+#Frame the pre-filter sees on the device: the whole 160x120 frame with the multi-window search (SEARCH_ENABLED), otherwise the 96x96 centre crop at the
+#MCU-aligned offset of DecodeAndProcessImage (crop_origin, (32, 8))
+FRAME_SIZE = (160, 120)
+CROP = 96
+#PREFILTER_THRESHOLD in prefilter.h (int8 person output)
+THRESHOLD = -64
+FULL_INFERENCE_MS = 1148
+DECISION = 0.5
+
+SOURCE = """//Pre-filter model of the two-stage cascade, generated by Host_tools/cascade_benchmark.py from {name}
+
+#include "prefilter_model_data.h"
+
+//Keep model aligned to 8 bytes to guarantee aligned 64-bit accesses.
+alignas(8) const unsigned char g_prefilter_model_data[] = {{
+{data}
+}};
+const int g_prefilter_model_data_len = {length};
+"""
+
+
+def resize(frame, width, height, source_scale, source_zero_point, scale, zero_point):
+    """Area average resampling requantized to the pre-filter input, the same float32 arithmetic as prefilter_resize() on the device."""
+    if source_scale <= 0 or scale <= 0:
+        source_scale, scale, source_zero_point, zero_point = 1.0, 1.0, 0, 0
+    factor = np.float32(source_scale) / np.float32(scale)
+    source_height, source_width = frame.shape
+    out = np.zeros((height, width), np.int8)
+    for y in range(height):
+        y0, y1 = y * source_height // height, (y + 1) * source_height // height
+        for x in range(width):
+            x0, x1 = x * source_width // width, (x + 1) * source_width // width
+            total = int(frame[y0:y1, x0:x1].astype(np.int32).sum())
+            count = (y1 - y0) * (x1 - x0)
+            value = (np.float32(total) / np.float32(count) - np.float32(source_zero_point)) * factor
+            #lroundf rounds halfway cases away from zero
+            value = int(np.copysign(np.floor(abs(value) + np.float32(0.5)), value)) + zero_point
+            out[y, x] = min(max(value, -128), 127)
+    return out
+
+
+def device_frame(path, search):
+    image = Image.open(path).convert("L")
+    if image.size != FRAME_SIZE:
+        image = image.resize(FRAME_SIZE)
+    frame = np.asarray(image, np.int32) - 128
+    if not search:
+        left, top = crop_origin()
+        frame = frame[top:top + CROP, left:left + CROP]
+    return frame.astype(np.int8)
+
+
+def person_output(model, output):
+    """int8 person output as read by prefilter_run(): the second class of a two-class model, or the only output."""
+    values = output.reshape(-1)
+    return int(values[1 if len(values) > 1 else 0])
+
+
+def write_source(model_path, path):
+    data = load_model_bytes(model_path)
+    lines = []
+    for start in range(0, len(data), 13):
+        lines.append("    " + " ".join("0x{:02x},".format(byte) for byte in data[start:start + 13]))
+    with open(path, "w") as f:
+        f.write(SOURCE.format(name=os.path.basename(model_path), data="\n".join(lines), length=len(data)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("images", help="directory with camera frames (optionally in person / no_person subdirectories)")
+    parser.add_argument("--prefilter", required=True, help=".tflite file or C array source of the pre-filter")
+    parser.add_argument("--model", default=DEFAULT_MODEL, help=".tflite file or C array source of the full model")
+    parser.add_argument("--thresholds", type=int, nargs="+", default=[-128, -96, THRESHOLD, -32, 0, 32])
+    parser.add_argument("--centre-crop", action="store_true", help="the sketch runs without the multi-window search")
+    parser.add_argument("--full-ms", type=float, default=FULL_INFERENCE_MS)
+    parser.add_argument("--power-mw", type=float, help="power during the inference, to report the energy per frame")
+    parser.add_argument("--write-source", help="write the pre-filter as prefilter_model_data.cpp")
+    args = parser.parse_args()
+
+    frames = load_frames(args.images)
+    if not frames:
+        parser.error("no images in {}".format(args.images))
+    full = ReferenceModel(args.model)
+    prefilter = ReferenceModel(args.prefilter)
+    prefilter_input = prefilter.tensors[prefilter.info.inputs[0]]
+    _, height, width, _ = prefilter_input.shape
+    #The frame is decoded with the input quantization of the full model, the device requantizes it to the one of the pre-filter
+    full_input = full.tensors[full.info.inputs[0]]
+    quantization = (full_input.scale, full_input.zero_point, prefilter_input.scale, prefilter_input.zero_point)
+    prefilter_ms = args.full_ms * sum(prefilter.macs(op) for op in prefilter.operators) / sum(full.macs(op) for op in full.operators)
+
+    prefilter_scores, decisions = [], []
+    for path, _ in frames:
+        frame = device_frame(path, not args.centre_crop)
+        prefilter_scores.append(person_output(prefilter, prefilter.run(resize(frame, width, height, *quantization).reshape(1, height, width, 1))))
+        #The full model sees the centre crop (the first window of the search)
+        if frame.shape != (CROP, CROP):
+            left, top = crop_origin()
+            frame = frame[top:top + CROP, left:left + CROP]
+        decisions.append(full.person_probability(full.run(frame.reshape(1, CROP, CROP, 1))) > DECISION)
+
+    labels = [label for _, label in frames]
+    if all(label is None for label in labels):
+        #Without labels, the full model alone is the reference
+        labels = decisions
+    print("{} frames, pre-filter {}x{} input, {:.0f} ms per frame estimated (full model {:.0f} ms)".format(
+        len(frames), width, height, prefilter_ms, args.full_ms))
+    header = "{:>9} {:>10} {:>8} {:>8} {:>10}".format("threshold", "full runs", "recall", "false +", "ms/frame")
+    if args.power_mw is not None:
+        header += " {:>10}".format("mJ/frame")
+    print(header)
+    rows = [("full only", [True] * len(frames), 0.0)] + [(str(t), [score >= t for score in prefilter_scores], prefilter_ms) for t in args.thresholds]
+    for name, passed, cost in rows:
+        detected = [p and d for p, d in zip(passed, decisions)]
+        person = [d for d, label in zip(detected, labels) if label]
+        empty = [d for d, label in zip(detected, labels) if label is False]
+        ms = cost + args.full_ms * sum(passed) / len(frames)
+        line = "{:>9} {:>10.0%} {:>8} {:>8} {:>10.0f}".format(name, sum(passed) / len(frames),
+                                                             "{:.1%}".format(sum(person) / len(person)) if person else "-",
+                                                             "{:.1%}".format(sum(empty) / len(empty)) if empty else "-", ms)
+        if args.power_mw is not None:
+            line += " {:>10.1f}".format(ms * args.power_mw / 1000)
+        print(line)
+
+    if args.write_source:
+        write_source(args.prefilter, args.write_source)
+        print("Pre-filter written to {}".format(args.write_source))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,211 @@
+"""
+This script replays harvesting traces through the image transfer of natural_light and remote_inference (image_transfer.cpp and frame_codec.cpp, compiled on
+the host and run over the loopback link of transfer_sim.py) with a simulated storage capacitor, to exercise the pause/resume logic of the transfer.
+
+The capacitor (--capacitance-mf, starting at --start-mv) is charged by the harvested power of the trace and discharged by the device: every notification
+sent (--packet-uj), every connection event (--event-uj), the CPU while it is not sleeping (--active-mw) and sleep (--sleep-mw). The costs are assumed
+values, not measurements. read_voltage() of the sketch returns the capacitor voltage at the simulated time, so the transfer pauses below
+TRANSFER_PAUSE_VOLTAGE, resumes at TRANSFER_RESUME_VOLTAGE and gives up a pause after TRANSFER_MAX_PAUSE ms. The frames are sent the way deliver_image() in
+application.cpp does: an interrupted transfer is resumed up to TRANSFER_MAX_RESUMES times, otherwise it is given up.
+
+Built-in traces (all run by default, --trace runs a CSV file with time s and harvested mW per line instead):
+    bright      plenty of light, the transfer must never pause
+    dim         little light, the transfer pauses and resumes within TRANSFER_MAX_PAUSE, every frame is delivered
+    cloud       bright with a dark spell longer than TRANSFER_MAX_PAUSE, the interrupted frame is resumed (not restarted) and delivered
+    reconnect   dim, and the connection is lost during the first pause; after the reconnection the frame is resumed from the last acknowledged chunk
+    dark        no light, the frame is given up after TRANSFER_MAX_RESUMES resumes (the model has no brown-out, the capacitor drains to 0 V)
+Requires g++.
+
+Examples:
+    python energy_replay.py
+    python energy_replay.py --trace office.csv --frames 20 --capacitance-mf 2.2
+"""
+import argparse
+import bisect
+import csv
+import math
+import sys
+import tempfile
+
+from transfer_sim import MODES, Loopback, SimGateway, build_transfer, make_frames
+
+#Must be the same as in image_transfer.h
+TRANSFER_PAUSE_VOLTAGE = 3800
+TRANSFER_RESUME_VOLTAGE = 3950
+TRANSFER_MAX_PAUSE = 60000
+TRANSFER_MAX_RESUMES = 3
+TRANSFER_WINDOW = 4
+FRAME_HEADER_LENGTH = 8
+#Highest voltage of the storage, the harvester stops charging there
+MAX_MV = 4500
+
+TRACES = {
+    "bright": lambda time_ms: 30.0,
+    "dim": lambda time_ms: 1.5,
+    "cloud": lambda time_ms: 0.0 if 2000 <= time_ms < 2000 + TRANSFER_MAX_PAUSE + 20000 else 30.0,
+    "reconnect": lambda time_ms: 1.5,
+    "dark": lambda time_ms: 0.0,
+}
+
+
+def load_trace(path):
+    """CSV with time in s and harvested power in mW per line, linearly interpolated, the last value is held."""
+    with open(path) as f:
+        points = sorted((float(row[0]) * 1000, float(row[1])) for row in csv.reader(f) if row and not row[0].startswith("#"))
+    times = [time_ms for time_ms, _ in points]
+
+    def trace(time_ms):
+        i = bisect.bisect_right(times, time_ms)
+        if i == 0:
+            return points[0][1]
+        if i == len(points):
+            return points[-1][1]
+        (t0, p0), (t1, p1) = points[i - 1], points[i]
+        return p0 + (p1 - p0) * (time_ms - t0) / (t1 - t0)
+    return trace
+
+
+class Capacitor:
+    """Storage capacitor charged by the trace and discharged by the device, its voltage is what read_voltage() returns."""
+
+    def __init__(self, library, trace, args):
+        self.library = library
+        self.trace = trace
+        self.args = args
+        self.energy_mj = 0.5 * args.capacitance_mf * (args.start_mv / 1000) ** 2
+        self.time_ms = library.sim_now_ms()
+        self.start_ms = self.time_ms
+        self.packets = library.sim_packets()
+        self.events = library.sim_events()
+        self.sleep_ms = library.sim_sleep_ms()
+        self.min_mv = args.start_mv
+
+    def voltage(self, time_ms):
+        packets, events, sleep_ms = self.library.sim_packets(), self.library.sim_events(), self.library.sim_sleep_ms()
+        elapsed = max(time_ms - self.time_ms, 0)
+        slept = min(sleep_ms - self.sleep_ms, elapsed)
+        #Harvested power integrated with the midpoint of the interval
+        harvested = self.trace(self.time_ms - self.start_ms + elapsed / 2) * elapsed / 1000
+        used = ((packets - self.packets) * self.args.packet_uj + (events - self.events) * self.args.event_uj) / 1000 + \
+               ((elapsed - slept) * self.args.active_mw + slept * self.args.sleep_mw) / 1000
+        maximum = 0.5 * self.args.capacitance_mf * (MAX_MV / 1000) ** 2
+        self.energy_mj = min(max(self.energy_mj + harvested - used, 0), maximum)
+        self.time_ms, self.packets, self.events, self.sleep_ms = time_ms, packets, events, sleep_ms
+        mv = int(1000 * math.sqrt(2 * self.energy_mj / self.args.capacitance_mf))
+        self.min_mv = min(self.min_mv, mv)
+        return mv
+
+
+def deliver(library, link, image, disconnect=None):
+    """Sends one image like deliver_image() of application.cpp, returns (delivered, attempts, stats).
+    disconnect: ms until the central reconnects when the link was lost in the first pause, None if the link is kept"""
+    delivered = False
+    attempts = 0
+    stats = None
+    while not delivered and attempts <= TRANSFER_MAX_RESUMES:
+        if disconnect is not None and attempts == 0:
+            #The link drops in the middle of the first pause of the capacitor
+            link.pause_hook = lambda: library.sim_disconnect_at(library.sim_now_ms() + 1000)
+        delivered, stats = link.send(image)
+        attempts += 1
+        if not delivered and disconnect is not None and link.disconnected:
+            library.sim_advance(disconnect)
+            link.gateway.subscribe()
+            link.disconnected = False
+    if not delivered:
+        library.sim_abort()
+    return delivered, attempts, stats
+
+
+def run_trace(library, name, trace, frames, args):
+    """Sends the frames with the capacitor charged by the trace, returns (ok, report line)."""
+    capacitor = None
+
+    def voltage(time_ms):
+        mv = capacitor.voltage(time_ms)
+        #The first pause of the reconnect trace loses the connection
+        if link.pause_hook is not None and mv < TRANSFER_PAUSE_VOLTAGE:
+            link.pause_hook()
+            link.pause_hook = None
+            link.disconnected = True
+        return mv
+
+    link = Loopback(library, SimGateway, args, voltage=voltage)
+    link.pause_hook = None
+    link.disconnected = False
+    capacitor = Capacitor(library, trace, args)
+    link.gateway.subscribe()
+    start_ms = library.sim_now_ms()
+    delivered_frames = []
+    totals = {"paused_ms": 0, "resumes": 0, "given_up": 0, "restarted": 0}
+    for image in frames:
+        delivered, attempts, stats = deliver(library, link, image, args.reconnect_ms if name == "reconnect" and not delivered_frames else None)
+        if delivered:
+            delivered_frames.append(image)
+        else:
+            totals["given_up"] += 1
+        totals["paused_ms"] += stats["paused_ms"]
+        totals["resumes"] += stats["resumes"]
+        #A resumed frame continues from the last acknowledged chunk, at most a window of chunks in flight is sent again
+        payload = stats["chunk_size"] - FRAME_HEADER_LENGTH
+        total_chunks = (len(image) + payload - 1) // payload
+        if stats["chunks"] - stats["retransmitted"] > total_chunks + TRANSFER_WINDOW * stats["resumes"]:
+            totals["restarted"] += 1
+        library.sim_advance(args.period_ms)
+    images = [image for _, image in link.gateway.images]
+    intact = images == delivered_frames
+    expected = {
+        "bright": totals["paused_ms"] == 0 and not totals["given_up"],
+        "dim": totals["paused_ms"] > 0 and not totals["given_up"],
+        "cloud": totals["resumes"] > 0 and not totals["given_up"],
+        "reconnect": totals["resumes"] > 0 and not totals["given_up"],
+        "dark": totals["given_up"] == len(frames),
+    }.get(name, True)
+    ok = intact and expected and not totals["restarted"]
+    line = "{:>10} {:>5}/{:<3} {:>9.1f} {:>8} {:>9} {:>7} {:>7} {:>8.1f}  {}".format(
+        name, len(delivered_frames), len(frames), totals["paused_ms"] / 1000, totals["resumes"], totals["given_up"], "yes" if intact else "NO",
+        capacitor.min_mv, (library.sim_now_ms() - start_ms) / 1000, "ok" if ok else "FAIL")
+    return ok, line
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--trace", help="CSV file with time s, harvested mW")
+    parser.add_argument("--modes", nargs="+", default=list(MODES), choices=list(MODES))
+    parser.add_argument("--frames", type=int, default=5)
+    parser.add_argument("--sizes", type=int, nargs="+", default=[3080])
+    parser.add_argument("--period-ms", type=float, default=5000, help="time between two frames")
+    parser.add_argument("--capacitance-mf", type=float, default=1.0)
+    parser.add_argument("--start-mv", type=int, default=4000)
+    parser.add_argument("--packet-uj", type=float, default=50, help="assumed energy of one notification")
+    parser.add_argument("--event-uj", type=float, default=10, help="assumed energy of one connection event")
+    parser.add_argument("--active-mw", type=float, default=8, help="assumed power of the CPU while it is not sleeping")
+    parser.add_argument("--sleep-mw", type=float, default=0.02, help="assumed power while sleeping")
+    parser.add_argument("--reconnect-ms", type=float, default=5000, help="time until the central reconnects in the reconnect trace")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+    #Loopback link settings (see transfer_sim.py)
+    args.interval = 30
+    args.packets = 4
+    args.buffers = 8
+    args.gateway_ms = 10
+
+    traces = {args.trace: load_trace(args.trace)} if args.trace else TRACES
+    frames = make_frames(args.sizes, args.frames, args.seed)
+    ok = True
+    with tempfile.TemporaryDirectory() as build_dir:
+        for mode in args.modes:
+            library = build_transfer(build_dir, MODES[mode])
+            print("{} mode".format(mode))
+            print("{:>10} {:>9} {:>9} {:>8} {:>9} {:>7} {:>7} {:>8}".format("trace", "delivered", "paused s", "resumes", "given up", "intact",
+                                                                              "min mV", "time s"))
+            for name, trace in traces.items():
+                trace_ok, line = run_trace(library, name, trace, frames, args)
+                ok &= trace_ok
+                print(line)
+    print("All checks passed" if ok else "Some checks FAILED")
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,465 @@
+"""
+This script tests the image transfer protocol of the sketches: the codec (frame_codec.cpp, compiled on the host) against its gateway counterpart
+(Gateway_examples/frame_codec.py), and the transfer over a link that loses, reorders and duplicates chunks.
+
+The codec part round-trips every message type (DATA, ACK, NACK, RESULT and REFINE) with random contents through the C++ encoder and decoder, checks that the
+C++ and Python encoders produce the same bytes and that each side decodes the messages of the other. Chunks with a flipped bit, truncated messages and
+messages of another type have to be rejected.
+
+The result part matches the results the gateway encodes (as vjezba.py writes them) with frame_match_result against the frame the device just sent. The
+gateway answers a sequence of frames (frame ids wrapping at 255) with random scores, latencies and boxes, and the link delays some results until the next frame
+was sent (--late), repeats some (--repeat) and mixes in acknowledgements and the ASCII answers of the old gateway ("51" for 5.1%). The device has to take
+exactly the first result of the frame it waits for, count late and repeated results as stale and ignore everything else; the accepted score has to give the
+gateway's decision with RESULT_PERSON_THRESHOLD (a score of 5.1% is no person, which the old first-digit check read as a person).
+
+The loss/reorder part sends frames with image_transfer.cpp over the loopback link of transfer_sim.py. The gateway drops (--loss), holds back for one chunk
+(--reorder) or duplicates (--duplicate) chunks before its reassembler sees them, so the device has to retransmit what the gateway reports missing. A frame
+interrupted by a lost connection and given up has to be dropped by the gateway, and the next frame delivered. Every delivered frame has to be intact. A chunk
+that never arrives intact (the gateway reports it missing again and again) may only be sent TRANSFER_MAX_RESENDS times again before the device gives the frame up.
+Requires g++.
+
+Examples:
+    python frame_codec_check.py
+    python frame_codec_check.py --frames 50 --loss 0.1 --reorder 0.1 --duplicate 0.05
+    python frame_codec_check.py --results 5000 --late 0.2
+"""
+import argparse
+import ctypes
+import os
+import random
+import sys
+import tempfile
+
+from sketch_build import sketch_library
+from transfer_sim import TRANSFER_NOTIFY_WINDOWED, Loopback, SimGateway, build_transfer, make_frames
+
+#transfer_sim.py adds Gateway_examples to the path
+import frame_codec
+
+SKETCH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Arduino_examples", "natural_light")
+#Must be the same as in frame_codec.h
+FRAME_ACK_LENGTH = 6
+FRAME_NACK_LENGTH = 11
+FRAME_MATCH_NONE = 0
+FRAME_MATCH_ACCEPTED = 1
+FRAME_MATCH_STALE = 2
+#Must be the same as in application.h of remote_inference
+RESULT_PERSON_THRESHOLD = 500
+#Must be the same as in image_transfer.h
+TRANSFER_MAX_RESENDS = 8
+
+WRAPPER = """
+#include "frame_codec.h"
+extern "C" int check_encode_chunk(uint8_t* out, int frame_id, int index, int total_length, const uint8_t* payload, int payload_length)
+{
+    return frame_encode_chunk(out, frame_id, index, total_length, payload, payload_length);
+}
+//fields: frame id, index, total length, payload offset, payload length
+extern "C" bool check_decode_chunk(const uint8_t* data, int length, long* fields)
+{
+    struct FrameChunk chunk;
+    if(!frame_decode_chunk(data, length, &chunk))
+    {
+        return false;
+    }
+    long values[] = {chunk.frame_id, chunk.index, chunk.total_length, (long)(chunk.payload - data), chunk.payload_length};
+    for(int i = 0; i < 5; i++) fields[i] = values[i];
+    return true;
+}
+extern "C" int check_encode_ack(uint8_t* out, int frame_id, int next, int mtu) { return frame_encode_ack(out, frame_id, next, mtu); }
+extern "C" int check_encode_nack(uint8_t* out, int frame_id, int next, int mtu, int span, unsigned long missing)
+{
+    return frame_encode_nack(out, frame_id, next, mtu, span, missing);
+}
+//fields: frame id, next, mtu, span, missing
+extern "C" bool check_decode_ack(const uint8_t* data, int length, long* fields)
+{
+    struct FrameAck ack;
+    if(!frame_decode_ack(data, length, &ack))
+    {
+        return false;
+    }
+    long values[] = {ack.frame_id, ack.next, ack.mtu, ack.span, (long)ack.missing};
+    for(int i = 0; i < 5; i++) fields[i] = values[i];
+    return true;
+}
+//fields: frame id, score, latency, flags, x0, y0, x1, y1
+extern "C" int check_encode_result(uint8_t* out, const long* fields)
+{
+    struct FrameResult result = {(uint8_t)fields[0], (uint16_t)fields[1], (uint16_t)fields[2], (uint8_t)fields[3],
+                                 {(uint8_t)fields[4], (uint8_t)fields[5], (uint8_t)fields[6], (uint8_t)fields[7]}};
+    return frame_encode_result(out, &result);
+}
+extern "C" bool check_decode_result(const uint8_t* data, int length, long* fields)
+{
+    struct FrameResult result;
+    if(!frame_decode_result(data, length, &result))
+    {
+        return false;
+    }
+    long values[] = {result.frame_id, result.score, result.latency_ms, result.flags, result.box[0], result.box[1], result.box[2], result.box[3]};
+    for(int i = 0; i < 8; i++) fields[i] = values[i];
+    return true;
+}
+extern "C" int check_match(const uint8_t* data, int length, int frame_id, bool received, long* fields)
+{
+    struct FrameResult result;
+    int match = frame_match_result(data, length, frame_id, received, &result);
+    if(match == FRAME_MATCH_ACCEPTED)
+    {
+        long values[] = {result.frame_id, result.score, result.latency_ms, result.flags, result.box[0], result.box[1], result.box[2], result.box[3]};
+        for(int i = 0; i < 8; i++) fields[i] = values[i];
+    }
+    return match;
+}
+extern "C" int check_encode_refine(uint8_t* out, int frame_id) { return frame_encode_refine(out, frame_id); }
+extern "C" int check_decode_refine(const uint8_t* data, int length)
+{
+    uint8_t frame_id;
+    return frame_decode_refine(data, length, &frame_id) ? frame_id : -1;
+}
+"""
+
+
+def build_codec(build_dir):
+    """Compiles frame_codec.cpp of the sketch into a shared library and returns it loaded with ctypes."""
+    library = sketch_library(build_dir, SKETCH, ["frame_codec.cpp"], WRAPPER)
+    for name in ("check_decode_chunk", "check_decode_ack", "check_decode_result"):
+        getattr(library, name).restype = ctypes.c_bool
+    library.check_encode_nack.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_ulong]
+    library.check_match.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_int, ctypes.c_bool, ctypes.POINTER(ctypes.c_long)]
+    return library
+
+
+class Codec:
+    """Python view of the C++ codec."""
+
+    def __init__(self, library):
+        self.library = library
+        self.out = ctypes.create_string_buffer(512)
+        self.fields = (ctypes.c_long * 8)()
+
+    def encode_chunk(self, frame_id, index, total_length, payload):
+        length = self.library.check_encode_chunk(self.out, frame_id, index, total_length, payload, len(payload))
+        return self.out.raw[:length]
+
+    def decode_chunk(self, data):
+        if not self.library.check_decode_chunk(data, len(data), self.fields):
+            return None
+        frame_id, index, total_length, offset, length = self.fields[:5]
+        return frame_id, index, total_length, data[offset:offset + length]
+
+    def encode_ack(self, frame_id, next_chunk, mtu):
+        length = self.library.check_encode_ack(self.out, frame_id, next_chunk, mtu)
+        return self.out.raw[:length]
+
+    def encode_nack(self, frame_id, next_chunk, mtu, span, missing):
+        length = self.library.check_encode_nack(self.out, frame_id, next_chunk, mtu, span, missing)
+        return self.out.raw[:length]
+
+    def decode_ack(self, data):
+        return tuple(self.fields[:5]) if self.library.check_decode_ack(data, len(data), self.fields) else None
+
+    def encode_result(self, fields):
+        length = self.library.check_encode_result(self.out, (ctypes.c_long * 8)(*fields))
+        return self.out.raw[:length]
+
+    def decode_result(self, data):
+        return tuple(self.fields[:8]) if self.library.check_decode_result(data, len(data), self.fields) else None
+
+    def match_result(self, data, frame_id, received):
+        """FRAME_MATCH_* of the message for the frame the device waits for, and the fields of an accepted result."""
+        match = self.library.check_match(data, len(data), frame_id, received, self.fields)
+        return match, tuple(self.fields[:8]) if match == FRAME_MATCH_ACCEPTED else None
+
+    def encode_refine(self, frame_id):
+        length = self.library.check_encode_refine(self.out, frame_id)
+        return self.out.raw[:length]
+
+    def decode_refine(self, data):
+        frame_id = self.library.check_decode_refine(data, len(data))
+        return None if frame_id < 0 else frame_id
+
+
+class Checker:
+    def __init__(self):
+        self.failures = {}
+        self.counts = {}
+
+    def expect(self, name, condition):
+        self.counts[name] = self.counts.get(name, 0) + 1
+        if not condition:
+            self.failures[name] = self.failures.get(name, 0) + 1
+
+    def report(self):
+        for name in self.counts:
+            print("  {:<44} {:>5} cases  {}".format(name, self.counts[name],
+                                                    "ok" if name not in self.failures else "FAIL ({})".format(self.failures[name])))
+        return not self.failures
+
+
+def check_codec(codec, rng, cases):
+    checker = Checker()
+    for _ in range(cases):
+        frame_id = rng.randrange(256)
+        index = rng.randrange(65536)
+        total_length = rng.randrange(65536)
+        payload = bytes(rng.getrandbits(8) for _ in range(rng.randrange(1, 237)))
+        chunk = codec.encode_chunk(frame_id, index, total_length, payload)
+        checker.expect("DATA round trip", codec.decode_chunk(chunk) == (frame_id, index, total_length, payload))
+        checker.expect("DATA same bytes as Python", chunk == frame_codec.encode_chunk(frame_id, index, total_length, payload))
+        checker.expect("DATA decoded by Python", frame_codec.decode_chunk(chunk) == (frame_id, index, total_length, payload))
+        corrupted = bytearray(chunk)
+        bit = rng.randrange(8, len(chunk) * 8)
+        corrupted[bit // 8] ^= 1 << (bit % 8)
+        checker.expect("DATA with a flipped bit rejected", codec.decode_chunk(bytes(corrupted)) is None)
+        checker.expect("DATA header without payload rejected", codec.decode_chunk(chunk[:8]) is None)
+
+        next_chunk = rng.randrange(65536)
+        mtu = rng.randrange(23, 518)
+        ack = codec.encode_ack(frame_id, next_chunk, mtu)
+        checker.expect("ACK round trip", codec.decode_ack(ack) == (frame_id, next_chunk, mtu, 0, 0))
+        checker.expect("ACK same bytes as Python", ack == frame_codec.encode_ack(frame_id, next_chunk, mtu))
+        span = rng.randrange(1, frame_codec.FRAME_NACK_SPAN + 1)
+        missing = rng.getrandbits(span)
+        nack = codec.encode_nack(frame_id, next_chunk, mtu, span, missing)
+        checker.expect("NACK round trip", codec.decode_ack(nack) == (frame_id, next_chunk, mtu, span, missing))
+        checker.expect("NACK same bytes as Python", nack == frame_codec.encode_nack(frame_id, next_chunk, mtu, span, missing))
+        checker.expect("ACK/NACK truncated rejected", codec.decode_ack(ack[:-1]) is None and codec.decode_ack(nack[:-1]) is None)
+
+        box = tuple(rng.random() for _ in range(4)) if rng.random() < 0.5 else None
+        score = rng.random()
+        latency_ms = rng.randrange(65536)
+        python_result = frame_codec.encode_result(frame_id, score, latency_ms, box)
+        decoded = codec.decode_result(python_result)
+        expected_box = tuple(int(round(value * 255)) for value in box) if box else (0, 0, 0, 0)
+        checker.expect("RESULT from Python decoded", decoded == (frame_id, int(round(score * 1000)), latency_ms,
+                                                                 frame_codec.FRAME_RESULT_BOX if box else 0) + expected_box)
+        checker.expect("RESULT round trip", decoded is not None and codec.decode_result(codec.encode_result(decoded)) == decoded)
+        checker.expect("RESULT same bytes as Python", decoded is not None and codec.encode_result(decoded) == python_result)
+        checker.expect("RESULT truncated rejected", codec.decode_result(python_result[:-1]) is None)
+
+        refine = codec.encode_refine(frame_id)
+        checker.expect("REFINE round trip", codec.decode_refine(refine) == frame_id and refine == frame_codec.encode_refine(frame_id))
+        #Every message is only accepted by its own decoder
+        checker.expect("other message types rejected", codec.decode_ack(python_result) is None and codec.decode_result(ack) is None
+                       and codec.decode_refine(ack[:2]) is None and codec.decode_chunk(nack) is None)
+    return checker.report()
+
+
+class ResultReceiver:
+    """The receive handler of the sketch for one frame: the result of the frame it waits for and the stale results."""
+
+    def __init__(self, codec):
+        self.codec = codec
+        self.frame_id = 0
+        self.result = None
+        self.stale = 0
+
+    def send_frame(self, frame_id):
+        self.frame_id = frame_id
+        self.result = None
+
+    def receive(self, message):
+        match, fields = self.codec.match_result(message, self.frame_id, self.result is not None)
+        if match == FRAME_MATCH_ACCEPTED:
+            self.result = fields
+        elif match == FRAME_MATCH_STALE:
+            self.stale += 1
+        return match
+
+
+def gateway_result(rng, frame_id):
+    """Result as vjezba.py encodes it, with the probability the gateway decided on."""
+    probability = rng.random()
+    #Ties at exactly 0.5 are decided differently by the gateway (yhat > 0.5) and the device (score >= threshold), keep clear of them
+    while abs(probability - 0.5) < 0.001:
+        probability = rng.random()
+    box = tuple(sorted(rng.random() for _ in range(2))) * 2 if probability > 0.5 else None
+    return probability, frame_codec.encode_result(frame_id, probability, rng.randrange(5000), box)
+
+
+def check_results(codec, rng, frames, late_share, repeat_share):
+    checker = Checker()
+    device = ResultReceiver(codec)
+    late = None
+    expected_stale = 0
+    for frame in range(frames):
+        frame_id = frame % 256
+        device.send_frame(frame_id)
+        #The late result of the previous frame arrives first
+        if late is not None:
+            device.receive(late)
+            expected_stale += 1
+            late = None
+        #Acknowledgements and answers of the old gateway are not results
+        for other in (frame_codec.encode_ack(frame_id, 3, 247), str(rng.randrange(1000)).encode(), frame_codec.encode_refine(frame_id)):
+            checker.expect("other messages ignored", device.receive(other) == FRAME_MATCH_NONE)
+        probability, message = gateway_result(rng, frame_id)
+        if rng.random() < late_share:
+            #Arrives too late (after the device gave up waiting), the frame has no result
+            late = message
+            checker.expect("late result not taken", device.result is None)
+            continue
+        device.receive(message)
+        if rng.random() < repeat_share:
+            device.receive(message)
+            expected_stale += 1
+        checker.expect("result of the frame taken", device.result is not None and device.result[0] == frame_id
+                       and device.result[1] == round(frame_codec.decode_result(message)[1] * 1000))
+        checker.expect("decision as the gateway's", device.result is not None and (device.result[1] >= RESULT_PERSON_THRESHOLD) == (probability > 0.5))
+    checker.expect("late and repeated results stale", device.stale == expected_stale)
+    #The case of the old first-digit check: 5.1% starts with "5" but is no person
+    device.send_frame(7)
+    device.receive(frame_codec.encode_result(7, 0.051, 100))
+    checker.expect("decision as the gateway's", device.result is not None and device.result[1] < RESULT_PERSON_THRESHOLD)
+    return checker.report()
+
+
+class PerturbedGateway(SimGateway):
+    """Gateway behind a link that drops, reorders and duplicates chunks."""
+
+    def __init__(self, library, windowed, rng=None, loss=0.0, reorder=0.0, duplicate=0.0):
+        SimGateway.__init__(self, library, windowed)
+        self.rng = rng
+        self.loss = loss
+        self.reorder = reorder
+        self.duplicate = duplicate
+        self.held = None
+        self.perturbed = {"lost": 0, "reordered": 0, "duplicated": 0}
+
+    def on_notify(self, data, length, time_ms):
+        data = bytes(data[:length])
+        if self.rng.random() < self.loss:
+            self.perturbed["lost"] += 1
+            return
+        if self.held is None and self.rng.random() < self.reorder:
+            #Delivered after the next chunk
+            self.held = data
+            self.perturbed["reordered"] += 1
+            return
+        self.deliver(data, time_ms)
+        if self.rng.random() < self.duplicate:
+            self.perturbed["duplicated"] += 1
+            self.deliver(data, time_ms)
+        if self.held is not None:
+            held, self.held = self.held, None
+            self.deliver(held, time_ms)
+
+
+def check_link(library, frames, args, rng, loss, reorder, duplicate):
+    link = Loopback(library, PerturbedGateway, args, rng=rng, loss=loss, reorder=reorder, duplicate=duplicate)
+    link.gateway.subscribe()
+    failed = 0
+    retransmitted = 0
+    for image in frames:
+        delivered, stats = link.send(image)
+        if not delivered:
+            library.sim_abort()
+            failed += 1
+        retransmitted += stats["retransmitted"]
+    images = [image for _, image in link.gateway.images]
+    intact = images == frames[:len(images)]
+    #A lost chunk is only recovered by a retransmission
+    ok = intact and failed == 0 and len(images) == len(frames) and (link.gateway.perturbed["lost"] == 0 or retransmitted > 0)
+    print("  loss {:>4.0%} reorder {:>4.0%} duplicate {:>4.0%}: {}/{} frames delivered{}, {} chunks lost, {} reordered, {} duplicated, {} retransmitted  {}".format(
+        loss, reorder, duplicate, len(images), len(frames), "" if intact else " (CORRUPTED)", link.gateway.perturbed["lost"],
+        link.gateway.perturbed["reordered"], link.gateway.perturbed["duplicated"], retransmitted, "ok" if ok else "FAIL"))
+    return ok
+
+
+def check_interrupted(library, frames, args):
+    """The connection is lost in the middle of a frame, the device gives the frame up and sends the next one on a new connection."""
+    frames = [image for image in frames if len(image) > 1000][:2]
+    link = Loopback(library, SimGateway, args)
+    link.gateway.subscribe()
+    library.sim_disconnect_at(library.sim_now_ms() + args.interval * 3)
+    delivered, _ = link.send(frames[0])
+    library.sim_abort()
+    link.gateway.subscribe()
+    delivered_next, _ = link.send(frames[1])
+    images = [image for _, image in link.gateway.images]
+    ok = not delivered and delivered_next and images == [frames[1]] and link.gateway.reassembler.dropped_frames == 1
+    print("  interrupted frame given up: next frame delivered {}, partial frame dropped by the gateway {}  {}".format(
+        "yes" if images == [frames[1]] else "no", link.gateway.reassembler.dropped_frames, "ok" if ok else "FAIL"))
+    return ok
+
+
+class StuckGateway(SimGateway):
+    """Gateway behind a link that corrupts every copy of one chunk of the first frame (up to a limit, so a device that never gives up still ends).
+    The gateway acknowledges every notification, so it reports the chunk missing after each corrupted copy."""
+
+    def __init__(self, library, windowed, index=2, limit=50):
+        SimGateway.__init__(self, library, windowed, ack_every=1)
+        self.index = index
+        self.limit = limit
+        self.corrupted = 0
+        self.first_frame = None
+
+    def on_notify(self, data, length, time_ms):
+        data = bytes(data[:length])
+        chunk = frame_codec.decode_chunk(data)
+        if chunk is not None:
+            if self.first_frame is None:
+                self.first_frame = chunk[0]
+            if chunk[0] == self.first_frame and chunk[1] == self.index and self.corrupted < self.limit:
+                self.corrupted += 1
+                data = data[:-1] + bytes([data[-1] ^ 0x01])
+        self.deliver(data, time_ms)
+
+
+def check_stuck_chunk(library, frames, args):
+    """One chunk never arrives intact, the device gives the frame up after TRANSFER_MAX_RESENDS retransmissions and sends the next one."""
+    frames = [image for image in frames if len(image) > 2000][:2]
+    link = Loopback(library, StuckGateway, args)
+    link.gateway.subscribe()
+    delivered, _ = link.send(frames[0])
+    library.sim_abort()
+    delivered_next, _ = link.send(frames[1])
+    images = [image for _, image in link.gateway.images]
+    ok = not delivered and delivered_next and images == [frames[1]] and link.gateway.corrupted <= TRANSFER_MAX_RESENDS + 1
+    print("  chunk never intact: sent {} times, frame given up {}, next frame delivered {}  {}".format(
+        link.gateway.corrupted, "yes" if not delivered else "no", "yes" if images == [frames[1]] else "no", "ok" if ok else "FAIL"))
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--cases", type=int, default=500, help="random messages per type")
+    parser.add_argument("--frames", type=int, default=20, help="frames per link scenario")
+    parser.add_argument("--loss", type=float, default=0.1)
+    parser.add_argument("--reorder", type=float, default=0.1)
+    parser.add_argument("--duplicate", type=float, default=0.05)
+    parser.add_argument("--results", type=int, default=1000, help="frames the gateway answers in the result part")
+    parser.add_argument("--late", type=float, default=0.1, help="share of results that arrive after the next frame was sent")
+    parser.add_argument("--repeat", type=float, default=0.1, help="share of results the gateway sends twice")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+    #Loopback link settings (see transfer_sim.py)
+    args.interval = 30
+    args.packets = 4
+    args.buffers = 8
+    args.gateway_ms = 10
+
+    rng = random.Random(args.seed)
+    ok = True
+    with tempfile.TemporaryDirectory() as build_dir:
+        print("Codec (C++ and Gateway_examples/frame_codec.py)")
+        codec = Codec(build_codec(build_dir))
+        ok &= check_codec(codec, rng, args.cases)
+        print("Results matched against the sent frame")
+        ok &= check_results(codec, rng, args.results, args.late, args.repeat)
+        print("Transfer over a lossy link")
+        library = build_transfer(build_dir, TRANSFER_NOTIFY_WINDOWED)
+        frames = make_frames([100, 1000, 3080, 4096], args.frames, args.seed)
+        for loss, reorder, duplicate in ((0, 0, 0), (args.loss, 0, 0), (0, args.reorder, 0), (0, 0, args.duplicate),
+                                         (args.loss, args.reorder, args.duplicate)):
+            ok &= check_link(library, frames, args, rng, loss, reorder, duplicate)
+        ok &= check_interrupted(library, frames, args)
+        ok &= check_stuck_chunk(library, frames, args)
+    print("All checks passed" if ok else "Some checks FAILED")
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
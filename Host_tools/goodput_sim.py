@@ -0,0 +1,133 @@
+"""
+This script reports the goodput of the windowed image transfer over a lossy link. The transfer of the natural_light and remote_inference sketches
+(image_transfer.cpp and frame_codec.cpp, compiled on the host) runs over the loopback link of transfer_sim.py, and every chunk is lost with the given
+probability (--loss) before it reaches the gateway.
+
+Two gateways are compared for every loss rate:
+    selective   the reassembler of Gateway_examples/frame_codec.py, which reports the missing chunks with FRAME_NACK, so only those are sent again
+    ack only    the same reassembler answering with cumulative FRAME_ACKs only, so the device finds lost chunks by the ack timeout and resends the chunks in flight
+The whole-frame resend of the original transfer (the gateway drops a frame with a missing chunk and the whole frame is sent again) is not in the sketch any
+more, its expected goodput is computed: a frame of n chunks gets through with probability (1 - loss)^n.
+
+Goodput is image bytes divided by the bytes sent (chunk headers and retransmissions included), throughput the image bytes per second. Every NACK the gateway
+sends is also decoded by the sketch codec (frame_decode_ack, compiled on the host) and has to name exactly the chunks the reassembler is missing.
+Requires g++.
+
+Examples:
+    python goodput_sim.py
+    python goodput_sim.py --loss 0 0.01 0.05 0.1 0.2 0.3 --frames 50 --sizes 4096
+"""
+import argparse
+import random
+import sys
+import tempfile
+
+from frame_codec_check import Codec, PerturbedGateway, build_codec
+from transfer_sim import TRANSFER_NOTIFY_WINDOWED, Loopback, build_transfer, make_frames
+
+#transfer_sim.py adds Gateway_examples to the path
+import frame_codec
+
+
+class CheckedGateway(PerturbedGateway):
+    """Lossy gateway that counts the bytes sent by the device and checks every NACK it writes with the sketch codec."""
+
+    def __init__(self, library, windowed, rng=None, loss=0.0, codec=None, selective=True):
+        PerturbedGateway.__init__(self, library, windowed, rng=rng, loss=loss)
+        self.codec = codec
+        self.selective = selective
+        self.bytes_sent = 0
+        self.nacks = 0
+        self.nack_mismatches = 0
+
+    def on_notify(self, data, length, time_ms):
+        self.bytes_sent += length
+        PerturbedGateway.on_notify(self, data, length, time_ms)
+
+    def write(self, message):
+        if message[0] == frame_codec.FRAME_NACK:
+            if not self.selective:
+                #Cumulative acknowledgement only
+                message = frame_codec.encode_ack(message[1], message[2] | (message[3] << 8), message[4] | (message[5] << 8))
+            else:
+                self.nacks += 1
+                decoded = self.codec.decode_ack(message)
+                missing = set()
+                if decoded is not None:
+                    _, next_chunk, _, span, bitmap = decoded
+                    missing = {next_chunk + i for i in range(span) if bitmap & (1 << i)}
+                reassembler = self.reassembler
+                expected = {i for i in range(reassembler.next_expected(), max(reassembler.chunks) + 1) if i not in reassembler.chunks}
+                self.nack_mismatches += missing != {i for i in expected if i < reassembler.next_expected() + frame_codec.FRAME_NACK_SPAN}
+        PerturbedGateway.write(self, message)
+
+
+def whole_frame_goodput(frames, loss, chunk_size):
+    """Expected goodput when every frame with a lost chunk is sent again as a whole."""
+    payload = chunk_size - frame_codec.FRAME_HEADER_LENGTH
+    image_bytes = 0
+    sent_bytes = 0
+    for image in frames:
+        chunks = (len(image) + payload - 1) // payload
+        image_bytes += len(image)
+        sent_bytes += (len(image) + chunks * frame_codec.FRAME_HEADER_LENGTH) / (1 - loss) ** chunks
+    return image_bytes / sent_bytes
+
+
+def run(library, codec, frames, args, loss, selective, seed):
+    link = Loopback(library, CheckedGateway, args, rng=random.Random(seed), loss=loss, codec=codec, selective=selective)
+    link.gateway.subscribe()
+    start_ms = library.sim_now_ms()
+    totals = {"retransmitted": 0, "failed": 0, "chunk_size": 0}
+    for image in frames:
+        delivered, stats = link.send(image)
+        if not delivered:
+            library.sim_abort()
+            totals["failed"] += 1
+        totals["retransmitted"] += stats["retransmitted"]
+        totals["chunk_size"] = stats["chunk_size"]
+    delivered_bytes = sum(len(image) for _, image in link.gateway.images)
+    totals["goodput"] = delivered_bytes / link.gateway.bytes_sent if link.gateway.bytes_sent else 0
+    totals["throughput"] = delivered_bytes * 1000 / (library.sim_now_ms() - start_ms)
+    totals["intact"] = all(image in frames for _, image in link.gateway.images)
+    totals["nacks"] = link.gateway.nacks
+    totals["nack_mismatches"] = link.gateway.nack_mismatches
+    return totals
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--loss", type=float, nargs="+", default=[0, 0.02, 0.05, 0.1, 0.2])
+    parser.add_argument("--frames", type=int, default=20)
+    parser.add_argument("--sizes", type=int, nargs="+", default=[3080])
+    parser.add_argument("--interval", type=float, default=30, help="connection interval in ms")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+    #Loopback link settings (see transfer_sim.py)
+    args.packets = 4
+    args.buffers = 8
+    args.gateway_ms = 10
+
+    frames = make_frames(args.sizes, args.frames, args.seed)
+    ok = True
+    with tempfile.TemporaryDirectory() as build_dir:
+        codec = Codec(build_codec(build_dir))
+        library = build_transfer(build_dir, TRANSFER_NOTIFY_WINDOWED)
+        print("{:>6} {:>11} {:>9} {:>8} {:>8} {:>7} {:>7} {:>7}".format("loss", "gateway", "goodput", "B/s", "resent", "failed", "intact", "NACKs"))
+        for loss in args.loss:
+            chunk_size = 0
+            for name, selective in (("selective", True), ("ack only", False)):
+                totals = run(library, codec, frames, args, loss, selective, args.seed)
+                chunk_size = totals["chunk_size"]
+                nacks_ok = totals["nack_mismatches"] == 0
+                ok &= totals["intact"] and nacks_ok
+                print("{:>6.0%} {:>11} {:>9.1%} {:>8.0f} {:>8} {:>7} {:>7} {:>7}".format(
+                    loss, name, totals["goodput"], totals["throughput"], totals["retransmitted"], totals["failed"], "yes" if totals["intact"] else "NO",
+                    "{} ok".format(totals["nacks"]) if nacks_ok else "{} FAIL".format(totals["nack_mismatches"])))
+            print("{:>6.0%} {:>11} {:>9.1%}  (computed)".format(loss, "whole frame", whole_frame_goodput(frames, loss, chunk_size)))
+    print("All checks passed" if ok else "Some checks FAILED")
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
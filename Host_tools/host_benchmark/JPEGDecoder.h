@@ -0,0 +1,48 @@
+#ifndef HOST_BENCHMARK_JPEGDECODER_H_
+#define HOST_BENCHMARK_JPEGDECODER_H_
+
+#include <stdint.h>
+#include "picojpeg.h"
+
+//Host version of the JPEGDecoder library (https://github.com/Bodmer/JPEGDecoder): the part of its interface frame_decoder.cpp uses, over the same
+//picojpeg decoder, so the sketch code decodes the frames exactly as on the board. The Arduino library also reads files and SD cards, which needs the core.
+class JPEGDecoder
+{
+public:
+    uint16_t* pImage;           //RGB565 pixels of the last MCU read, MCUWidth x MCUHeight
+    int width;
+    int height;
+    int comps;
+    int MCUSPerRow;
+    int MCUSPerCol;
+    pjpeg_scan_type_t scanType;
+    int MCUWidth;
+    int MCUHeight;
+    int MCUx;
+    int MCUy;
+
+    JPEGDecoder();
+    ~JPEGDecoder();
+    //Returns 1 if the headers were parsed, 0 or -1 otherwise (as the library)
+    int decodeArray(const uint8_t array[], uint32_t array_size);
+    //Decodes the next MCU into pImage, returns 0 after the last one
+    int read();
+    void abort();
+
+private:
+    static unsigned char need_bytes(unsigned char* buffer, unsigned char buffer_size, unsigned char* bytes_read, void* data);
+    int decode_mcu();
+
+    pjpeg_image_info_t image_info;
+    const uint8_t* array;
+    uint32_t array_size;
+    uint32_t array_index;
+    int mcu_x;
+    int mcu_y;
+    int row_pitch;
+    bool available;
+};
+
+extern JPEGDecoder JpegDec;
+
+#endif
@@ -0,0 +1,9 @@
+/*
+This script writes the TensorFlow Lite Micro log of the host benchmark to stderr (on the board the Arduino library writes it to Serial).
+*/
+#include <stdio.h>
+
+extern "C" void DebugLog(const char* s)
+{
+    fputs(s, stderr);
+}
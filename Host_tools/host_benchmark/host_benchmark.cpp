@@ -0,0 +1,327 @@
+/*
+This script benchmarks the person detection model of the natural_light sketch on a Linux host. It is built from the sources of the sketch (the model array,
+the JPEG decoding and preprocessing of frame_decoder.cpp and input_lut.cpp, the kernel wrapper of split_inference.cpp and the operator profiler) with
+TensorFlow Lite Micro compiled for the host, so the same interpreter, arena and kernels run as on the board, only on a faster CPU with the reference kernels.
+Changes of the model, the resolver, the arena size or the preprocessing can be checked here before they are flashed.
+
+Every JPEG frame of the directory (camera frames of 160x120, or person / no_person subdirectories for labelled frames) is decoded and run --runs times. The
+benchmark reports the arena usage after AllocateTensors(), the percentiles of the decoding and inference latency, and for labelled frames the accuracy of
+the decision (person probability >= --threshold). With --csv the result of every frame is written as CSV. When built with PROFILE=1 (OP_PROFILER_ENABLED)
+the operator table is written to stdout as well, for Host_tools/op_profile_report.py.
+
+Examples:
+    ./host_benchmark frames
+    ./host_benchmark frames --runs 20 --threshold 0.6 --csv results.csv
+    ./host_benchmark frames | python ../op_profile_report.py      (built with make PROFILE=1)
+*/
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "tensorflow/lite/version.h"
+
+#include "arena_settings.h"
+#include "frame_decoder.h"
+#include "input_lut.h"
+#include "model_settings.h"
+#include "op_profiler.h"
+#include "person_detect_model_data.h"
+#include "score_filter.h"
+#include "split_inference.h"
+#include <JPEGDecoder.h>
+
+//Must be the same as resolver_ops in natural_light.ino
+constexpr int kResolverOps = 8;
+const tflite::BuiltinOperator resolver_ops[kResolverOps] = {tflite::BuiltinOperator_AVERAGE_POOL_2D, tflite::BuiltinOperator_CONV_2D,
+                                                            tflite::BuiltinOperator_DEPTHWISE_CONV_2D, tflite::BuiltinOperator_RESHAPE,
+                                                            tflite::BuiltinOperator_SOFTMAX, tflite::BuiltinOperator_FULLY_CONNECTED,
+                                                            tflite::BuiltinOperator_MAX_POOL_2D, tflite::BuiltinOperator_ADD};
+constexpr int kTensorArenaSize = TENSOR_ARENA_SIZE;
+alignas(16) static uint8_t tensor_arena[kTensorArenaSize];
+static int8_t input_lut[256];
+
+struct Frame
+{
+    std::string path;
+    int label;                  //1 person, 0 no person, -1 unlabelled
+    float score;                //person probability of the last run
+    bool person;
+    double decode_us;           //median over the runs
+    double invoke_us;
+};
+
+static bool is_jpeg(const char* name)
+{
+    const char* extension = strrchr(name, '.');
+    return extension != nullptr && (strcasecmp(extension, ".jpg") == 0 || strcasecmp(extension, ".jpeg") == 0);
+}
+
+//Frames of a directory and of its person / no_person subdirectories, sorted by path as in Host_tools/split_benchmark.py
+static void list_frames(const std::string& directory, int label, std::vector<struct Frame>& frames)
+{
+    DIR* dir = opendir(directory.c_str());
+    if(dir == nullptr)
+    {
+        return;
+    }
+    while(struct dirent* entry = readdir(dir))
+    {
+        if(is_jpeg(entry->d_name))
+        {
+            struct Frame frame = {};
+            frame.path = directory + "/" + entry->d_name;
+            frame.label = label;
+            frames.push_back(frame);
+        }
+    }
+    closedir(dir);
+}
+
+static bool read_file(const std::string& path, std::vector<uint8_t>& data)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if(file == nullptr)
+    {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data.resize(length > 0 ? length : 0);
+    bool ok = length > 0 && fread(data.data(), 1, length, file) == (size_t)length;
+    fclose(file);
+    return ok;
+}
+
+static double elapsed_us(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+//Nearest-rank percentile of sorted values
+static double percentile(const std::vector<double>& sorted, double p)
+{
+    if(sorted.empty())
+    {
+        return 0;
+    }
+    size_t rank = (size_t)(p / 100.0 * sorted.size() + 0.999999);
+    rank = rank < 1 ? 1 : rank;
+    return sorted[std::min(rank, sorted.size()) - 1];
+}
+
+static void print_latency(const char* name, std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    printf("%-8s p50 %9.0f us  p90 %9.0f us  p99 %9.0f us  max %9.0f us\n", name, percentile(values, 50), percentile(values, 90),
+           percentile(values, 99), values.empty() ? 0 : values.back());
+}
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "Usage: %s <frame directory> [--runs N] [--threshold P] [--csv file]\n", program);
+    exit(2);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* directory = nullptr;
+    const char* csv_path = nullptr;
+    int runs = 5;
+    float threshold = SCORE_FILTER_THRESHOLD;
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+        {
+            runs = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+        {
+            threshold = atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+        {
+            csv_path = argv[++i];
+        }
+        else if(argv[i][0] != '-' && directory == nullptr)
+        {
+            directory = argv[i];
+        }
+        else
+        {
+            usage(argv[0]);
+        }
+    }
+    if(directory == nullptr || runs < 1)
+    {
+        usage(argv[0]);
+    }
+
+    std::vector<struct Frame> frames;
+    list_frames(directory, -1, frames);
+    list_frames(std::string(directory) + "/person", 1, frames);
+    list_frames(std::string(directory) + "/no_person", 0, frames);
+    std::sort(frames.begin(), frames.end(), [](const struct Frame& a, const struct Frame& b) { return a.path < b.path; });
+    if(frames.empty())
+    {
+        fprintf(stderr, "No JPEG frames in %s\n", directory);
+        return 1;
+    }
+
+    //Same set up as setup_interpreter() of the sketch
+    static tflite::MicroErrorReporter micro_error_reporter;
+    tflite::ErrorReporter* error_reporter = &micro_error_reporter;
+    const tflite::Model* model = tflite::GetModel(g_person_detect_model_data);
+    if(model->version() != TFLITE_SCHEMA_VERSION)
+    {
+        fprintf(stderr, "Model provided is schema version %d not equal to supported version %d\n", (int)model->version(), TFLITE_SCHEMA_VERSION);
+        return 1;
+    }
+    static tflite::MicroMutableOpResolver<kResolverOps> micro_op_resolver;
+    micro_op_resolver.AddAveragePool2D();
+    micro_op_resolver.AddConv2D();
+    micro_op_resolver.AddDepthwiseConv2D();
+    micro_op_resolver.AddReshape();
+    micro_op_resolver.AddSoftmax();
+    micro_op_resolver.AddFullyConnected();
+    micro_op_resolver.AddMaxPool2D();
+    micro_op_resolver.AddAdd();
+    split_wrap_resolver(micro_op_resolver, resolver_ops, kResolverOps);
+    static tflite::MicroInterpreter interpreter(model, micro_op_resolver, tensor_arena, kTensorArenaSize, error_reporter);
+    if(interpreter.AllocateTensors() != kTfLiteOk)
+    {
+        fprintf(stderr, "AllocateTensors() failed, TENSOR_ARENA_SIZE (%d bytes) is too small\n", kTensorArenaSize);
+        return 1;
+    }
+    size_t arena_used_bytes = interpreter.arena_used_bytes();
+    TfLiteTensor* input = interpreter.input(0);
+    TfLiteTensor* output = interpreter.output(0);
+    input_lut_build(input_lut, input->params.scale, input->params.zero_point);
+#if OP_PROFILER_ENABLED
+    op_profiler_reset(&op_profile);
+#endif
+
+    std::vector<uint8_t> jpeg;
+    std::vector<double> decode_times;
+    std::vector<double> invoke_times;
+    int skipped = 0;
+    for(struct Frame& frame : frames)
+    {
+        if(!read_file(frame.path, jpeg))
+        {
+            fprintf(stderr, "Cannot read %s\n", frame.path.c_str());
+            frame.label = -2;
+            skipped++;
+            continue;
+        }
+        std::vector<double> frame_decode;
+        std::vector<double> frame_invoke;
+        for(int run = 0; run < runs; run++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            DecodeAndProcessImage(error_reporter, jpeg.data(), (int)jpeg.size(), kNumCols, kNumRows, input->data.int8, input_lut);
+            frame_decode.push_back(elapsed_us(start));
+            //The decoder crops whole MCUs from the center, the frame has to cover the model input
+            if(JpegDec.width < kNumCols || JpegDec.height < kNumRows)
+            {
+                break;
+            }
+            start = std::chrono::steady_clock::now();
+            if(op_profiler_invoke(&interpreter) != kTfLiteOk)
+            {
+                fprintf(stderr, "Invoke() failed on %s\n", frame.path.c_str());
+                return 1;
+            }
+            frame_invoke.push_back(elapsed_us(start));
+        }
+        if(frame_invoke.empty())
+        {
+            fprintf(stderr, "Skipped %s (%dx%d, the model takes %dx%d)\n", frame.path.c_str(), JpegDec.width, JpegDec.height, kNumCols, kNumRows);
+            frame.label = -2;
+            skipped++;
+            continue;
+        }
+        frame.score = score_dequantize(output->data.int8[kPersonIndex], output->params.scale, output->params.zero_point);
+        frame.person = frame.score >= threshold;
+        decode_times.insert(decode_times.end(), frame_decode.begin(), frame_decode.end());
+        invoke_times.insert(invoke_times.end(), frame_invoke.begin(), frame_invoke.end());
+        std::sort(frame_decode.begin(), frame_decode.end());
+        std::sort(frame_invoke.begin(), frame_invoke.end());
+        frame.decode_us = percentile(frame_decode, 50);
+        frame.invoke_us = percentile(frame_invoke, 50);
+    }
+
+    printf("%d frames (%d skipped), %d runs each\n", (int)frames.size() - skipped, skipped, runs);
+    printf("Arena: %d of %d bytes used (%d bytes headroom)\n", (int)arena_used_bytes, kTensorArenaSize, kTensorArenaSize - (int)arena_used_bytes);
+    print_latency("decode", decode_times);
+    print_latency("invoke", invoke_times);
+#if OP_PROFILER_ENABLED
+    printf("The operator profiler is enabled, inference times include its overhead\n");
+#endif
+
+    //Confusion matrix of the labelled frames
+    int true_positives = 0, false_positives = 0, true_negatives = 0, false_negatives = 0;
+    for(const struct Frame& frame : frames)
+    {
+        if(frame.label == 1)
+        {
+            frame.person ? true_positives++ : false_negatives++;
+        }
+        else if(frame.label == 0)
+        {
+            frame.person ? false_positives++ : true_negatives++;
+        }
+    }
+    int labelled = true_positives + false_positives + true_negatives + false_negatives;
+    if(labelled > 0)
+    {
+        int positives = true_positives + false_negatives;
+        int negatives = true_negatives + false_positives;
+        printf("Accuracy %.1f%% of %d labelled frames (threshold %.2f), recall %.1f%% of %d, false positive rate %.1f%% of %d\n",
+               100.0 * (true_positives + true_negatives) / labelled, labelled, threshold,
+               positives ? 100.0 * true_positives / positives : 0.0, positives, negatives ? 100.0 * false_positives / negatives : 0.0, negatives);
+    }
+
+    if(csv_path != nullptr)
+    {
+        FILE* csv = fopen(csv_path, "w");
+        if(csv == nullptr)
+        {
+            fprintf(stderr, "Cannot write %s\n", csv_path);
+            return 1;
+        }
+        fprintf(csv, "path,label,person_score,person,decode_us,invoke_us\n");
+        for(const struct Frame& frame : frames)
+        {
+            if(frame.label >= -1)
+            {
+                fprintf(csv, "%s,%d,%.4f,%d,%.0f,%.0f\n", frame.path.c_str(), frame.label, frame.score, frame.person, frame.decode_us, frame.invoke_us);
+            }
+        }
+        fclose(csv);
+        printf("Written %s\n", csv_path);
+    }
+
+#if OP_PROFILER_ENABLED
+    char line[OP_PROFILER_LINE_LENGTH];
+    for(int i = 0; op_profiler_csv_header(&op_profile, i, line, sizeof(line)) > 0; i++)
+    {
+        fputs(line, stdout);
+    }
+    for(int node = 0; op_profiler_csv_row(&op_profile, node, line, sizeof(line)) > 0; node++)
+    {
+        fputs(line, stdout);
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*
+This script implements the host version of the JPEGDecoder library (see JPEGDecoder.h) for the host benchmark. It follows decodeArray() and read() of the
+library: picojpeg decodes one MCU at a time, and its 8x8 blocks are copied into pImage as RGB565, grayscale frames with the same value in the three channels.
+*/
+#include "JPEGDecoder.h"
+#include <string.h>
+
+JPEGDecoder JpegDec;
+
+JPEGDecoder::JPEGDecoder()
+{
+    pImage = nullptr;
+    available = false;
+}
+
+JPEGDecoder::~JPEGDecoder()
+{
+    delete[] pImage;
+}
+
+//picojpeg reads the JPEG data through this callback
+unsigned char JPEGDecoder::need_bytes(unsigned char* buffer, unsigned char buffer_size, unsigned char* bytes_read, void* data)
+{
+    JPEGDecoder* decoder = (JPEGDecoder*)data;
+    uint32_t count = decoder->array_size - decoder->array_index;
+    if(count > buffer_size)
+    {
+        count = buffer_size;
+    }
+    memcpy(buffer, decoder->array + decoder->array_index, count);
+    decoder->array_index += count;
+    *bytes_read = (unsigned char)count;
+    return 0;
+}
+
+int JPEGDecoder::decodeArray(const uint8_t array[], uint32_t array_size)
+{
+    abort();
+    this->array = array;
+    this->array_size = array_size;
+    array_index = 0;
+    mcu_x = 0;
+    mcu_y = 0;
+    if(pjpeg_decode_init(&image_info, need_bytes, this, 0) != 0)
+    {
+        return 0;
+    }
+    width = image_info.m_width;
+    height = image_info.m_height;
+    comps = image_info.m_comps;
+    MCUSPerRow = image_info.m_MCUSPerRow;
+    MCUSPerCol = image_info.m_MCUSPerCol;
+    scanType = image_info.m_scanType;
+    MCUWidth = image_info.m_MCUWidth;
+    MCUHeight = image_info.m_MCUHeight;
+    row_pitch = MCUWidth;
+    pImage = new uint16_t[MCUWidth * MCUHeight];
+    memset(pImage, 0, MCUWidth * MCUHeight * sizeof(uint16_t));
+    available = true;
+    return decode_mcu();
+}
+
+int JPEGDecoder::decode_mcu()
+{
+    unsigned char status = pjpeg_decode_mcu();
+    if(status != 0)
+    {
+        available = false;
+        if(status != PJPG_NO_MORE_BLOCKS)
+        {
+            return -1;
+        }
+    }
+    return 1;
+}
+
+int JPEGDecoder::read()
+{
+    if(!available || mcu_y >= MCUSPerCol)
+    {
+        abort();
+        return 0;
+    }
+    uint16_t* row = pImage;
+    for(int y = 0; y < MCUHeight; y += 8)
+    {
+        int y_limit = height - (mcu_y * MCUHeight + y);
+        y_limit = y_limit < 8 ? y_limit : 8;
+        for(int x = 0; x < MCUWidth; x += 8)
+        {
+            int x_limit = width - (mcu_x * MCUWidth + x);
+            x_limit = x_limit < 8 ? x_limit : 8;
+            //Offset of the block in the MCU buffers of picojpeg
+            int offset = x * 8 + y * 16;
+            const uint8_t* r = image_info.m_pMCUBufR + offset;
+            const uint8_t* g = image_info.m_pMCUBufG + offset;
+            const uint8_t* b = image_info.m_pMCUBufB + offset;
+            uint16_t* block = row + x;
+            for(int by = 0; by < y_limit; by++)
+            {
+                for(int bx = 0; bx < x_limit; bx++)
+                {
+                    if(scanType == PJPG_GRAYSCALE)
+                    {
+                        block[bx] = (r[bx] & 0xF8) << 8 | (r[bx] & 0xFC) << 3 | r[bx] >> 3;
+                    }
+                    else
+                    {
+                        block[bx] = (r[bx] & 0xF8) << 8 | (g[bx] & 0xFC) << 3 | b[bx] >> 3;
+                    }
+                }
+                r += 8;
+                g += 8;
+                b += 8;
+                block += row_pitch;
+            }
+        }
+        row += row_pitch * 8;
+    }
+    MCUx = mcu_x;
+    MCUy = mcu_y;
+    if(++mcu_x == MCUSPerRow)
+    {
+        mcu_x = 0;
+        mcu_y++;
+    }
+    if(decode_mcu() == -1)
+    {
+        available = false;
+    }
+    return 1;
+}
+
+void JPEGDecoder::abort()
+{
+    delete[] pImage;
+    pImage = nullptr;
+    available = false;
+}
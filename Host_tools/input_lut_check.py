@@ -0,0 +1,108 @@
+"""
+This script checks the fused preprocessing of the natural_light sketch (see input_lut.cpp) against a float reference. input_lut.cpp is compiled on the host
+and, for every RGB565 color the JPEG decoder can produce, the integer luma and the 256-entry table built for an input quantization are compared with the float
+pipeline: luminance (0.2126 R + 0.7152 G + 0.0722 B), normalization to -1..1 ((luma - 127) / 127.5, the range the person model input covers) and
+quantization round(x / scale) + zero_point, saturated to int8.
+
+The quantization of the model input (read from the model) is checked, and the ones given with --params. The table maps the rounded luma, so a reference
+value between two luma levels may end up one step away when the input scale is finer than 2/255; the check fails if any value is further than
+--tolerance steps from the reference. The difference to the old conversion (luma - 128, truncated) is reported as well.
+Requires numpy and g++.
+
+Examples:
+    python input_lut_check.py
+    python input_lut_check.py --params 0.00784:0 0.0039:-128
+"""
+import argparse
+import ctypes
+import os
+import sys
+import tempfile
+
+import numpy as np
+
+from sketch_build import sketch_library
+from tflite_model import ModelInfo, load_model_bytes
+
+SKETCH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Arduino_examples", "natural_light")
+DEFAULT_MODEL = os.path.join(SKETCH, "person_detect_model_data.cpp")
+#INPUT_LUT_OFFSET and INPUT_LUT_RANGE in input_lut.h
+OFFSET = 127
+RANGE = 127.5
+
+WRAPPER = """
+#include "input_lut.h"
+extern "C" void check_luma(const uint16_t* colors, uint8_t* luma, int count)
+{
+    for(int i = 0; i < count; i++)
+    {
+        luma[i] = input_lut_luma(colors[i]);
+    }
+}
+extern "C" void check_build(int8_t* lut, float scale, int zero_point) { input_lut_build(lut, scale, zero_point); }
+"""
+
+
+def build_library(build_dir):
+    """Compiles input_lut.cpp of the sketch into a shared library and returns it loaded with ctypes."""
+    library = sketch_library(build_dir, SKETCH, ["input_lut.cpp"], WRAPPER)
+    library.check_build.argtypes = [ctypes.c_void_p, ctypes.c_float, ctypes.c_int]
+    return library
+
+
+def reference_luma(colors):
+    """Float luminance of RGB565 colors expanded as in DecodeAndProcessImage (r * 8, g * 4, b * 8)."""
+    r = ((colors >> 11) & 0x1F).astype(np.float32) * 8
+    g = ((colors >> 5) & 0x3F).astype(np.float32) * 4
+    b = (colors & 0x1F).astype(np.float32) * 8
+    return np.float32(0.2126) * r + np.float32(0.7152) * g + np.float32(0.0722) * b
+
+
+def quantize(values, scale, zero_point):
+    """TFLite quantization, rounding half away from zero."""
+    scaled = (values - np.float32(OFFSET)) / np.float32(RANGE) / np.float32(scale)
+    return np.clip(np.sign(scaled) * np.floor(np.abs(scaled) + 0.5) + zero_point, -128, 127).astype(np.int32)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--model", default=DEFAULT_MODEL, help=".tflite file or C array source of the model")
+    parser.add_argument("--params", nargs="*", default=["0.0078125:0", "0.00392156863:-128", "0.01:-10"], help="SCALE:ZERO_POINT")
+    parser.add_argument("--tolerance", type=int, default=1)
+    args = parser.parse_args()
+
+    model = ModelInfo(load_model_bytes(args.model))
+    tensor = model.tensors[model.inputs[0]]
+    params = [("model input", tensor.scale, tensor.zero_point)]
+    for spec in args.params:
+        scale, zero_point = spec.split(":")
+        params.append((spec, float(scale), int(zero_point)))
+
+    colors = np.arange(65536, dtype=np.uint16)
+    reference = reference_luma(colors)
+    ok = True
+    with tempfile.TemporaryDirectory() as build_dir:
+        library = build_library(build_dir)
+        luma = np.zeros(65536, np.uint8)
+        library.check_luma(colors.ctypes.data_as(ctypes.c_void_p), luma.ctypes.data_as(ctypes.c_void_p), len(colors))
+        luma_error = np.abs(luma.astype(np.float32) - reference)
+        print("Integer luma: max {:.3f} from the float luminance, {:.2%} not the nearest level".format(
+            luma_error.max(), np.mean(luma != np.floor(reference + 0.5))))
+        old = np.trunc(reference - 128).astype(np.int32)
+        print("{:>16} {:>10} {:>6} {:>9} {:>9} {:>10}".format("input", "scale", "zp", "exact", "max err", "old max"))
+        for name, scale, zero_point in params:
+            lut = np.zeros(256, np.int8)
+            library.check_build(lut.ctypes.data_as(ctypes.c_void_p), scale, zero_point)
+            fused = lut[luma].astype(np.int32)
+            expected = quantize(reference, scale, zero_point)
+            error = np.abs(fused - expected)
+            ok &= int(error.max()) <= args.tolerance
+            #The old conversion only matches the person model quantization
+            old_error = "{}".format(int(np.abs(old - expected).max())) if name == "model input" else "-"
+            print("{:>16} {:>10.6f} {:>6} {:>9.2%} {:>9} {:>10}".format(name, scale, zero_point, np.mean(error == 0), int(error.max()), old_error))
+    print("OK" if ok else "FAILED: more than {} steps from the float reference".format(args.tolerance))
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,117 @@
+"""
+This script tests the measured offload latency of the natural_light sketch (latency_model.cpp, compiled on the host) with a simulated transport that injects
+latency. Every simulated offload cycle takes the connection setup, the image transfer (--bytes at --throughput) and the gateway inference, with a slow cycle
+(--spike-ms, for example a reconnection) every now and then. The durations are recorded as send_image does, and before every cycle the deadline check of
+the scheduler is evaluated with the percentile the sketch uses (LATENCY_PERCENTILE) and with the constant execution time of F_image.
+
+The percentile of the sketch is checked against a nearest-rank percentile of the last LATENCY_WINDOW cycles computed here, and the fallback to the constant
+before the first cycle is checked as well. It reports how often each estimate admitted an offload that then took longer than estimated.
+Requires g++.
+
+Examples:
+    python latency_sim.py
+    python latency_sim.py --cycles 500 --gateway-ms 1500 --spike-ms 12000 --spike-rate 0.1
+"""
+import argparse
+import ctypes
+import math
+import os
+import random
+import sys
+import tempfile
+
+from sketch_build import sketch_library
+
+SKETCH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Arduino_examples", "natural_light")
+#Must be the same as in latency_model.h
+LATENCY_WINDOW = 16
+LATENCY_PERCENTILE = 90
+#execution_time of F_image in application.cpp, the fallback until the first cycle was measured
+OFFLOAD_MS = 8660
+
+WRAPPER = """
+#include "latency_model.h"
+static struct LatencyModel model;
+extern "C" void sim_reset() { latency_reset(&model); }
+extern "C" void sim_record(unsigned long sample) { latency_record(&model, sample); }
+extern "C" unsigned long sim_percentile(int percentile, unsigned long fallback) { return latency_percentile(&model, percentile, fallback); }
+extern "C" unsigned int sim_count() { return model.count; }
+"""
+
+
+def build_library(build_dir):
+    """Compiles latency_model.cpp of the sketch into a shared library and returns it loaded with ctypes."""
+    library = sketch_library(build_dir, SKETCH, ["latency_model.cpp"], WRAPPER)
+    library.sim_record.argtypes = [ctypes.c_ulong]
+    library.sim_percentile.argtypes = [ctypes.c_int, ctypes.c_ulong]
+    library.sim_percentile.restype = ctypes.c_ulong
+    return library
+
+
+def nearest_rank(samples, percentile):
+    ordered = sorted(samples)
+    rank = max(1, math.ceil(percentile * len(ordered) / 100))
+    return ordered[rank - 1]
+
+
+def simulated_cycle(rng, args):
+    """Duration in ms of one offload cycle over the simulated transport."""
+    connect = rng.uniform(args.connect_ms[0], args.connect_ms[1])
+    transfer = args.bytes * 1000 / args.throughput
+    gateway = rng.lognormvariate(math.log(args.gateway_ms), 0.3)
+    spike = args.spike_ms if rng.random() < args.spike_rate else 0
+    return int(connect + transfer + gateway + spike)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--cycles", type=int, default=200)
+    parser.add_argument("--connect-ms", type=int, nargs=2, default=[400, 2500], help="range of the connection setup")
+    parser.add_argument("--bytes", type=int, default=3080, help="bytes sent per cycle")
+    parser.add_argument("--throughput", type=float, default=1000, help="bytes per second of the transfer")
+    parser.add_argument("--gateway-ms", type=float, default=800, help="median gateway inference and result latency")
+    parser.add_argument("--spike-ms", type=int, default=6000, help="extra latency of a slow cycle")
+    parser.add_argument("--spike-rate", type=float, default=0.05, help="share of slow cycles")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    ok = True
+    with tempfile.TemporaryDirectory() as build_dir:
+        library = build_library(build_dir)
+        library.sim_reset()
+        fallback = library.sim_percentile(LATENCY_PERCENTILE, OFFLOAD_MS)
+        print("Fallback before the first cycle: {} ms ({})".format(fallback, "ok" if fallback == OFFLOAD_MS else "FAIL"))
+        ok &= fallback == OFFLOAD_MS
+
+        samples = []
+        mismatches = 0
+        missed = {"measured": 0, "constant": 0}
+        for _ in range(args.cycles):
+            estimate = library.sim_percentile(LATENCY_PERCENTILE, OFFLOAD_MS)
+            if samples and estimate != nearest_rank(samples[-LATENCY_WINDOW:], LATENCY_PERCENTILE):
+                mismatches += 1
+            duration = simulated_cycle(rng, args)
+            missed["measured"] += duration > estimate
+            missed["constant"] += duration > OFFLOAD_MS
+            library.sim_record(duration)
+            samples.append(duration)
+        window_ok = library.sim_count() == min(args.cycles, LATENCY_WINDOW)
+        print("Percentile of the sketch equal to the reference in {} of {} cycles, window {} samples ({})".format(
+            args.cycles - 1 - mismatches, args.cycles - 1, library.sim_count(), "ok" if mismatches == 0 and window_ok else "FAIL"))
+        ok &= mismatches == 0 and window_ok
+        for percentile in (0, 50, 100, 150):
+            expected = nearest_rank(samples[-LATENCY_WINDOW:], min(max(percentile, 0), 100))
+            value = library.sim_percentile(percentile, OFFLOAD_MS)
+            ok &= value == expected
+            print("  p{}: {} ms ({})".format(percentile, value, "ok" if value == expected else "FAIL, expected {}".format(expected)))
+
+    print("Cycles longer than the estimate: p{} of the measured latency {:.0%}, constant {} ms {:.0%}".format(
+        LATENCY_PERCENTILE, missed["measured"] / args.cycles, OFFLOAD_MS, missed["constant"] / args.cycles))
+    print("Simulated latency: median {} ms, p{} {} ms, max {} ms".format(nearest_rank(samples, 50), LATENCY_PERCENTILE,
+                                                                       nearest_rank(samples, LATENCY_PERCENTILE), max(samples)))
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,272 @@
+"""
+This script builds the model store of the natural_light sketch (see model_store.cpp), a flash region with cheaper variants of the person model that the
+scheduler switches to when the capacitor voltage is below MODEL_STORE_FULL_MODEL_VOLTAGE (above it the compiled-in person model runs, so it is not stored).
+Every model gets an entry with its version, the tensor arena it needs (estimated as in arena_report.py, or given), its input shape and the operators it uses.
+The models are listed from the most accurate variant to the cheapest one, each with the lowest voltage at which it is selected (below
+MODEL_STORE_FULL_MODEL_VOLTAGE, otherwise it would never be).
+
+The store is written as a binary image and, with --hex, as an Intel HEX file at MODEL_STORE_ADDRESS, which can be flashed next to the sketch with the
+programmer of the board (for example nrfjprog --program store.hex --sectorerase). The check command compiles the loader of the sketch on the host and runs it
+on a store image: it verifies that the store opens, that every entry is loadable with the op resolver of the sketch, which model is selected for a range
+of voltages, and that a corrupted image is rejected.
+
+The region is MODEL_STORE_SIZE (320 KB) from MODEL_STORE_ADDRESS. The sketch has to end below MODEL_STORE_ADDRESS: with --sketch, build and check read the
+compiled sketch (the .elf or .bin of arduino-cli compile --output-dir) and fail if its flash image reaches into the store.
+Requires g++ for the check command.
+
+Examples:
+    python model_store.py build store.bin person_small.tflite:small:3960:1 person_tiny.tflite:tiny:0:1 --hex store.hex --sketch build/natural_light.ino.elf
+    python model_store.py list store.bin
+    python model_store.py check store.bin
+"""
+import argparse
+import ctypes
+import os
+import struct
+import sys
+import tempfile
+import zlib
+
+from arena_report import align, estimate_persistent, plan_activations
+from sketch_build import sketch_library
+from tflite_model import BUILTIN_OPERATORS, ModelInfo, load_model_bytes
+
+SKETCH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Arduino_examples", "natural_light")
+#Must be the same as in model_store.h
+MODEL_STORE_SKETCH_ADDRESS = 0x00010000
+MODEL_STORE_ADDRESS = 0x000A0000
+MODEL_STORE_SIZE = 0x00050000
+MODEL_STORE_FULL_MODEL_VOLTAGE = 4100
+MODEL_STORE_MAGIC = 0x3153544D
+MODEL_STORE_FORMAT = 1
+MODEL_STORE_MAX_MODELS = 8
+MODEL_STORE_MAX_OPS = 16
+MODEL_STORE_ALIGNMENT = 16
+HEADER_FORMAT = "<IHHII"
+ENTRY_FORMAT = "<16sIIHHIHHHHBB16s6x"
+HEADER_LENGTH = struct.calcsize(HEADER_FORMAT)
+ENTRY_LENGTH = struct.calcsize(ENTRY_FORMAT)
+#resolver_ops of the sketch, kTensorArenaSize and the model input (kNumRows, kNumCols, kNumChannels)
+RESOLVER_OPS = [1, 3, 4, 22, 25, 9, 17, 0]
+ARENA_SIZE = 136 * 1024
+INPUT_SHAPE = (96, 96, 1)
+ARENA_MARGIN = 10
+
+WRAPPER = """
+#include "model_store.h"
+static struct ModelStore store;
+extern "C" int check_open(const uint8_t* base, uint32_t size) { return model_store_open(&store, base, size); }
+extern "C" long check_offset(int index) { const uint8_t* data = model_store_data(&store, index); return data ? (long)(data - store.base) : -1; }
+extern "C" int check_compatible(int index, const uint8_t* ops, int op_count, uint32_t arena, int height, int width, int channels)
+{
+    return model_store_compatible(&store.entries[index], ops, op_count, arena, height, width, channels);
+}
+extern "C" int check_select(int voltage, const uint8_t* ops, int op_count, uint32_t arena, int height, int width, int channels)
+{
+    return model_store_select(&store, voltage, ops, op_count, arena, height, width, channels);
+}
+"""
+
+
+def parse_spec(spec):
+    """PATH[:NAME[:MIN_VOLTAGE[:VERSION[:ARENA]]]]"""
+    parts = spec.split(":")
+    path = parts[0]
+    name = parts[1] if len(parts) > 1 and parts[1] else os.path.splitext(os.path.basename(path))[0]
+    min_voltage = int(parts[2]) if len(parts) > 2 and parts[2] else 0
+    version = int(parts[3]) if len(parts) > 3 and parts[3] else 1
+    arena = int(parts[4]) if len(parts) > 4 and parts[4] else None
+    return path, name, min_voltage, version, arena
+
+
+def make_entry(data, name, min_voltage, version, arena, offset):
+    model = ModelInfo(data)
+    if arena is None:
+        _, planned = plan_activations(model)
+        arena = align((planned + estimate_persistent(model)) * (100 + ARENA_MARGIN) // 100)
+    codes = sorted(set(op.builtin_code for op in model.operators))
+    if len(codes) > MODEL_STORE_MAX_OPS or max(codes) > 255:
+        raise ValueError("{}: too many or unsupported operators {}".format(name, codes))
+    tensor = model.tensors[model.inputs[0]]
+    shape = list(tensor.shape[1:]) + [1] * (3 - len(tensor.shape[1:]))
+    return struct.pack(ENTRY_FORMAT, name.encode()[:16], offset, len(data), version, model.version, arena, min_voltage,
+                       shape[0], shape[1], shape[2], tensor.type_id, len(codes), bytes(codes))
+
+
+def build(specs):
+    """Returns the store image for [(path, name, min_voltage, version, arena)]."""
+    if len(specs) > MODEL_STORE_MAX_MODELS:
+        raise ValueError("at most {} models".format(MODEL_STORE_MAX_MODELS))
+    offset = HEADER_LENGTH + MODEL_STORE_MAX_MODELS * ENTRY_LENGTH
+    entries, blobs = b"", b""
+    for path, name, min_voltage, version, arena in specs:
+        data = load_model_bytes(path)
+        padding = (-offset) % MODEL_STORE_ALIGNMENT
+        blobs += b"\0" * padding
+        offset += padding
+        entries += make_entry(data, name, min_voltage, version, arena, offset)
+        blobs += data
+        offset += len(data)
+    body = entries.ljust(MODEL_STORE_MAX_MODELS * ENTRY_LENGTH, b"\0") + blobs
+    header = struct.pack(HEADER_FORMAT, MODEL_STORE_MAGIC, MODEL_STORE_FORMAT, len(specs), HEADER_LENGTH + len(body), zlib.crc32(body))
+    return header + body
+
+
+def parse(image):
+    """Returns [dict] of the entries of a store image (without checking it, see check)."""
+    magic, store_format, count, length, crc = struct.unpack_from(HEADER_FORMAT, image, 0)
+    if magic != MODEL_STORE_MAGIC:
+        raise ValueError("not a model store")
+    entries = []
+    for i in range(count):
+        (name, offset, length, version, schema, arena, min_voltage, height, width, channels, input_type, op_count,
+         ops) = struct.unpack_from(ENTRY_FORMAT, image, HEADER_LENGTH + i * ENTRY_LENGTH)
+        entries.append({"name": name.rstrip(b"\0").decode(), "offset": offset, "length": length, "version": version, "schema": schema,
+                        "arena": arena, "min_voltage": min_voltage, "input": (height, width, channels), "input_type": input_type,
+                        "ops": list(ops[:op_count])})
+    return entries
+
+
+def write_hex(image, path, address):
+    """Intel HEX with extended linear address records."""
+    lines = []
+    upper = None
+    for start in range(0, len(image), 16):
+        absolute = address + start
+        if absolute >> 16 != upper:
+            upper = absolute >> 16
+            record = struct.pack(">BHBH", 2, 0, 4, upper)
+            lines.append(":" + record.hex().upper() + "{:02X}".format(-sum(record) & 0xFF))
+        chunk = image[start:start + 16]
+        record = struct.pack(">BHB", len(chunk), absolute & 0xFFFF, 0) + chunk
+        lines.append(":" + record.hex().upper() + "{:02X}".format(-sum(record) & 0xFF))
+    lines.append(":00000001FF")
+    with open(path, "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+def sketch_end(path):
+    """End address of the flash image of the compiled sketch: the highest load address of the ELF segments (the initial values of .data
+    included), or the start of the sketch plus the size of a .bin."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:4] != b"\x7fELF":
+        return MODEL_STORE_SKETCH_ADDRESS + len(data)
+    #32-bit little endian ELF of the Cortex-M4: program headers with type, offset, virtual address, load address, size in the file
+    phoff, = struct.unpack_from("<I", data, 28)
+    phentsize, phnum = struct.unpack_from("<HH", data, 42)
+    end = 0
+    for i in range(phnum):
+        segment_type, _, _, load_address, file_size = struct.unpack_from("<IIIII", data, phoff + i * phentsize)
+        if segment_type == 1 and file_size:
+            end = max(end, load_address + file_size)
+    return end
+
+
+def check_sketch(path):
+    """Returns True if the compiled sketch ends below the store."""
+    end = sketch_end(path)
+    fits = end <= MODEL_STORE_ADDRESS
+    print("Sketch ends at 0x{:08X}, {} B {} the model store at 0x{:08X}".format(
+        end, abs(MODEL_STORE_ADDRESS - end), "below" if fits else "INSIDE", MODEL_STORE_ADDRESS))
+    return fits
+
+
+def build_loader(build_dir):
+    """Compiles model_store.cpp of the sketch into a shared library and returns it loaded with ctypes."""
+    loader = sketch_library(build_dir, SKETCH, ["model_store.cpp"], WRAPPER)
+    loader.check_offset.restype = ctypes.c_long
+    return loader
+
+
+def check(image):
+    """Runs the loader of the sketch on the image, returns True if everything matches the builder."""
+    ok = True
+    entries = parse(image)
+    ops = (ctypes.c_uint8 * len(RESOLVER_OPS))(*RESOLVER_OPS)
+    with tempfile.TemporaryDirectory() as build_dir:
+        loader = build_loader(build_dir)
+        flash = (ctypes.c_uint8 * MODEL_STORE_SIZE).from_buffer_copy(image.ljust(MODEL_STORE_SIZE, b"\xff"))
+        count = loader.check_open(flash, MODEL_STORE_SIZE)
+        print("Store opened: {} models".format(count))
+        ok &= count == len(entries)
+        for i, entry in enumerate(entries):
+            offset = loader.check_offset(i)
+            blob = image[offset:offset + entry["length"]]
+            model = ModelInfo(blob)
+            compatible = loader.check_compatible(i, ops, len(RESOLVER_OPS), ARENA_SIZE, *INPUT_SHAPE)
+            print("  {}: {} offset {} {} B, loadable: {}".format(i, entry["name"], offset, entry["length"], "yes" if compatible else "no"))
+            ok &= offset == entry["offset"] and model.version == entry["schema"]
+        for voltage in range(3600, 4300, 100):
+            selected = loader.check_select(voltage, ops, len(RESOLVER_OPS), ARENA_SIZE, *INPUT_SHAPE)
+            print("  {} mV -> {}".format(voltage, entries[selected]["name"] if selected >= 0 else "compiled-in model"))
+            #With enough energy the compiled-in model runs, whatever the store holds
+            ok &= selected < 0 or voltage < MODEL_STORE_FULL_MODEL_VOLTAGE
+        #A flipped bit anywhere after the header has to be caught by the CRC
+        corrupted = bytearray(image)
+        corrupted[len(image) // 2] ^= 0x01
+        flash = (ctypes.c_uint8 * MODEL_STORE_SIZE).from_buffer_copy(bytes(corrupted).ljust(MODEL_STORE_SIZE, b"\xff"))
+        rejected = loader.check_open(flash, MODEL_STORE_SIZE) < 0
+        print("Corrupted store rejected: {}".format("yes" if rejected else "no"))
+        flash = (ctypes.c_uint8 * MODEL_STORE_SIZE).from_buffer_copy(b"\xff" * MODEL_STORE_SIZE)
+        erased = loader.check_open(flash, MODEL_STORE_SIZE) < 0
+        print("Erased flash rejected: {}".format("yes" if erased else "no"))
+        #An entry pointing past the end of the store (with a valid CRC) must not wrap the remaining length around
+        outside = bytearray(image)
+        struct.pack_into("<I", outside, HEADER_LENGTH + 16, (len(image) + MODEL_STORE_ALIGNMENT) // MODEL_STORE_ALIGNMENT * MODEL_STORE_ALIGNMENT)
+        struct.pack_into("<I", outside, 12, zlib.crc32(bytes(outside[HEADER_LENGTH:])))
+        flash = (ctypes.c_uint8 * MODEL_STORE_SIZE).from_buffer_copy(bytes(outside).ljust(MODEL_STORE_SIZE, b"\xff"))
+        outside_rejected = loader.check_open(flash, MODEL_STORE_SIZE) < 0
+        print("Entry outside the store rejected: {}".format("yes" if outside_rejected else "no"))
+        ok &= rejected and erased and outside_rejected
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest="command", required=True)
+    build_parser = commands.add_parser("build", help="build a store image")
+    build_parser.add_argument("store", help="output binary image")
+    build_parser.add_argument("models", nargs="+", help="PATH[:NAME[:MIN_VOLTAGE[:VERSION[:ARENA]]]], most accurate first (.tflite or C array source)")
+    build_parser.add_argument("--hex", help="also write an Intel HEX file")
+    build_parser.add_argument("--address", type=lambda value: int(value, 0), default=MODEL_STORE_ADDRESS)
+    build_parser.add_argument("--sketch", help="compiled sketch (.elf or .bin) that has to end below the store")
+    list_parser = commands.add_parser("list", help="print the entries of a store image")
+    list_parser.add_argument("store")
+    check_parser = commands.add_parser("check", help="run the loader of the sketch on a store image")
+    check_parser.add_argument("store")
+    check_parser.add_argument("--sketch", help="compiled sketch (.elf or .bin) that has to end below the store")
+    args = parser.parse_args()
+
+    if getattr(args, "sketch", None) and not check_sketch(args.sketch):
+        sys.exit(1)
+    if args.command == "build":
+        specs = [parse_spec(spec) for spec in args.models]
+        for _, name, min_voltage, _, _ in specs:
+            if min_voltage >= MODEL_STORE_FULL_MODEL_VOLTAGE:
+                parser.error("{} from {} mV would never be selected, the compiled-in model runs from {} mV".format(
+                    name, min_voltage, MODEL_STORE_FULL_MODEL_VOLTAGE))
+        image = build(specs)
+        if len(image) > MODEL_STORE_SIZE:
+            parser.error("store of {} B does not fit into {} B".format(
+                len(image), MODEL_STORE_SIZE))
+        with open(args.store, "wb") as f:
+            f.write(image)
+        print("Written {} ({} B of {} B)".format(args.store, len(image), MODEL_STORE_SIZE))
+        if args.hex:
+            write_hex(image, args.hex, args.address)
+            print("Written {} at 0x{:08X}".format(args.hex, args.address))
+        return
+    with open(args.store, "rb") as f:
+        image = f.read()
+    if args.command == "list":
+        for i, entry in enumerate(parse(image)):
+            print("{}: {} v{} (schema {}), {} B, arena {} B, input {}, from {} mV, ops {}".format(
+                i, entry["name"], entry["version"], entry["schema"], entry["length"], entry["arena"], "x".join(str(v) for v in entry["input"]),
+                entry["min_voltage"], ", ".join(BUILTIN_OPERATORS.get(op, str(op)) for op in entry["ops"])))
+    else:
+        sys.exit(0 if check(image) else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,113 @@
+"""
+This script reads the operator table of the profiling mode of the natural_light sketch (OP_PROFILER_ENABLED in op_profiler.h) and shows where the inference
+time goes. The table is the CSV the board writes to Serial (capture it with any serial terminal) or a host build writes to stdout; when the capture holds
+several tables, the last complete one is used. Every node is matched with the operator of the model (which has to be the model that was profiled) to add its
+output shape and multiply-accumulate operations, so the time per MAC points at the kernels worth optimizing.
+
+The report lists the nodes sorted by their share of the inference time, then the totals per operator type. With --csv the joined table is written as CSV.
+Requires numpy (for the model parser of split_model.py).
+
+Examples:
+    python op_profile_report.py serial_capture.txt
+    python op_profile_report.py serial_capture.txt --csv op_profile.csv --top 10
+"""
+import argparse
+import csv
+import os
+import sys
+
+from split_model import ReferenceModel
+
+DEFAULT_MODEL = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Arduino_examples", "natural_light", "person_detect_model_data.cpp")
+#Columns of the table (see op_profiler.h)
+COLUMNS = ["node", "op", "name", "invocations", "total", "min", "max"]
+
+
+def parse_capture(lines):
+    """Returns (unit, ticks per second, runs, [row dict]) of the last complete table in a capture."""
+    table = None
+    last = None
+    for line in lines:
+        line = line.strip()
+        if line.startswith("#op_profile,"):
+            if table is not None and table[3]:
+                last = table
+            _, unit, rate, runs = line.split(",")[:4]
+            table = (unit, int(rate), int(runs), [])
+        elif table is not None and line and line != ",".join(COLUMNS):
+            fields = line.split(",")
+            if len(fields) != len(COLUMNS):
+                continue
+            row = dict(zip(COLUMNS, fields))
+            for key in COLUMNS:
+                if key != "name":
+                    row[key] = int(row[key])
+            table[3].append(row)
+    if table is not None and table[3]:
+        last = table
+    return last
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("capture", nargs="?", help="serial capture or host output with the table (stdin if omitted)")
+    parser.add_argument("--model", default=DEFAULT_MODEL, help=".tflite file or C array source of the profiled model")
+    parser.add_argument("--top", type=int, help="only print the nodes with the largest share")
+    parser.add_argument("--csv", help="write the joined table as CSV")
+    args = parser.parse_args()
+
+    if args.capture:
+        with open(args.capture, errors="replace") as f:
+            table = parse_capture(f)
+    else:
+        table = parse_capture(sys.stdin)
+    if table is None:
+        parser.error("no operator table found")
+    unit, rate, runs, rows = table
+    model = ReferenceModel(args.model)
+
+    joined = []
+    for row in rows:
+        mean = row["total"] / row["invocations"] if row["invocations"] else 0
+        entry = dict(row, mean=mean, mean_us=mean * 1e6 / rate, shape="", macs=0)
+        if row["node"] < len(model.operators):
+            op = model.operators[row["node"]]
+            if op.name != row["name"]:
+                print("Node {} is {} in the table but {} in the model, was another model profiled?".format(row["node"], row["name"], op.name))
+            entry["shape"] = "x".join(str(v) for v in model.tensors[op.outputs[0]].shape)
+            entry["macs"] = model.macs(op)
+        entry["per_mac"] = mean / entry["macs"] if entry["macs"] else 0
+        joined.append(entry)
+    total = sum(entry["mean"] for entry in joined)
+    for entry in joined:
+        entry["share"] = entry["mean"] / total if total else 0
+
+    print("{} nodes, {} runs, {:.1f} ms per inference ({})".format(len(joined), runs, total * 1000 / rate, unit))
+    print("{:>4} {:>18} {:>14} {:>10} {:>10} {:>8} {:>10} {:>12}".format("node", "operator", "output", "MACs", "mean us", "share",
+                                                                         "max us", unit + "/MAC"))
+    ordered = sorted(joined, key=lambda entry: entry["mean"], reverse=True)
+    for entry in ordered[:args.top] if args.top else ordered:
+        print("{:>4} {:>18} {:>14} {:>10} {:>10.0f} {:>8.1%} {:>10.0f} {:>12.3f}".format(
+            entry["node"], entry["name"], entry["shape"], entry["macs"], entry["mean_us"], entry["share"], entry["max"] * 1e6 / rate,
+            entry["per_mac"]))
+
+    print("{:>18} {:>6} {:>10} {:>8} {:>12}".format("operator", "nodes", "ms", "share", unit + "/MAC"))
+    names = sorted(set(entry["name"] for entry in joined), key=lambda name: -sum(e["mean"] for e in joined if e["name"] == name))
+    for name in names:
+        group = [entry for entry in joined if entry["name"] == name]
+        ticks = sum(entry["mean"] for entry in group)
+        macs = sum(entry["macs"] for entry in group)
+        print("{:>18} {:>6} {:>10.1f} {:>8.1%} {:>12.3f}".format(name, len(group), ticks * 1000 / rate, ticks / total if total else 0,
+                                                                ticks / macs if macs else 0))
+
+    if args.csv:
+        fields = ["node", "op", "name", "shape", "macs", "invocations", "mean", "mean_us", "min", "max", "share", "per_mac"]
+        with open(args.csv, "w", newline="") as f:
+            writer = csv.DictWriter(f, fieldnames=fields, extrasaction="ignore")
+            writer.writeheader()
+            writer.writerows(joined)
+        print("Written {}".format(args.csv))
+
+
+if __name__ == "__main__":
+    main()
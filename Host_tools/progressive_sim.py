@@ -0,0 +1,133 @@
+"""
+This script simulates the progressive offload of the natural_light sketch on a set of camera frames. As on the device, every frame is cropped to the 96x96 model
+input and encoded by the encoder of the sketch (jpeg_encoder.cpp, compiled on the host) into the thumbnail and the smaller preview. The gateway policy of
+vjezba.py is applied to the preview: a score inside the refinement band is not decided on, and the thumbnail (or the camera JPEG if the thumbnail is not smaller)
+is sent as well. For every band it reports the share of frames that needed a refinement, the average bytes sent per frame, the estimated offload latency and how
+often the decision is the same as the one on the full image, compared with always sending the thumbnail or the camera JPEG.
+
+The latency is estimated from the bytes sent (--throughput, transfer_bytes / transfer_ms in the telemetry of the board) and a fixed cost per round trip for the
+gateway inference and the result (--round-trip-ms). The gateway is the reference person detection model (split_model.py) on the upscaled image, or the gateway
+model of vjezba.py with --model.
+Requires g++, numpy and Pillow (OpenCV and TensorFlow only with --model).
+
+Examples:
+    python progressive_sim.py ../Gateway_examples/images
+    python progressive_sim.py ../Gateway_examples/images --bands 0.3:0.7 0.2:0.8 0.1:0.9 --preview-quality 20
+"""
+import argparse
+import ctypes
+import glob
+import io
+import os
+import tempfile
+
+import numpy as np
+from PIL import Image
+
+from split_model import ReferenceModel
+from thumbnail_benchmark import CROP, MAX_BYTES, GatewayModel, build_encoder, device_crop
+
+DEFAULT_MODEL = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Arduino_examples", "natural_light", "person_detect_model_data.cpp")
+#Defaults of application.h and vjezba.py
+THUMBNAIL_QUALITY = 50
+THUMBNAIL_SCALE = 1
+PREVIEW_QUALITY = 30
+PREVIEW_SCALE = 2
+REFINE_BAND = (0.3, 0.7)
+THRESHOLD = 0.5
+THROUGHPUT = 1000
+ROUND_TRIP_MS = 300
+
+
+class ReferenceGateway:
+    """Person score of the reference int8 model on an image scaled to the 96x96 model input."""
+
+    def __init__(self, path):
+        self.model = ReferenceModel(path)
+
+    def score(self, jpeg_bytes):
+        image = Image.open(io.BytesIO(jpeg_bytes)).convert("L").resize((CROP, CROP))
+        x = (np.asarray(image, np.int32) - 128).astype(np.int8).reshape(1, CROP, CROP, 1)
+        return self.model.person_probability(self.model.run(x))
+
+
+def encode_pair(encoder, crop, args):
+    """Returns (thumbnail, preview) encoded the same way as encode_thumbnail() and encode_preview() on the device."""
+    luma = (ctypes.c_int8 * (CROP * CROP))(*[pixel - 128 for pixel in crop.tobytes()])
+    out = (ctypes.c_uint8 * MAX_BYTES)()
+    encoder.bench_downscale(luma, CROP, CROP, args.thumbnail_scale)
+    size = CROP // args.thumbnail_scale
+    length = encoder.bench_encode(luma, size, size, args.thumbnail_quality, out, MAX_BYTES)
+    thumbnail = bytes(out[:length])
+    encoder.bench_downscale(luma, size, size, args.preview_scale // args.thumbnail_scale)
+    size = CROP // args.preview_scale
+    length = encoder.bench_encode(luma, size, size, args.preview_quality, out, MAX_BYTES)
+    return thumbnail, bytes(out[:length])
+
+
+def parse_band(text):
+    low, high = (float(value) for value in text.split(":"))
+    return low, high
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("images", help="directory with camera JPEG frames")
+    parser.add_argument("--bands", type=parse_band, nargs="+", default=[REFINE_BAND], help="refinement bands low:high of the gateway score")
+    parser.add_argument("--thumbnail-quality", type=int, default=THUMBNAIL_QUALITY)
+    parser.add_argument("--thumbnail-scale", type=int, default=THUMBNAIL_SCALE, choices=[1, 2])
+    parser.add_argument("--preview-quality", type=int, default=PREVIEW_QUALITY)
+    parser.add_argument("--preview-scale", type=int, default=PREVIEW_SCALE, choices=[2, 4])
+    parser.add_argument("--throughput", type=float, default=THROUGHPUT, help="transfer throughput in B/s")
+    parser.add_argument("--round-trip-ms", type=float, default=ROUND_TRIP_MS, help="gateway inference and result per image sent")
+    parser.add_argument("--person-model", default=DEFAULT_MODEL, help="reference gateway model (.tflite file or C array source)")
+    parser.add_argument("--model", help="gateway model of vjezba.py (facetracker.h5) instead of the reference model")
+    args = parser.parse_args()
+    if args.preview_scale <= args.thumbnail_scale:
+        parser.error("the preview has to be smaller than the thumbnail")
+
+    paths = sorted(glob.glob(os.path.join(args.images, "*.jpg")) + glob.glob(os.path.join(args.images, "*.jpeg")))
+    if not paths:
+        parser.error("no JPEG images in {}".format(args.images))
+    gateway = GatewayModel(args.model) if args.model else ReferenceGateway(args.person_model)
+
+    frames = []
+    with tempfile.TemporaryDirectory() as build_dir:
+        encoder = build_encoder(build_dir)
+        for path in paths:
+            with open(path, "rb") as f:
+                camera = f.read()
+            thumbnail, preview = encode_pair(encoder, device_crop(path), args)
+            #The device falls back to the camera JPEG if the thumbnail is not smaller
+            full = thumbnail if len(thumbnail) < len(camera) else camera
+            frames.append((camera, full, preview, gateway.score(camera), gateway.score(full), gateway.score(preview)))
+
+    def latency_ms(sizes):
+        return sum(size / args.throughput * 1000 + args.round_trip_ms for size in sizes)
+
+    count = len(frames)
+    print("{} frames, preview {}x{} q{}, thumbnail {}x{} q{}".format(count, CROP // args.preview_scale, CROP // args.preview_scale, args.preview_quality,
+                                                                      CROP // args.thumbnail_scale, CROP // args.thumbnail_scale, args.thumbnail_quality))
+    print("{:>16} {:>8} {:>10} {:>11} {:>7}".format("mode", "refined", "bytes", "latency ms", "agree"))
+    for name, index in (("camera JPEG", 0), ("thumbnail", 1)):
+        sizes = [len(frame[index]) for frame in frames]
+        agree = sum((frame[3 + index] > THRESHOLD) == (frame[3] > THRESHOLD) for frame in frames)
+        print("{:>16} {:>8} {:>10.0f} {:>11.0f} {:>7.1%}".format(name, "-", sum(sizes) / count, sum(latency_ms([size]) for size in sizes) / count, agree / count))
+    for low, high in args.bands:
+        refined = total_bytes = total_latency = agree = 0
+        for camera, full, preview, camera_score, full_score, preview_score in frames:
+            sizes = [len(preview)]
+            score = preview_score
+            if low < preview_score < high:
+                refined += 1
+                sizes.append(len(full))
+                score = full_score
+            total_bytes += sum(sizes)
+            total_latency += latency_ms(sizes)
+            agree += (score > THRESHOLD) == (camera_score > THRESHOLD)
+        print("{:>16} {:>8.0%} {:>10.0f} {:>11.0f} {:>7.1%}".format("band {:.2f}-{:.2f}".format(low, high), refined / count, total_bytes / count,
+                                                                    total_latency / count, agree / count))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,101 @@
+"""
+This script replays a recorded frame sequence through the result cache of the natural_light sketch (see result_cache.cpp). The cache of the sketch is compiled on
+the host, the frames are taken in file name order (for example the images saved by the gateway) and are assumed to be captured every --period ms. A frame that
+misses the cache is "offloaded": its result is the person score of the reference int8 model (split_model.py), which stands in for the gateway, and it is inserted
+into the cache. A hit reuses the cached score instead.
+
+It reports the hit rate, the false reuse rate (hits whose reused decision differs from the decision the frame itself would get) and the offload time saved
+(execution_time of F_image in application.cpp per hit). With --offload-mj the energy of one offload is given and the saved energy is reported as well.
+The cache settings are the ones in result_cache.h. Requires g++, numpy and Pillow.
+
+Examples:
+    python result_cache_sim.py ../Gateway_examples/images
+    python result_cache_sim.py ../Gateway_examples/images --period 30000 --offload-mj 95
+"""
+import argparse
+import ctypes
+import glob
+import os
+import tempfile
+
+from sketch_build import sketch_library
+from split_benchmark import device_input
+from split_model import ReferenceModel
+
+SKETCH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Arduino_examples", "natural_light")
+DEFAULT_MODEL = os.path.join(SKETCH, "person_detect_model_data.cpp")
+CROP = 96
+#Capture period at full charge and duration of F_image in application.cpp
+CAPTURE_PERIOD_MS = 10749
+OFFLOAD_MS = 8660
+#RESULT_PERSON_THRESHOLD in application.h, the scores are in per mille
+PERSON_THRESHOLD = 500
+
+WRAPPER = """
+#include "result_cache.h"
+static struct ResultCache cache;
+extern "C" void sim_reset() { result_cache_reset(&cache); }
+extern "C" unsigned long long sim_hash(const int8_t* luma, int width, int height) { return frame_hash(luma, width, height); }
+extern "C" int sim_lookup(unsigned long long hash, uint32_t now, uint16_t* score) { return result_cache_lookup(&cache, hash, now, score); }
+extern "C" void sim_insert(unsigned long long hash, uint16_t score, uint32_t now) { result_cache_insert(&cache, hash, score, now); }
+"""
+
+
+def build_cache(build_dir):
+    """Compiles result_cache.cpp of the sketch into a shared library and returns it loaded with ctypes."""
+    cache = sketch_library(build_dir, SKETCH, ["result_cache.cpp"], WRAPPER)
+    cache.sim_hash.restype = ctypes.c_ulonglong
+    cache.sim_hash.argtypes = [ctypes.POINTER(ctypes.c_int8), ctypes.c_int, ctypes.c_int]
+    cache.sim_lookup.argtypes = [ctypes.c_ulonglong, ctypes.c_uint32, ctypes.POINTER(ctypes.c_uint16)]
+    cache.sim_insert.argtypes = [ctypes.c_ulonglong, ctypes.c_uint16, ctypes.c_uint32]
+    return cache
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("images", help="directory with the recorded camera frames")
+    parser.add_argument("--model", default=DEFAULT_MODEL, help=".tflite file or C array source of the model")
+    parser.add_argument("--period", type=int, default=CAPTURE_PERIOD_MS, help="ms between two frames")
+    parser.add_argument("--offload-ms", type=int, default=OFFLOAD_MS)
+    parser.add_argument("--offload-mj", type=float, help="energy of one offload, to report the energy saved")
+    parser.add_argument("--verbose", action="store_true", help="print every frame")
+    args = parser.parse_args()
+
+    paths = sorted(path for pattern in ("*.jpg", "*.jpeg", "*.png") for path in glob.glob(os.path.join(args.images, pattern)))
+    if not paths:
+        parser.error("no images in {}".format(args.images))
+    model = ReferenceModel(args.model)
+
+    with tempfile.TemporaryDirectory() as build_dir:
+        cache = build_cache(build_dir)
+        cache.sim_reset()
+        hits = false_reuses = 0
+        for i, path in enumerate(paths):
+            frame = device_input(path)
+            own = int(round(model.person_probability(model.run(frame)) * 1000))
+            luma = (ctypes.c_int8 * (CROP * CROP)).from_buffer_copy(frame.tobytes())
+            frame_hash = cache.sim_hash(luma, CROP, CROP)
+            now = (i * args.period) & 0xFFFFFFFF
+            score = ctypes.c_uint16()
+            if cache.sim_lookup(frame_hash, now, ctypes.byref(score)):
+                hits += 1
+                wrong = (score.value >= PERSON_THRESHOLD) != (own >= PERSON_THRESHOLD)
+                false_reuses += wrong
+                if args.verbose:
+                    print("{} hit  reused {} own {}{}".format(os.path.basename(path), score.value, own, " FALSE" if wrong else ""))
+            else:
+                cache.sim_insert(frame_hash, own, now)
+                if args.verbose:
+                    print("{} miss score {}".format(os.path.basename(path), own))
+
+    frames = len(paths)
+    print("{} frames, {} ms apart".format(frames, args.period))
+    print("Hits: {} ({:.1%}), offloads: {}".format(hits, hits / frames, frames - hits))
+    print("False reuses: {} ({:.1%} of the hits, {:.1%} of the frames)".format(false_reuses, false_reuses / hits if hits else 0, false_reuses / frames))
+    print("Offload time saved: {:.1f} s".format(hits * args.offload_ms / 1000))
+    if args.offload_mj is not None:
+        print("Energy saved: {:.1f} mJ ({:.1%} of the offload energy)".format(hits * args.offload_mj, hits / frames))
+
+
+if __name__ == "__main__":
+    main()
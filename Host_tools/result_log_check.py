@@ -0,0 +1,230 @@
+"""
+This script tests the result log of local_inference_send (result_log.cpp, compiled on the host) against a reference model and the batch decoder of the
+gateway (decode_result_log in Gateway_examples/computer.py).
+
+The flush decision (result_log_should_flush) is checked at the limits of every condition: empty log, RESULT_LOG_FLUSH_COUNT entries, oldest entry
+RESULT_LOG_MAX_AGE ms old (also across the wrap-around of millis()) and RESULT_LOG_FLUSH_VOLTAGE. The ring (result_log_add) is filled past
+RESULT_LOG_CAPACITY several times, so the oldest entries are overwritten and counted as dropped, and random sequences of adds, partial batches and consumes
+are compared with the reference. Every batch is decoded by the gateway, with the entry times converted to the gateway clock.
+Requires g++ and Pillow (imported by computer.py, bleak is replaced by a stand-in).
+
+Examples:
+    python result_log_check.py
+    python result_log_check.py --operations 20000
+"""
+import argparse
+import ctypes
+import os
+import random
+import sys
+import tempfile
+from datetime import datetime, timedelta
+
+from advert_report_check import load_computer
+from sketch_build import sketch_library
+
+SKETCH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Arduino_examples", "local_inference_send")
+#Must be the same as in result_log.h
+RESULT_LOG_CAPACITY = 32
+RESULT_LOG_FLUSH_COUNT = 8
+RESULT_LOG_MAX_AGE = 300000
+RESULT_LOG_FLUSH_VOLTAGE = 4500
+RESULT_LOG_HEADER_LENGTH = 8
+RESULT_LOG_ENTRY_LENGTH = 9
+#RX_BUFFER_SIZE of application.cpp, the largest batch flush_result_log sends, a batch is also limited to the ATT MTU - 3 bytes
+RX_BUFFER_SIZE = 220
+DEFAULT_MTU = 23
+
+WRAPPER = """
+#include "result_log.h"
+static struct ResultLog log;
+extern "C" void check_reset() { result_log_reset(&log); }
+extern "C" void check_add(unsigned long time_ms, int person, int no_person, int voltage, int strategy)
+{
+    struct ResultEntry entry = {(uint32_t)time_ms, (int8_t)person, (int8_t)no_person, (uint16_t)voltage, (uint8_t)strategy};
+    result_log_add(&log, &entry);
+}
+extern "C" bool check_should_flush(unsigned long now, int voltage) { return result_log_should_flush(&log, now, voltage); }
+extern "C" int check_encode(uint8_t* out, int max_length, unsigned long now) { return result_log_encode(&log, out, max_length, now); }
+extern "C" void check_consume(int entries) { result_log_consume(&log, entries); }
+extern "C" int check_count() { return log.count; }
+extern "C" int check_head() { return log.head; }
+extern "C" int check_dropped() { return log.dropped; }
+"""
+
+
+def build_library(build_dir):
+    """Compiles result_log.cpp of the sketch into a shared library and returns it loaded with ctypes."""
+    library = sketch_library(build_dir, SKETCH, ["result_log.cpp"], WRAPPER)
+    library.check_add.argtypes = [ctypes.c_ulong, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int]
+    library.check_should_flush.argtypes = [ctypes.c_ulong, ctypes.c_int]
+    library.check_should_flush.restype = ctypes.c_bool
+    library.check_encode.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_ulong]
+    return library
+
+
+class ReferenceLog:
+    """What the log should hold: the newest RESULT_LOG_CAPACITY entries and the number of overwritten ones since the last delivered batch."""
+
+    def __init__(self):
+        self.entries = []
+        self.dropped = 0
+
+    def add(self, entry):
+        self.entries.append(entry)
+        if len(self.entries) > RESULT_LOG_CAPACITY:
+            self.entries.pop(0)
+            self.dropped += 1
+
+    def should_flush(self, now, voltage):
+        if not self.entries:
+            return False
+        return (len(self.entries) >= RESULT_LOG_FLUSH_COUNT or (now - self.entries[0][0]) & 0xFFFFFFFF >= RESULT_LOG_MAX_AGE or
+                voltage >= RESULT_LOG_FLUSH_VOLTAGE)
+
+    def consume(self, count):
+        del self.entries[:count]
+        self.dropped = 0
+
+
+class Log:
+    def __init__(self, library):
+        self.library = library
+        self.out = ctypes.create_string_buffer(1024)
+
+    def add(self, entry):
+        self.library.check_add(*entry)
+
+    def encode(self, max_length, now):
+        length = self.library.check_encode(self.out, max_length, now)
+        return self.out.raw[:length]
+
+
+def entry_at(rng, time_ms):
+    return (time_ms & 0xFFFFFFFF, rng.randrange(-128, 128), rng.randrange(-128, 128), rng.randrange(2500, 5500), rng.randrange(2))
+
+
+def check_flush(library, log, rng):
+    """Limits of the flush conditions, returns a list of failed cases."""
+    failures = []
+
+    def expect(name, now, voltage, expected):
+        if library.check_should_flush(now & 0xFFFFFFFF, voltage) != expected:
+            failures.append(name)
+
+    library.check_reset()
+    expect("empty log at full voltage", 0, 5000, False)
+    for start in (1000, 0xFFFFFFFF - 1000):
+        library.check_reset()
+        log.add(entry_at(rng, start))
+        suffix = " (millis() wrapping)" if start > 0x80000000 else ""
+        expect("one fresh entry" + suffix, start + 10, RESULT_LOG_FLUSH_VOLTAGE - 1, False)
+        expect("voltage at RESULT_LOG_FLUSH_VOLTAGE" + suffix, start + 10, RESULT_LOG_FLUSH_VOLTAGE, True)
+        expect("oldest entry just younger than RESULT_LOG_MAX_AGE" + suffix, start + RESULT_LOG_MAX_AGE - 1, 3000, False)
+        expect("oldest entry RESULT_LOG_MAX_AGE old" + suffix, start + RESULT_LOG_MAX_AGE, 3000, True)
+        for i in range(1, RESULT_LOG_FLUSH_COUNT - 1):
+            log.add(entry_at(rng, start + i))
+        expect("RESULT_LOG_FLUSH_COUNT - 1 entries" + suffix, start + 100, 3000, False)
+        log.add(entry_at(rng, start + 100))
+        expect("RESULT_LOG_FLUSH_COUNT entries" + suffix, start + 100, 3000, True)
+    return failures
+
+
+def decode_batch(computer, batch, now, received):
+    decoded = computer.decode_result_log(batch, received)
+    return decoded and {"dropped": decoded["dropped"],
+                        "entries": [((now - round((received - entry["time"]) / timedelta(milliseconds=1))) & 0xFFFFFFFF, entry["person_score"],
+                                     entry["no_person_score"], entry["voltage_mv"], {"local": 0, "remote": 1}[entry["strategy"]])
+                                    for entry in decoded["entries"]]}
+
+
+def check_wrap(library, log, computer, rng):
+    """Fills the ring past its capacity several times, returns a list of failed cases."""
+    failures = []
+    library.check_reset()
+    reference = ReferenceLog()
+    received = datetime(2024, 1, 1)
+    for i in range(3 * RESULT_LOG_CAPACITY + 5):
+        entry = entry_at(rng, 1000 * i)
+        log.add(entry)
+        reference.add(entry)
+        if library.check_count() != len(reference.entries) or library.check_dropped() != reference.dropped:
+            failures.append("count and dropped after {} adds".format(i + 1))
+            break
+    if library.check_head() != (3 * RESULT_LOG_CAPACITY + 5) % RESULT_LOG_CAPACITY:
+        failures.append("head after wrapping")
+    now = 1000 * 3 * RESULT_LOG_CAPACITY + 5
+    batch = decode_batch(computer, log.encode(RX_BUFFER_SIZE, now), now, received)
+    fit = (RX_BUFFER_SIZE - RESULT_LOG_HEADER_LENGTH) // RESULT_LOG_ENTRY_LENGTH
+    if not batch or batch["entries"] != reference.entries[:fit] or batch["dropped"] != reference.dropped:
+        failures.append("oldest surviving entries in the first batch")
+    #At the default MTU a notification carries a single entry
+    batch = log.encode(DEFAULT_MTU - 3, now)
+    if len(batch) > DEFAULT_MTU - 3 or batch[1] != 1 or decode_batch(computer, batch, now, received)["entries"] != reference.entries[:1]:
+        failures.append("batch at the default MTU")
+    return failures
+
+
+def check_random(library, log, computer, rng, operations):
+    """Random adds, flush decisions, batches and consumes compared with the reference, returns a list of failed cases."""
+    failures = []
+    library.check_reset()
+    reference = ReferenceLog()
+    now = rng.randrange(0xFFFFFFFF)
+    received = datetime(2024, 1, 1)
+    for i in range(operations):
+        now = (now + rng.randrange(0, 120000)) & 0xFFFFFFFF
+        action = rng.random()
+        if action < 0.6:
+            entry = entry_at(rng, now)
+            log.add(entry)
+            reference.add(entry)
+        elif action < 0.8:
+            voltage = rng.randrange(3000, 5000)
+            if library.check_should_flush(now, voltage) != reference.should_flush(now, voltage):
+                failures.append("flush decision at operation {}".format(i))
+        else:
+            max_length = rng.randrange(RESULT_LOG_HEADER_LENGTH, RX_BUFFER_SIZE + 1)
+            batch = log.encode(max_length, now)
+            fit = min((max_length - RESULT_LOG_HEADER_LENGTH) // RESULT_LOG_ENTRY_LENGTH, len(reference.entries))
+            if fit == 0:
+                if batch:
+                    failures.append("empty batch at operation {}".format(i))
+                continue
+            decoded = decode_batch(computer, batch, now, received)
+            if not decoded or decoded["entries"] != reference.entries[:fit] or decoded["dropped"] != reference.dropped:
+                failures.append("batch at operation {}".format(i))
+            #Sometimes the batch is lost and sent again in the next flush
+            if rng.random() < 0.8:
+                library.check_consume(batch[1])
+                reference.consume(batch[1])
+        if library.check_count() != len(reference.entries) or library.check_dropped() != reference.dropped:
+            failures.append("count and dropped at operation {}".format(i))
+        if len(failures) > 10:
+            break
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--operations", type=int, default=5000)
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    computer = load_computer()
+    ok = True
+    with tempfile.TemporaryDirectory() as build_dir:
+        library = build_library(build_dir)
+        log = Log(library)
+        for name, failures in (("flush decision at the limits", check_flush(library, log, rng)),
+                               ("ring wrap-around", check_wrap(library, log, computer, rng)),
+                               ("random operations ({})".format(args.operations), check_random(library, log, computer, rng, args.operations))):
+            print("{:<36} {}".format(name, "ok" if not failures else "FAIL: " + ", ".join(failures)))
+            ok &= not failures
+    print("All checks passed" if ok else "Some checks FAILED")
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,130 @@
+"""
+This script replays a recorded sequence of person scores through the decision filter of the sketches (score_filter.cpp, compiled on the host) to choose its
+settings. For every filter it reports how many result transmissions local_inference_send would make with RESULT_SEND_CHANGES_ONLY (the first decision and
+every change of the decision), how many of them were spurious (the decision went back within --window frames), and how many frames the filter followed a
+lasting change of the scene late.
+
+The sequence is either the result log the gateway writes (computer.py, lines "time,result,person_score,no_person_score,voltage" with int8 scores), a file
+with one person probability (0 - 1) per line, or a directory of camera frames in capture order (file name order) scored with the reference int8 model
+(split_model.py). The int8 scores are dequantized with the output quantization of --model, as on the device.
+Requires g++ (and numpy and Pillow for a directory of frames).
+
+Examples:
+    python score_filter_replay.py captured_data.txt
+    python score_filter_replay.py captured_data.txt --alpha 0.3 --on 0.7 --off 0.3 --k 3 --n 5
+    python score_filter_replay.py frames --window 3
+"""
+import argparse
+import ctypes
+import os
+import sys
+import tempfile
+
+from sketch_build import sketch_library
+from tflite_model import ModelInfo, load_model_bytes
+
+SKETCH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Arduino_examples", "natural_light")
+DEFAULT_MODEL = os.path.join(SKETCH, "person_detect_model_data.cpp")
+#Must be the same as in score_filter.h
+SCORE_FILTER_NONE = 0
+SCORE_FILTER_EWMA = 1
+SCORE_FILTER_K_OF_N = 2
+ALPHA = 0.5
+ON = 0.6
+OFF = 0.4
+K = 2
+N = 3
+PERSON_INDEX = 1
+
+WRAPPER = """
+#include "score_filter.h"
+static struct ScoreFilter filter;
+extern "C" void replay_init(int mode, float alpha, float on, float off, int k, int n) { score_filter_init(&filter, mode, alpha, on, off, k, n); }
+extern "C" int replay_update(float probability) { return score_filter_update(&filter, probability); }
+extern "C" float replay_dequantize(int value, float scale, int zero_point) { return score_dequantize((int8_t)value, scale, zero_point); }
+"""
+
+
+def build_library(build_dir):
+    """Compiles score_filter.cpp of the sketch into a shared library and returns it loaded with ctypes."""
+    library = sketch_library(build_dir, SKETCH, ["score_filter.cpp"], WRAPPER)
+    library.replay_init.argtypes = [ctypes.c_int, ctypes.c_float, ctypes.c_float, ctypes.c_float, ctypes.c_int, ctypes.c_int]
+    library.replay_update.argtypes = [ctypes.c_float]
+    library.replay_dequantize.argtypes = [ctypes.c_int, ctypes.c_float, ctypes.c_int]
+    library.replay_dequantize.restype = ctypes.c_float
+    return library
+
+
+def load_sequence(path, model_path, library):
+    """Person probabilities of the recorded frames, in capture order."""
+    if os.path.isdir(path):
+        from split_benchmark import device_input, load_frames
+        from split_model import ReferenceModel
+        model = ReferenceModel(model_path)
+        frames = sorted(load_frames(path), key=lambda frame: os.path.basename(frame[0]))
+        return [model.person_probability(model.run(device_input(frame_path))) for frame_path, _ in frames]
+    model = ModelInfo(load_model_bytes(model_path))
+    output = model.tensors[model.outputs[0]]
+    probabilities = []
+    with open(path) as f:
+        for line in f:
+            fields = line.strip().split(",")
+            if len(fields) >= 4:
+                probabilities.append(library.replay_dequantize(int(fields[2]), output.scale, output.zero_point))
+            elif fields[0]:
+                probabilities.append(float(fields[-1]))
+    return probabilities
+
+
+def replay(library, probabilities, mode, alpha, on, off, k, n):
+    library.replay_init(mode, alpha, on, off, k, n)
+    return [bool(library.replay_update(p)) for p in probabilities]
+
+
+def evaluate(decisions, reference, window):
+    """(transmissions, spurious transmissions, frames late) of a decision sequence."""
+    changes = [i for i in range(1, len(decisions)) if decisions[i] != decisions[i - 1]]
+    #A change is spurious if the decision goes back within window frames
+    spurious = sum(1 for i in changes if any(decisions[j] != decisions[i] for j in range(i + 1, min(i + 1 + window, len(decisions)))))
+    #Lasting changes of the scene: the per-frame decision changed and stayed for at least window frames
+    late = 0
+    for i in range(1, len(reference)):
+        if reference[i] != reference[i - 1] and all(reference[j] == reference[i] for j in range(i, min(i + window, len(reference)))):
+            j = i
+            while j < len(decisions) and decisions[j] != reference[i]:
+                j += 1
+            late += j - i
+    return 1 + len(changes), spurious, late
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("sequence", help="gateway result log, probability file or directory of frames")
+    parser.add_argument("--model", default=DEFAULT_MODEL, help=".tflite file or C array source of the model")
+    parser.add_argument("--alpha", type=float, default=ALPHA)
+    parser.add_argument("--on", type=float, default=ON)
+    parser.add_argument("--off", type=float, default=OFF)
+    parser.add_argument("--k", type=int, default=K)
+    parser.add_argument("--n", type=int, default=N)
+    parser.add_argument("--window", type=int, default=3, help="frames within which a change that goes back is spurious")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as build_dir:
+        library = build_library(build_dir)
+        probabilities = load_sequence(args.sequence, args.model, library)
+        if not probabilities:
+            parser.error("no frames in {}".format(args.sequence))
+        filters = (("per frame", SCORE_FILTER_NONE), ("EWMA {:.2f} {:.2f}/{:.2f}".format(args.alpha, args.on, args.off), SCORE_FILTER_EWMA),
+                   ("{} of {}".format(args.k, args.n), SCORE_FILTER_K_OF_N))
+        results = [(name, replay(library, probabilities, mode, args.alpha, args.on, args.off, args.k, args.n)) for name, mode in filters]
+
+    reference = results[0][1]
+    print("{} frames, {:.0%} with a person per frame".format(len(probabilities), sum(reference) / len(reference)))
+    print("{:>22} {:>13} {:>9} {:>11} {:>9}".format("filter", "transmissions", "spurious", "frames late", "person"))
+    for name, decisions in results:
+        transmissions, spurious, late = evaluate(decisions, reference, args.window)
+        print("{:>22} {:>13} {:>9} {:>11} {:>9.0%}".format(name, transmissions, spurious, late, sum(decisions) / len(decisions)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,400 @@
+"""
+This script checks the BLE session of the sketches (ble_session.cpp of natural_light, compiled on the host) over timing scenarios with a simulated transport.
+ArduinoBLE is replaced by a stand-in: after advertising starts a central connects (--connect-ms) and subscribes (--subscribe-ms) later, the link can drop
+while idle, and the connection parameter update of the session is applied to the link. Time is simulated, millis() follows the polling of the sketch.
+
+Every scenario runs --cycles transfers with a capture period and storage voltage the way the transfer tasks do (session_select, session_start,
+session_wait_subscribed, session_first_byte, session_end) and checks:
+    - the keep/close decision (keep the connection only if the capture period is at most SESSION_MAX_PERIOD and the voltage at least SESSION_MIN_VOLTAGE)
+    - that kept connections are reused, and the time from the connection (or cycle start) to the first byte with and without reuse
+    - that the stack is brought up once for kept connections and in every cycle otherwise
+    - that the connection update is requested once per kept connection, for the handle of the central and not from the connect handler
+    - that the transfer gives up after SESSION_CONNECT_TIMEOUT when no central connects
+It also runs every scenario with the other decision and prints the radio energy of both as an estimate from --bringup-mj, --advertise-mw and --event-uj
+(assumed values, not measured).
+Requires g++.
+
+Examples:
+    python session_sim.py
+    python session_sim.py --cycles 50 --connect-ms 3000 --event-uj 30
+"""
+import argparse
+import ctypes
+import os
+import shutil
+import sys
+import tempfile
+
+from sketch_build import compile_library
+
+SKETCH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Arduino_examples", "natural_light")
+#Must be the same as in ble_session.h
+SESSION_MAX_PERIOD = 15000
+SESSION_MIN_VOLTAGE = 4200
+SESSION_CONNECT_TIMEOUT = 30000
+
+#Stand-ins for ArduinoBLE and its utility headers, with the parts ble_session.cpp uses
+ARDUINO_BLE_H = """
+#ifndef SIM_ARDUINO_BLE_H
+#define SIM_ARDUINO_BLE_H
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+class String
+{
+public:
+    String(const char* text = "") : text(text) {}
+    String substring(int from, int to) const { return String(text.substr(from, to - from).c_str()); }
+    const char* c_str() const { return text.c_str(); }
+private:
+    std::string text;
+};
+struct BLEDevice { String address() const; };
+struct SimBLE
+{
+    bool connected();
+    void poll();
+    int advertise();
+    void disconnect();
+    void end();
+    void setConnectionInterval(uint16_t minimum, uint16_t maximum);
+};
+extern SimBLE BLE;
+#endif
+"""
+ATT_H = """
+#include <stdint.h>
+struct SimATT { uint16_t connectionHandle(uint8_t addressType, uint8_t address[6]) const; uint16_t mtu(uint16_t handle) const; };
+extern SimATT ATT;
+"""
+HCI_H = """
+#include <stdint.h>
+struct SimHCI { int leConnUpdate(uint16_t handle, uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t supervisionTimeout); };
+extern SimHCI HCI;
+"""
+APPLICATION_H = """
+#include <ArduinoBLE.h>
+extern unsigned long millis();
+extern void initBLE(void);
+"""
+
+#Simulated stack, link and central
+SIM_CPP = """
+#include "application.h"
+#include "ble_session.h"
+#include <utility/ATT.h>
+#include <utility/HCI.h>
+#include <stdio.h>
+#include <string.h>
+
+SimBLE BLE;
+SimATT ATT;
+SimHCI HCI;
+static double now_ms = 0;
+static bool advertising = false;
+static bool link_up = false;
+static bool in_callback = false;
+static double connect_at = -1;
+static double subscribe_at = -1;
+static double drop_at = -1;
+static double connect_delay = 0;
+static double subscribe_delay = 0;
+static double central_interval = 30;
+static double interval_ms = 30;
+static int slave_latency = 0;
+static uint16_t handle = 0xffff;
+static uint16_t next_handle = 0x40;
+//Random static address of the central, least significant byte first
+static uint8_t central_address[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0xc6};
+
+//bring-ups, connections, connection updates, updates from the connect handler, updates for another handle, advertising ms, connection events
+static double counters[7];
+
+static void fire_events()
+{
+    if(advertising && connect_at >= 0 && now_ms >= connect_at)
+    {
+        advertising = false;
+        link_up = true;
+        connect_at = -1;
+        handle = next_handle++;
+        interval_ms = central_interval;
+        slave_latency = 0;
+        counters[1]++;
+        in_callback = true;
+        session_on_connect(BLEDevice());
+        in_callback = false;
+        subscribe_at = now_ms + subscribe_delay;
+    }
+    if(link_up && subscribe_at >= 0 && now_ms >= subscribe_at)
+    {
+        subscribe_at = -1;
+        session_on_subscribe(true);
+    }
+    if(link_up && drop_at >= 0 && now_ms >= drop_at)
+    {
+        drop_at = -1;
+        link_up = false;
+        session_on_disconnect();
+    }
+}
+
+//Idle time counts the connection events the peripheral may skip with slave latency
+static void advance(double ms, bool idle)
+{
+    double end = now_ms + ms;
+    while(now_ms < end)
+    {
+        now_ms += 1;
+        if(advertising)
+        {
+            counters[5] += 1;
+        }
+        if(link_up)
+        {
+            counters[6] += 1 / (interval_ms * (idle ? slave_latency + 1 : 1));
+        }
+        fire_events();
+    }
+}
+
+String BLEDevice::address() const
+{
+    char text[18];
+    snprintf(text, sizeof(text), "%02x:%02x:%02x:%02x:%02x:%02x", central_address[5], central_address[4], central_address[3],
+             central_address[2], central_address[1], central_address[0]);
+    return String(text);
+}
+
+bool SimBLE::connected() { return link_up; }
+void SimBLE::poll() { advance(1, false); }
+void SimBLE::setConnectionInterval(uint16_t minimum, uint16_t maximum) {}
+
+int SimBLE::advertise()
+{
+    advertising = true;
+    connect_at = connect_delay >= 0 ? now_ms + connect_delay : -1;
+    return 1;
+}
+
+void SimBLE::disconnect()
+{
+    if(link_up)
+    {
+        link_up = false;
+        session_on_disconnect();
+    }
+}
+
+void SimBLE::end()
+{
+    advertising = false;
+    connect_at = -1;
+}
+
+void initBLE()
+{
+    counters[0]++;
+    BLE.advertise();
+}
+
+unsigned long millis() { return (unsigned long)now_ms; }
+
+uint16_t SimATT::connectionHandle(uint8_t addressType, uint8_t address[6]) const
+{
+    return link_up && addressType == 1 && memcmp(address, central_address, 6) == 0 ? handle : 0xffff;
+}
+
+uint16_t SimATT::mtu(uint16_t mtu_handle) const
+{
+    return 23;
+}
+
+//The central accepts the requested parameters and picks the longest interval
+int SimHCI::leConnUpdate(uint16_t update_handle, uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t supervisionTimeout)
+{
+    counters[2]++;
+    counters[3] += in_callback;
+    if(!link_up || update_handle != handle)
+    {
+        counters[4]++;
+        return 0;
+    }
+    interval_ms = maxInterval * 1.25;
+    slave_latency = latency;
+    return 1;
+}
+
+extern "C" void sim_central(double connect_ms, double subscribe_ms, double interval)
+{
+    connect_delay = connect_ms;
+    subscribe_delay = subscribe_ms;
+    central_interval = interval;
+}
+
+//One transfer cycle, decision -1 lets session_select decide. out: persistent, reused, subscribed, first byte ms, cycle ms
+extern "C" void sim_cycle(unsigned long period, int voltage, int decision, double transfer_ms, double* out)
+{
+    double start = now_ms;
+    bool persistent = decision < 0 ? session_select(period, voltage) : decision;
+    bool reused = session_start(persistent);
+    bool subscribed = session_wait_subscribed(SESSION_CONNECT_TIMEOUT);
+    if(subscribed)
+    {
+        session_first_byte();
+        advance(transfer_ms, false);
+    }
+    session_end();
+    out[0] = persistent;
+    out[1] = reused;
+    out[2] = subscribed;
+    out[3] = session_connect_latency();
+    out[4] = now_ms - start;
+}
+
+//Idle until the next capture, the link drops after drop_ms if it is not negative
+extern "C" void sim_idle(double ms, double drop_ms)
+{
+    drop_at = drop_ms >= 0 ? now_ms + drop_ms : -1;
+    advance(ms, true);
+    drop_at = -1;
+}
+
+extern "C" void sim_counters(double* out)
+{
+    memcpy(out, counters, sizeof(counters));
+}
+"""
+COUNTERS = ["bringups", "connections", "updates", "updates_in_callback", "updates_wrong_handle", "advertising_ms", "events"]
+
+
+def build_session(build_dir):
+    """Compiles ble_session.cpp of the sketch with the simulated stack, returns it loaded with ctypes.
+    The sources are copied next to the stand-in application.h, which their quoted includes find first."""
+    os.makedirs(os.path.join(build_dir, "utility"))
+    for name in ("ble_session.cpp", "ble_session.h"):
+        shutil.copy(os.path.join(SKETCH, name), build_dir)
+    for name, text in (("ArduinoBLE.h", ARDUINO_BLE_H), ("utility/ATT.h", ATT_H), ("utility/HCI.h", HCI_H), ("application.h", APPLICATION_H),
+                       ("sim.cpp", SIM_CPP)):
+        with open(os.path.join(build_dir, name), "w") as f:
+            f.write(text)
+    return compile_library(build_dir, "session", [os.path.join(build_dir, name) for name in ("sim.cpp", "ble_session.cpp")], build_dir)
+
+
+class Session:
+    """A fresh copy of the session library, so every run starts without a stack or connection."""
+
+    def __init__(self, path, args):
+        self.library = ctypes.CDLL(path)
+        self.library.sim_central.argtypes = [ctypes.c_double, ctypes.c_double, ctypes.c_double]
+        self.library.sim_cycle.argtypes = [ctypes.c_ulong, ctypes.c_int, ctypes.c_int, ctypes.c_double, ctypes.POINTER(ctypes.c_double)]
+        self.library.sim_idle.argtypes = [ctypes.c_double, ctypes.c_double]
+        self.args = args
+
+    def run(self, scenario, decision=-1):
+        """Runs the cycles of a scenario, returns the cycle results and the counters."""
+        connect_ms = scenario.get("connect_ms", self.args.connect_ms)
+        self.library.sim_central(connect_ms, self.args.subscribe_ms, self.args.central_interval)
+        cycles = []
+        out = (ctypes.c_double * 5)()
+        for i in range(self.args.cycles):
+            self.library.sim_cycle(scenario["period"], scenario["voltage"], decision, self.args.transfer_ms, out)
+            cycles.append(dict(zip(["persistent", "reused", "subscribed", "first_byte_ms", "cycle_ms"], out)))
+            drop = scenario.get("drop_ms", -1) if i % 2 == 0 else -1
+            self.library.sim_idle(max(scenario["period"] - out[4], 0), drop)
+        counters = (ctypes.c_double * len(COUNTERS))()
+        self.library.sim_counters(counters)
+        return cycles, dict(zip(COUNTERS, counters))
+
+
+def energy_mj(counters, args):
+    """Radio energy estimate from the assumed costs."""
+    return (counters["bringups"] * args.bringup_mj + counters["advertising_ms"] * args.advertise_mw / 1000 +
+            counters["events"] * args.event_uj / 1000)
+
+
+def check_scenario(name, scenario, cycles, counters, args):
+    failures = []
+    keep = scenario["period"] <= SESSION_MAX_PERIOD and scenario["voltage"] >= SESSION_MIN_VOLTAGE
+    if any(bool(cycle["persistent"]) != keep for cycle in cycles):
+        failures.append("decision")
+    connects = scenario.get("connect_ms", args.connect_ms) >= 0
+    if not connects:
+        if any(cycle["subscribed"] or abs(cycle["cycle_ms"] - SESSION_CONNECT_TIMEOUT) > 2 for cycle in cycles):
+            failures.append("connect timeout")
+        return failures
+    #Cycles that follow an idle time with a link drop (every other one in the drop scenario) connect again
+    for i, cycle in enumerate(cycles):
+        dropped = "drop_ms" in scenario and i % 2 == 1
+        expected = keep and i > 0 and not dropped
+        if bool(cycle["reused"]) != expected:
+            failures.append("reuse in cycle {}".format(i))
+            break
+        if cycle["reused"] and cycle["first_byte_ms"] > 1:
+            failures.append("first byte of a reused connection")
+            break
+        if not cycle["reused"] and cycle["first_byte_ms"] < args.subscribe_ms:
+            failures.append("first byte of a new connection")
+            break
+    if counters["bringups"] != (1 if keep else len(cycles)):
+        failures.append("stack bring-ups")
+    if counters["updates"] != (counters["connections"] if keep else 0):
+        failures.append("connection updates")
+    if counters["updates_in_callback"] or counters["updates_wrong_handle"]:
+        failures.append("connection update in the connect handler or for another handle")
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--cycles", type=int, default=20)
+    parser.add_argument("--connect-ms", type=float, default=1200, help="advertising until the central connects")
+    parser.add_argument("--subscribe-ms", type=float, default=150, help="connection until the central subscribed")
+    parser.add_argument("--central-interval", type=float, default=30, help="connection interval of the central before the update, ms")
+    parser.add_argument("--transfer-ms", type=float, default=400)
+    parser.add_argument("--bringup-mj", type=float, default=2.0, help="assumed energy of BLE.begin and the service setup")
+    parser.add_argument("--advertise-mw", type=float, default=3.0, help="assumed average power while advertising")
+    parser.add_argument("--event-uj", type=float, default=20.0, help="assumed energy of one connection event")
+    args = parser.parse_args()
+
+    scenarios = [
+        ("fast capture, charged", {"period": 5000, "voltage": 4500}),
+        ("period and voltage at the limit", {"period": SESSION_MAX_PERIOD, "voltage": SESSION_MIN_VOLTAGE}),
+        ("slow capture", {"period": 60000, "voltage": 4500}),
+        ("low voltage", {"period": 5000, "voltage": 4000}),
+        ("link dropped while idle", {"period": 5000, "voltage": 4500, "drop_ms": 1000}),
+        ("no gateway", {"period": 5000, "voltage": 4500, "connect_ms": -1}),
+    ]
+    ok = True
+    with tempfile.TemporaryDirectory() as build_dir:
+        path = build_session(build_dir)
+        print("{:<32} {:>6} {:>8} {:>14} {:>10} {:>21} {:>8}  {}".format("scenario", "keep", "reused", "first byte ms", "bring-ups",
+                                                                        "energy mJ keep/close", "cheaper", "result"))
+        for index, (name, scenario) in enumerate(scenarios):
+            #Every run loads its own copy of the library, so no state carries over
+            run_path = os.path.join(build_dir, "session{}.so".format(index))
+            shutil.copy(path, run_path)
+            cycles, counters = Session(run_path, args).run(scenario)
+            failures = check_scenario(name, scenario, cycles, counters, args)
+            ok &= not failures
+            energy = {}
+            for decision in (1, 0):
+                decision_path = os.path.join(build_dir, "session{}_{}.so".format(index, decision))
+                shutil.copy(path, decision_path)
+                energy[decision] = energy_mj(Session(decision_path, args).run(scenario, decision)[1], args)
+            reused = [cycle for cycle in cycles if cycle["reused"]]
+            new = [cycle for cycle in cycles if not cycle["reused"] and cycle["subscribed"]]
+            first_byte = "{:.0f}/{:.0f}".format(sum(c["first_byte_ms"] for c in reused) / len(reused) if reused else 0,
+                                                sum(c["first_byte_ms"] for c in new) / len(new) if new else 0)
+            print("{:<32} {:>6} {:>8} {:>14} {:>10.0f} {:>21} {:>8}  {}".format(
+                name, "yes" if cycles[0]["persistent"] else "no", "{}/{}".format(len(reused), len(cycles)), first_byte, counters["bringups"],
+                "{:.0f}/{:.0f}".format(energy[1], energy[0]), "keep" if energy[1] < energy[0] else "close",
+                "ok" if not failures else "FAIL: " + ", ".join(failures)))
+    print("first byte ms: average over reused/new connections; energy: estimate of the whole scenario with the connection kept/closed, cheaper: the")
+    print("decision the estimate favours (it depends on the assumed costs, the keep/close checks only follow SESSION_MAX_PERIOD and SESSION_MIN_VOLTAGE)")
+    print("All checks passed" if ok else "Some checks FAILED")
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,24 @@
+"""
+Builds sketch sources into shared libraries for the host tools in this folder. The modules the tools exercise do not depend on the Arduino core (or get stand-ins
+for the parts of it they use), so they are compiled with g++ on the host together with a small extern "C" wrapper and loaded with ctypes.
+"""
+import ctypes
+import os
+import subprocess
+
+
+def compile_library(build_dir, name, sources, include_dir, defines=()):
+    """Compiles the sources into build_dir/<name>.so with the headers of include_dir, returns the path of the library."""
+    library = os.path.join(build_dir, name + ".so")
+    subprocess.check_call(["g++", "-O2", "-shared", "-fPIC", *("-D" + define for define in defines), "-I", include_dir, *sources, "-o", library])
+    return library
+
+
+def sketch_library(build_dir, sketch, sources, wrapper):
+    """Compiles the sources of a sketch (file names in sketch, a directory) with the wrapper (C++ source text) and returns the library loaded with ctypes.
+    The library is named after the first source."""
+    name = os.path.splitext(sources[0])[0]
+    wrapper_path = os.path.join(build_dir, name + "_wrapper.cpp")
+    with open(wrapper_path, "w") as f:
+        f.write(wrapper)
+    return ctypes.CDLL(compile_library(build_dir, name, [wrapper_path] + [os.path.join(sketch, source) for source in sources], sketch))
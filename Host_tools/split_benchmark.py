@@ -0,0 +1,120 @@
+"""
+This script evaluates the split points of the split computing mode of the natural_light sketch (see split_inference.cpp). For every split point it runs the
+reference int8 model (split_model.py) on a set of camera frames, packs the activation of the split point exactly as the device does, decodes it and finishes the
+network as the gateway does. It reports the payload size (and how many frames fit into the device buffer), the device compute time up to the split point,
+and how often the result is the same as the one of the full model on the device. If the image directory contains the subdirectories person and no_person, the
+accuracy against these labels is reported as well.
+
+The device compute time is measured: with --profile, the operator table of the profiling mode of the sketch (OP_PROFILER_ENABLED in op_profiler.h, read as
+op_profile_report.py does) gives the mean time of every node on the board, summed up to the split point ("device ms"). Without a table it is only estimated
+from the multiply-accumulate operations up to the split point, scaled to the duration of the full inference (execution_time of F_local in application.cpp),
+and the column is labelled "est. ms". The time of the split runs on the board is also reported in the telemetry (split_compute_ms).
+Requires numpy and Pillow.
+
+Examples:
+    python split_benchmark.py frames --profile serial_capture.txt
+    python split_benchmark.py frames --layers 3 7 11 13 23 26 --bits 8 4
+"""
+import argparse
+import glob
+import os
+
+import numpy as np
+
+from op_profile_report import parse_capture
+from split_model import ReferenceModel, encode_split
+from thumbnail_benchmark import CROP, device_crop
+
+DEFAULT_MODEL = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Arduino_examples", "natural_light", "person_detect_model_data.cpp")
+#Duration of the full local inference (F_local) and the buffer the payload is packed into (MAX_JPEG_BYTES) on the board
+FULL_INFERENCE_MS = 1148
+MAX_PAYLOAD_BYTES = 4096
+THRESHOLD = 0.5
+
+
+def device_input(path):
+    """96x96 int8 crop of a camera frame at the MCU-aligned offset of DecodeAndProcessImage (see thumbnail_benchmark.py)."""
+    pixels = np.asarray(device_crop(path), np.int32) - 128
+    return pixels.astype(np.int8).reshape(1, CROP, CROP, 1)
+
+
+def measured_node_ms(path, model):
+    """Mean time of every node on the board in ms from a capture of the operator profiler."""
+    with open(path, errors="replace") as f:
+        table = parse_capture(f)
+    if table is None:
+        raise SystemExit("no operator table found in {}".format(path))
+    _, rate, _, rows = table
+    node_ms = [0.0] * len(model.operators)
+    for row in rows:
+        if row["node"] < len(node_ms) and row["invocations"]:
+            node_ms[row["node"]] = row["total"] / row["invocations"] * 1000 / rate
+    return node_ms
+
+
+def load_frames(directory):
+    """Returns [(path, label)], the label is None for frames outside the person / no_person subdirectories."""
+    frames = []
+    for label, subdirectory in ((True, "person"), (False, "no_person"), (None, "")):
+        for pattern in ("*.jpg", "*.jpeg", "*.png"):
+            frames += [(path, label) for path in glob.glob(os.path.join(directory, subdirectory, pattern))]
+    return sorted(frames)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("images", help="directory with camera frames (optionally in person / no_person subdirectories)")
+    parser.add_argument("--model", default=DEFAULT_MODEL, help=".tflite file or C array source of the model")
+    parser.add_argument("--layers", type=int, nargs="+", help="split points (operators run on the device), all by default")
+    parser.add_argument("--bits", type=int, nargs="+", default=[8, 4], choices=[8, 4])
+    parser.add_argument("--profile", help="capture of the operator profiler (see op_profile_report.py) for the measured device time")
+    parser.add_argument("--full-ms", type=float, default=FULL_INFERENCE_MS, help="full inference time the estimate is scaled to without --profile")
+    parser.add_argument("--max-bytes", type=int, default=MAX_PAYLOAD_BYTES)
+    args = parser.parse_args()
+
+    frames = load_frames(args.images)
+    if not frames:
+        parser.error("no images in {}".format(args.images))
+    model = ReferenceModel(args.model)
+    layers = args.layers or list(range(1, len(model.operators)))
+
+    macs = [model.macs(op) for op in model.operators]
+    total_macs = sum(macs)
+    node_ms = measured_node_ms(args.profile, model) if args.profile else None
+    inputs = [device_input(path) for path, _ in frames]
+    #Outputs of all operators for every frame, the last one is the result of the full model on the device
+    outputs = [model.run(x, keep=True) for x in inputs]
+    full = [model.person_probability(result[-1]) > THRESHOLD for result in outputs]
+    labelled = [(i, label) for i, (_, label) in enumerate(frames) if label is not None]
+    if labelled:
+        accuracy = sum(full[i] == label for i, label in labelled) / len(labelled)
+        print("{} frames ({} labelled), full model accuracy {:.1%}".format(len(frames), len(labelled), accuracy))
+    else:
+        print("{} frames".format(len(frames)))
+
+    header = "{:>5} {:>18} {:>14} {:>4} {:>9} {:>9} {:>6} {:>10} {:>7}".format(
+        "layer", "operator", "shape", "bits", "raw B", "payload B", "fits", "device ms" if node_ms else "est. ms", "agree")
+    if labelled:
+        header += " {:>9}".format("accuracy")
+    print(header)
+    for layer in layers:
+        op = model.operators[layer - 1]
+        tensor = model.tensors[op.outputs[0]]
+        device_ms = sum(node_ms[:layer]) if node_ms else args.full_ms * sum(macs[:layer]) / total_macs
+        for bits in args.bits:
+            sizes, decisions = [], []
+            for result in outputs:
+                payload = encode_split(result[layer - 1], layer, bits, tensor.scale, tensor.zero_point)
+                sizes.append(len(payload))
+                decisions.append(model.finish(payload) > THRESHOLD)
+            agree = sum(a == b for a, b in zip(decisions, full)) / len(frames)
+            fits = sum(size <= args.max_bytes for size in sizes) / len(frames)
+            line = "{:>5} {:>18} {:>14} {:>4} {:>9} {:>9.0f} {:>6.0%} {:>10.0f} {:>7.1%}".format(
+                layer, op.name, "x".join(str(dim) for dim in tensor.shape[1:]), bits, tensor.bytes, sum(sizes) / len(sizes), fits, device_ms, agree)
+            if labelled:
+                line += " {:>9.1%}".format(sum(decisions[i] == label for i, label in labelled) / len(labelled))
+            print(line)
+
+
+if __name__ == "__main__":
+    main()
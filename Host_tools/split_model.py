@@ -0,0 +1,206 @@
+"""
+Reference int8 implementation of the person detection model used by the split computing mode (see split_inference.cpp of the natural_light sketch). The device runs
+the first operators of the model and sends the intermediate activation, the gateway decodes it with decode_split() and finishes the network with
+ReferenceModel.run(). The kernels follow the TFLM reference kernels (CONV_2D, DEPTHWISE_CONV_2D, AVERAGE_POOL_2D, RESHAPE, SOFTMAX); the requantization is done in
+floating point, so an output value can differ by one step from the board, which does not change the decision.
+Requires numpy, the model is read with tflite_model.py (from a .tflite file or from the C array compiled into the sketches).
+"""
+import struct
+
+import numpy as np
+
+from tflite_model import ModelInfo, load_model_bytes
+
+#Must be the same as in split_inference.h
+SPLIT_MESSAGE = 0x5C
+SPLIT_HEADER_LENGTH = 14
+#Output index of the person class (kPersonIndex in model_settings.h)
+PERSON_INDEX = 1
+
+#Fused activation functions of the TFLite schema
+ACTIVATION_NONE = 0
+ACTIVATION_RELU = 1
+ACTIVATION_RELU6 = 3
+PADDING_SAME = 0
+
+
+def is_split(payload):
+    return len(payload) >= SPLIT_HEADER_LENGTH and payload[0] == SPLIT_MESSAGE
+
+
+def _level(values, zero_point, bits):
+    level = np.maximum(values.astype(np.int32) - zero_point, 0)
+    if bits < 8:
+        shift = 8 - bits
+        level = np.minimum((level + (1 << (shift - 1))) >> shift, (1 << bits) - 1)
+    return level
+
+
+def encode_split(activation, layer, bits, scale, zero_point):
+    """Same payload as split_encode() on the device (activation is an int8 array of shape [1, height, width, channels])."""
+    _, height, width, channels = activation.shape
+    level = _level(activation.reshape(-1), zero_point, bits)
+    nonzero = level[level != 0]
+    bitmap = np.packbits(level != 0, bitorder="little").tobytes()
+    if bits == 8:
+        packed = nonzero.astype(np.uint8).tobytes()
+    else:
+        if len(nonzero) % 2:
+            nonzero = np.append(nonzero, 0)
+        packed = (nonzero[0::2] | (nonzero[1::2] << 4)).astype(np.uint8).tobytes()
+    header = struct.pack("<BBBbHHHf", SPLIT_MESSAGE, layer, bits, zero_point, height, width, channels, scale)
+    return header + bitmap + packed
+
+
+def decode_split(payload):
+    """Returns (layer, int8 activation of shape [1, height, width, channels], scale, zero point)."""
+    _, layer, bits, zero_point, height, width, channels, scale = struct.unpack_from("<BBBbHHHf", payload, 0)
+    count = height * width * channels
+    bitmap_length = (count + 7) // 8
+    mask = np.unpackbits(np.frombuffer(payload, np.uint8, bitmap_length, SPLIT_HEADER_LENGTH), bitorder="little")[:count].astype(bool)
+    packed = np.frombuffer(payload, np.uint8, offset=SPLIT_HEADER_LENGTH + bitmap_length)
+    nonzero = int(mask.sum())
+    if bits == 8:
+        level = packed[:nonzero].astype(np.int32)
+    else:
+        level = np.stack([packed & 0x0F, packed >> 4], axis=1).reshape(-1)[:nonzero].astype(np.int32) << (8 - bits)
+    values = np.full(count, zero_point, np.int32)
+    values[mask] += level
+    return layer, np.clip(values, -128, 127).astype(np.int8).reshape(1, height, width, channels), scale, zero_point
+
+
+def _activation_range(activation, scale, zero_point):
+    low, high = -128, 127
+    if activation in (ACTIVATION_RELU, ACTIVATION_RELU6):
+        low = max(low, zero_point)
+    if activation == ACTIVATION_RELU6:
+        high = min(high, zero_point + int(round(6 / scale)))
+    return low, high
+
+
+def _pad(x, kernel, stride, padding):
+    """Pads [height, width, channels] for SAME padding, returns the padded input and the output size."""
+    height, width = x.shape[0], x.shape[1]
+    if padding != PADDING_SAME:
+        return x, (height - kernel[0]) // stride[0] + 1, (width - kernel[1]) // stride[1] + 1
+    out_h = (height + stride[0] - 1) // stride[0]
+    out_w = (width + stride[1] - 1) // stride[1]
+    pad_h = max((out_h - 1) * stride[0] + kernel[0] - height, 0)
+    pad_w = max((out_w - 1) * stride[1] + kernel[1] - width, 0)
+    x = np.pad(x, ((pad_h // 2, pad_h - pad_h // 2), (pad_w // 2, pad_w - pad_w // 2), (0, 0)))
+    return x, out_h, out_w
+
+
+class ReferenceModel:
+
+    def __init__(self, path):
+        self.info = ModelInfo(load_model_bytes(path))
+        self.operators = self.info.operators
+        self.tensors = self.info.tensors
+
+    def macs(self, op):
+        """Multiply-accumulate operations of an operator (output elements for the cheap ones), used to estimate the device compute time."""
+        output = self.tensors[op.outputs[0]]
+        if op.name in ("CONV_2D", "DEPTHWISE_CONV_2D"):
+            weights = self.tensors[op.inputs[1]].shape
+            per_output = weights[1] * weights[2] * (weights[3] if op.name == "CONV_2D" else 1)
+            return output.num_elements * per_output
+        return output.num_elements
+
+    def _requantize(self, acc, op, input_scale, weight_scales):
+        output = self.tensors[op.outputs[0]]
+        multiplier = input_scale * np.asarray(weight_scales, np.float64) / output.scale
+        return np.round(acc * multiplier).astype(np.int64) + output.zero_point
+
+    def _convolution(self, op, x, depthwise):
+        source, weights, bias = (self.tensors[i] for i in op.inputs[:3])
+        options = op.options
+        if depthwise:
+            stride = (options.scalar(2, "i", 1), options.scalar(1, "i", 1))
+            multiplier = options.scalar(3, "i")
+            activation = options.scalar(4, "b")
+        else:
+            stride = (options.scalar(2, "i", 1), options.scalar(1, "i", 1))
+            activation = options.scalar(3, "b")
+        w = np.frombuffer(weights.data, np.int8).reshape(weights.shape).astype(np.int64)
+        b = np.frombuffer(bias.data, np.int32).astype(np.int64)
+        kernel = (weights.shape[1], weights.shape[2])
+        xs = x[0].astype(np.int64) - source.zero_point
+        if depthwise:
+            xs = np.repeat(xs, multiplier, axis=2)
+        xs, out_h, out_w = _pad(xs, kernel, stride, options.scalar(0, "b"))
+        acc = np.zeros((out_h, out_w, weights.shape[0] if not depthwise else weights.shape[3]), np.int64)
+        for ky in range(kernel[0]):
+            for kx in range(kernel[1]):
+                patch = xs[ky:ky + stride[0] * (out_h - 1) + 1:stride[0], kx:kx + stride[1] * (out_w - 1) + 1:stride[1], :]
+                if depthwise:
+                    acc += patch * w[0, ky, kx, :]
+                else:
+                    acc += patch @ w[:, ky, kx, :].T
+        acc += b
+        output = self.tensors[op.outputs[0]]
+        low, high = _activation_range(activation, output.scale, output.zero_point)
+        return np.clip(self._requantize(acc, op, source.scale, weights.scales), low, high).astype(np.int8)[np.newaxis]
+
+    def _average_pool(self, op, x):
+        options = op.options
+        stride = (options.scalar(2, "i", 1), options.scalar(1, "i", 1))
+        kernel = (options.scalar(4, "i"), options.scalar(3, "i"))
+        output = self.tensors[op.outputs[0]]
+        low, high = _activation_range(options.scalar(5, "b"), output.scale, output.zero_point)
+        values = x[0].astype(np.int64)
+        ones = np.ones(values.shape[:2] + (1,), np.int64)
+        values, out_h, out_w = _pad(values, kernel, stride, options.scalar(0, "b"))
+        counts, _, _ = _pad(ones, kernel, stride, options.scalar(0, "b"))
+        total = np.zeros((out_h, out_w, values.shape[2]), np.int64)
+        count = np.zeros((out_h, out_w, 1), np.int64)
+        for ky in range(kernel[0]):
+            for kx in range(kernel[1]):
+                rows = slice(ky, ky + stride[0] * (out_h - 1) + 1, stride[0])
+                cols = slice(kx, kx + stride[1] * (out_w - 1) + 1, stride[1])
+                total += values[rows, cols, :] * counts[rows, cols, :]
+                count += counts[rows, cols, :]
+        #Rounded to the nearest integer away from zero, as the reference kernel does
+        average = np.where(total > 0, (total + count // 2) // count, -((-total + count // 2) // count))
+        return np.clip(average, low, high).astype(np.int8)[np.newaxis]
+
+    def _softmax(self, op, x):
+        source = self.tensors[op.inputs[0]]
+        output = self.tensors[op.outputs[0]]
+        logits = (x.astype(np.float64) - source.zero_point) * source.scale
+        probabilities = np.exp(logits - logits.max(axis=-1, keepdims=True))
+        probabilities /= probabilities.sum(axis=-1, keepdims=True)
+        return np.clip(np.round(probabilities / output.scale) + output.zero_point, -128, 127).astype(np.int8)
+
+    def invoke(self, op, x):
+        if op.name == "CONV_2D":
+            return self._convolution(op, x, False)
+        if op.name == "DEPTHWISE_CONV_2D":
+            return self._convolution(op, x, True)
+        if op.name == "AVERAGE_POOL_2D":
+            return self._average_pool(op, x)
+        if op.name == "RESHAPE":
+            return x.reshape(self.tensors[op.outputs[0]].shape)
+        if op.name == "SOFTMAX":
+            return self._softmax(op, x)
+        raise NotImplementedError(op.name)
+
+    def run(self, x, start=0, stop=None, keep=False):
+        """Runs the operators start..stop-1 on x (the model input for start 0, the activation of the split point otherwise).
+        Returns the last output, or the outputs of all operators that ran with keep=True."""
+        stop = len(self.operators) if stop is None else stop
+        outputs = []
+        for op in self.operators[start:stop]:
+            x = self.invoke(op, x)
+            if keep:
+                outputs.append(x)
+        return outputs if keep else x
+
+    def person_probability(self, output):
+        tensor = self.tensors[self.info.outputs[0]]
+        return float((int(output.reshape(-1)[PERSON_INDEX]) - tensor.zero_point) * tensor.scale)
+
+    def finish(self, payload):
+        """Finishes the network on a split payload received from the device, returns the person probability."""
+        layer, activation, _, _ = decode_split(payload)
+        return self.person_probability(self.run(activation, start=layer))
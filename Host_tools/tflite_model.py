@@ -0,0 +1,215 @@
+"""
+Minimal reader for TensorFlow Lite flatbuffer models used by the host tools in this folder. It only depends on the Python standard library, so the tools can run on
+any PC without installing TensorFlow. The model can be loaded either from a .tflite file or directly from the C source array (person_detect_model_data.cpp) that is
+compiled into the Arduino sketches.
+"""
+import re
+import struct
+
+#TensorType values from the TensorFlow Lite schema and their size in bytes
+TENSOR_TYPES = {
+    0: ("float32", 4),
+    1: ("float16", 2),
+    2: ("int32", 4),
+    3: ("uint8", 1),
+    4: ("int64", 8),
+    5: ("string", 1),
+    6: ("bool", 1),
+    7: ("int16", 2),
+    9: ("int8", 1),
+    10: ("float64", 8),
+}
+
+#BuiltinOperator values from the TensorFlow Lite schema (only the ones relevant for small vision models)
+BUILTIN_OPERATORS = {
+    0: "ADD",
+    1: "AVERAGE_POOL_2D",
+    2: "CONCATENATION",
+    3: "CONV_2D",
+    4: "DEPTHWISE_CONV_2D",
+    6: "DEQUANTIZE",
+    9: "FULLY_CONNECTED",
+    14: "LOGISTIC",
+    17: "MAX_POOL_2D",
+    18: "MUL",
+    19: "RELU",
+    21: "RELU6",
+    22: "RESHAPE",
+    25: "SOFTMAX",
+    34: "PAD",
+    40: "MEAN",
+    114: "QUANTIZE",
+}
+
+
+def load_model_bytes(path):
+    """Returns the raw flatbuffer from a .tflite file or from a C array source file."""
+    if path.endswith(".tflite"):
+        with open(path, "rb") as f:
+            return f.read()
+    with open(path, "r") as f:
+        source = f.read()
+    body = source[source.index("{", source.index("[]")) + 1:]
+    body = body[:body.index("}")]
+    return bytes(int(value, 16) for value in re.findall(r"0x([0-9a-fA-F]{2})", body))
+
+
+class Table:
+    """Flatbuffer table accessor."""
+
+    def __init__(self, buf, pos):
+        self.buf = buf
+        self.pos = pos
+        vtable = pos - struct.unpack_from("<i", buf, pos)[0]
+        self.vtable = vtable
+        self.vtable_size = struct.unpack_from("<H", buf, vtable)[0]
+
+    def _offset(self, field):
+        entry = 4 + 2 * field
+        if entry >= self.vtable_size:
+            return 0
+        return struct.unpack_from("<H", self.buf, self.vtable + entry)[0]
+
+    def has(self, field):
+        return self._offset(field) != 0
+
+    def scalar(self, field, fmt, default=0):
+        off = self._offset(field)
+        if off == 0:
+            return default
+        return struct.unpack_from("<" + fmt, self.buf, self.pos + off)[0]
+
+    def _indirect(self, field):
+        off = self._offset(field)
+        if off == 0:
+            return None
+        at = self.pos + off
+        return at + struct.unpack_from("<I", self.buf, at)[0]
+
+    def table(self, field):
+        at = self._indirect(field)
+        return None if at is None else Table(self.buf, at)
+
+    def vector(self, field):
+        """Returns (start, length) of a vector field, or (0, 0) when absent."""
+        at = self._indirect(field)
+        if at is None:
+            return 0, 0
+        return at + 4, struct.unpack_from("<I", self.buf, at)[0]
+
+    def scalars(self, field, fmt):
+        start, length = self.vector(field)
+        size = struct.calcsize("<" + fmt)
+        return [struct.unpack_from("<" + fmt, self.buf, start + i * size)[0] for i in range(length)]
+
+    def tables(self, field):
+        start, length = self.vector(field)
+        result = []
+        for i in range(length):
+            at = start + 4 * i
+            result.append(Table(self.buf, at + struct.unpack_from("<I", self.buf, at)[0]))
+        return result
+
+    def string(self, field):
+        start, length = self.vector(field)
+        if length == 0:
+            return ""
+        return self.buf[start:start + length].decode("utf-8", "replace")
+
+
+class TensorInfo:
+
+    def __init__(self, index, table, buffers):
+        self.index = index
+        self.name = table.string(3)
+        self.shape = table.scalars(0, "i")
+        self.type_id = table.scalar(1, "b")
+        self.type_name, self.type_size = TENSOR_TYPES.get(self.type_id, ("unknown", 1))
+        self.buffer = table.scalar(2, "I")
+        self.is_variable = table.scalar(5, "B") != 0
+        self.scale = 0.0
+        self.zero_point = 0
+        self.scales = []
+        self.zero_points = []
+        quantization = table.table(4)
+        if quantization is not None:
+            scales = quantization.scalars(2, "f")
+            zero_points = quantization.scalars(3, "q")
+            self.scale = scales[0] if scales else 0.0
+            self.zero_point = zero_points[0] if zero_points else 0
+            #Per-channel quantization parameters (weights of convolutions)
+            self.scales = scales
+            self.zero_points = zero_points
+        data_start, data_length = buffers[self.buffer].vector(0) if self.buffer < len(buffers) else (0, 0)
+        self.is_constant = data_length > 0
+        self.data = table.buf[data_start:data_start + data_length]
+
+    @property
+    def num_elements(self):
+        count = 1
+        for dim in self.shape:
+            count *= max(dim, 1)
+        return count
+
+    @property
+    def bytes(self):
+        return self.num_elements * self.type_size
+
+
+class OperatorInfo:
+
+    def __init__(self, index, table, opcodes):
+        self.index = index
+        self.opcode_index = table.scalar(0, "I")
+        self.inputs = table.scalars(1, "i")
+        self.outputs = table.scalars(2, "i")
+        self.builtin_code = opcodes[self.opcode_index]
+        #Builtin options table (Conv2DOptions, Pool2DOptions, ...), None for operators without options
+        self.options = table.table(4)
+        self.name = BUILTIN_OPERATORS.get(self.builtin_code, "BUILTIN_{}".format(self.builtin_code))
+
+
+class ModelInfo:
+    """Tensors, operators and I/O of the first subgraph of a model."""
+
+    def __init__(self, data):
+        self.data = data
+        root = Table(data, struct.unpack_from("<I", data, 0)[0])
+        self.version = root.scalar(0, "I")
+        opcodes = []
+        for code in root.tables(1):
+            deprecated = code.scalar(0, "b")
+            builtin = code.scalar(3, "i")
+            opcodes.append(max(deprecated, builtin))
+        buffers = root.tables(4)
+        subgraph = root.tables(2)[0]
+        self.tensors = [TensorInfo(i, t, buffers) for i, t in enumerate(subgraph.tables(0))]
+        self.inputs = subgraph.scalars(1, "i")
+        self.outputs = subgraph.scalars(2, "i")
+        self.operators = [OperatorInfo(i, op, opcodes) for i, op in enumerate(subgraph.tables(3))]
+        self.op_names = sorted(set(op.name for op in self.operators))
+
+    def lifetimes(self):
+        """Returns {tensor_index: (first_op, last_op)} for every tensor that has to live in the tensor arena (non-constant tensors)."""
+        last_op = len(self.operators) - 1
+        spans = {}
+
+        def touch(index, op_index):
+            if index < 0 or self.tensors[index].is_constant:
+                return
+            first, last = spans.get(index, (op_index, op_index))
+            spans[index] = (min(first, op_index), max(last, op_index))
+
+        for index in self.inputs:
+            touch(index, 0)
+        for op in self.operators:
+            for index in op.inputs:
+                touch(index, op.index)
+            for index in op.outputs:
+                touch(index, op.index)
+        for index in self.outputs:
+            touch(index, last_op)
+        for index, tensor in enumerate(self.tensors):
+            if tensor.is_variable:
+                spans[index] = (0, last_op)
+        return spans
@@ -0,0 +1,155 @@
+"""
+This script benchmarks the grayscale thumbnail the natural_light sketch offloads instead of the camera JPEG (see jpeg_encoder.cpp). The encoder of the sketch is
+compiled on the host and run on a set of camera frames (for example the images saved by the gateway), using the same 96x96 crop the device decodes. For
+every quality level it reports the encoding time on the host, the thumbnail size compared with the camera JPEG, and the image quality (PSNR against the crop).
+The time on the board is reported by the device itself (thumbnail_encode_ms in the telemetry characteristic), the host time is only useful to compare settings.
+
+With --model, the gateway model (facetracker.h5, as in vjezba.py) is run on the camera JPEG and on every thumbnail, and the share of frames for which the
+thumbnail gives the same decision as the full frame is reported, so the quality can be chosen as low as the gateway accuracy allows.
+Requires g++ and Pillow (numpy, OpenCV and TensorFlow only with --model).
+
+Examples:
+    python thumbnail_benchmark.py ../Gateway_examples/images
+    python thumbnail_benchmark.py ../Gateway_examples/images --qualities 10 30 50 75 --scale 2 --model ../Gateway_examples/facetracker.h5
+"""
+import argparse
+import ctypes
+import glob
+import io
+import math
+import os
+import tempfile
+import time
+
+from PIL import Image
+
+from sketch_build import sketch_library
+
+SKETCH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Arduino_examples", "natural_light")
+#Camera resolution (OV2640_160x120 in arduino_image_provider.cpp), the MCU size of its JPEG frames and the model input the device crops from it
+CAMERA_SIZE = (160, 120)
+MCU_SIZE = (16, 8)
+CROP = 96
+MAX_BYTES = 16 * 1024
+
+WRAPPER = """
+#include "jpeg_encoder.h"
+extern "C" void bench_downscale(int8_t* luma, int width, int height, int factor) { jpeg_downscale(luma, width, height, factor); }
+extern "C" int bench_encode(const int8_t* luma, int width, int height, int quality, uint8_t* out, int max_length)
+{
+    return jpeg_encode_gray(luma, width, height, quality, out, max_length);
+}
+"""
+
+
+def build_encoder(build_dir):
+    """Compiles jpeg_encoder.cpp of the sketch into a shared library and returns it loaded with ctypes."""
+    encoder = sketch_library(build_dir, SKETCH, ["jpeg_encoder.cpp"], WRAPPER)
+    encoder.bench_encode.restype = ctypes.c_int
+    return encoder
+
+
+def crop_origin():
+    """Top left corner of the crop: DecodeAndProcessImage keeps whole MCUs and skips half of the others (rounded down) before them, (32, 8)."""
+    return tuple((size // mcu - CROP // mcu) // 2 * mcu for size, mcu in zip(CAMERA_SIZE, MCU_SIZE))
+
+
+def device_crop(path):
+    """Greyscale 96x96 crop of a camera frame, as DecodeAndProcessImage produces it on the device. Frames of another size (not from the camera) are
+    resized to the camera resolution first."""
+    image = Image.open(path).convert("L")
+    if image.size != CAMERA_SIZE:
+        image = image.resize(CAMERA_SIZE)
+    left, top = crop_origin()
+    return image.crop((left, top, left + CROP, top + CROP))
+
+
+def encode(encoder, crop, quality, scale):
+    """Returns (thumbnail bytes, encoding time in ms)."""
+    luma = (ctypes.c_int8 * (CROP * CROP))(*[pixel - 128 for pixel in crop.tobytes()])
+    out = (ctypes.c_uint8 * MAX_BYTES)()
+    start = time.perf_counter()
+    encoder.bench_downscale(luma, CROP, CROP, scale)
+    length = encoder.bench_encode(luma, CROP // scale, CROP // scale, quality, out, MAX_BYTES)
+    elapsed = (time.perf_counter() - start) * 1000
+    if length < 0:
+        raise RuntimeError("thumbnail does not fit into {} bytes".format(MAX_BYTES))
+    return bytes(out[:length]), elapsed
+
+
+def psnr(reference, image):
+    if image.size != reference.size:
+        image = image.resize(reference.size)
+    error = sum((a - b) ** 2 for a, b in zip(reference.tobytes(), image.convert("L").tobytes())) / (reference.size[0] * reference.size[1])
+    return 99.0 if error == 0 else 10 * math.log10(255 ** 2 / error)
+
+
+class GatewayModel:
+    """Runs the gateway model with the same preprocessing as remote_inference() in vjezba.py."""
+
+    def __init__(self, path):
+        import numpy as np
+        import tensorflow as tf
+        from tensorflow.keras.models import load_model
+        self.np = np
+        self.tf = tf
+        self.model = load_model(path)
+
+    def score(self, jpeg_bytes):
+        image = Image.open(io.BytesIO(jpeg_bytes)).convert("RGB").resize((320, 240))
+        resized = self.tf.image.resize(self.np.asarray(image), (120, 120))
+        yhat = self.model.predict(self.np.expand_dims(resized / 255, 0), verbose=0)
+        return float(yhat[0][0])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("images", help="directory with camera JPEG frames")
+    parser.add_argument("--qualities", type=int, nargs="+", default=[10, 25, 50, 75, 90])
+    parser.add_argument("--scale", type=int, default=1, choices=[1, 2, 4], help="THUMBNAIL_SCALE of the sketch")
+    parser.add_argument("--model", help="gateway model (facetracker.h5) used to compare the decisions")
+    parser.add_argument("--threshold", type=float, default=0.5)
+    args = parser.parse_args()
+
+    paths = sorted(glob.glob(os.path.join(args.images, "*.jpg")) + glob.glob(os.path.join(args.images, "*.jpeg")))
+    if not paths:
+        parser.error("no JPEG images in {}".format(args.images))
+
+    with tempfile.TemporaryDirectory() as build_dir:
+        encoder = build_encoder(build_dir)
+        model = GatewayModel(args.model) if args.model else None
+
+        frames = []
+        for path in paths:
+            with open(path, "rb") as f:
+                original = f.read()
+            reference = model.score(original) if model else None
+            frames.append((original, device_crop(path), reference))
+        camera_bytes = sum(len(original) for original, _, _ in frames) / len(frames)
+        print("{} frames, camera JPEG {:.0f} B on average, thumbnail {}x{}".format(len(frames), camera_bytes, CROP // args.scale, CROP // args.scale))
+
+        header = "{:>7} {:>10} {:>9} {:>10} {:>9}".format("quality", "bytes", "of JPEG", "encode ms", "PSNR dB")
+        if model:
+            header += " {:>9} {:>11}".format("agree", "score diff")
+        print(header)
+        for quality in args.qualities:
+            sizes, times, quality_db, agree, diff = [], [], [], 0, 0.0
+            for original, crop, reference in frames:
+                thumbnail, elapsed = encode(encoder, crop, quality, args.scale)
+                sizes.append(len(thumbnail))
+                times.append(elapsed)
+                quality_db.append(psnr(crop, Image.open(io.BytesIO(thumbnail))))
+                if model:
+                    score = model.score(thumbnail)
+                    agree += (score > args.threshold) == (reference > args.threshold)
+                    diff += abs(score - reference)
+            size = sum(sizes) / len(sizes)
+            line = "{:>7} {:>10.0f} {:>9.0%} {:>10.2f} {:>9.1f}".format(quality, size, size / camera_bytes, sum(times) / len(times),
+                                                                       sum(quality_db) / len(quality_db))
+            if model:
+                line += " {:>9.0%} {:>11.3f}".format(agree / len(frames), diff / len(frames))
+            print(line)
+
+
+if __name__ == "__main__":
+    main()
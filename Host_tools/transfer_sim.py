@@ -0,0 +1,369 @@
+"""
+This script runs the image transfer of the natural_light and remote_inference sketches (image_transfer.cpp and frame_codec.cpp, compiled on the host) over a
+loopback stand-in for the BLE link, with the reassembler of the gateway (Gateway_examples/frame_codec.py) on the other side, to compare the transfer modes.
+
+The link has connection events every --interval ms. In the indicate mode (the original path) every chunk is one indication, which waits for the confirmation
+in the next connection event. In the windowed mode chunks are notifications: up to --buffers wait in the controller and --packets of them go out in every
+connection event. The writes of the gateway (acknowledgements, every --ack-every chunks as in vjezba.py) arrive in the first connection event --gateway-ms after
+the chunk that triggered them. Time is simulated, millis() and delay() of the sketch follow the connection events.
+
+For every mode and connection interval it reports the transfer time, throughput, connection events, bytes per connection event and retransmitted chunks, and
+checks that the gateway reassembled every frame intact.
+Requires g++.
+
+Examples:
+    python transfer_sim.py
+    python transfer_sim.py --intervals 7.5 30 50 --sizes 2000 3080 4096 --packets 6
+"""
+import argparse
+import ctypes
+import os
+import random
+import shutil
+import sys
+import tempfile
+
+from sketch_build import compile_library
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Gateway_examples"))
+import frame_codec
+
+SKETCH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Arduino_examples", "natural_light")
+#Must be the same as in image_transfer.h
+TRANSFER_INDICATE = 0
+TRANSFER_NOTIFY_WINDOWED = 1
+MODES = {"indicate": TRANSFER_INDICATE, "windowed": TRANSFER_NOTIFY_WINDOWED}
+#ack_every of vjezba.py
+ACK_EVERY = 2
+MTU = 247
+MAX_JPEG_BYTES = 4096
+
+#Stands in for application.h: the parts of ArduinoBLE and the sketch image_transfer.cpp uses
+APPLICATION_H = """
+#include <stdint.h>
+struct SimCharacteristic { int writeValue(const uint8_t* data, int length); };
+struct SimBLE { void poll(); bool connected(); };
+extern SimCharacteristic txChar;
+extern SimBLE BLE;
+extern unsigned long millis();
+extern void delay(unsigned long ms);
+extern int read_voltage();
+"""
+
+#Loopback link with connection events, driven by the calls of the sketch
+LINK_CPP = """
+#include "application.h"
+#include "image_transfer.h"
+#include <deque>
+#include <vector>
+
+typedef void (*notify_callback)(const uint8_t* data, int length, double time_ms);
+typedef int (*voltage_callback)(double time_ms);
+
+struct Write { std::vector<uint8_t> data; double ready_us; };
+
+SimCharacteristic txChar;
+SimBLE BLE;
+static double now_us = 0;
+static double next_event_us = 0;
+static double interval_us = 30000;
+static double gateway_delay_us = 0;
+static int packets_per_event = 4;
+static unsigned int controller_buffers = 8;
+static bool link_up = false;
+static double disconnect_us = -1;
+static std::deque<std::vector<uint8_t> > tx_queue;
+static std::deque<Write> rx_queue;
+static notify_callback on_notify = nullptr;
+static voltage_callback on_voltage = nullptr;
+static unsigned long events = 0;
+static unsigned long packets = 0;
+static double sleep_us = 0;
+
+static void connection_event()
+{
+    now_us = next_event_us;
+    next_event_us += interval_us;
+    events++;
+    if(disconnect_us >= 0 && now_us >= disconnect_us)
+    {
+        link_up = false;
+        disconnect_us = -1;
+        tx_queue.clear();
+        rx_queue.clear();
+    }
+    if(!link_up)
+    {
+        return;
+    }
+    //Writes of the gateway that are ready, then the queued notifications of the device
+    while(!rx_queue.empty() && rx_queue.front().ready_us <= now_us)
+    {
+        Write write = rx_queue.front();
+        rx_queue.pop_front();
+        transfer_on_message(write.data.data(), write.data.size());
+    }
+    for(int i = 0; i < packets_per_event && !tx_queue.empty(); i++)
+    {
+        std::vector<uint8_t> packet = tx_queue.front();
+        tx_queue.pop_front();
+        packets++;
+        on_notify(packet.data(), packet.size(), now_us / 1000);
+    }
+}
+
+int SimCharacteristic::writeValue(const uint8_t* data, int length)
+{
+    if(!link_up)
+    {
+        return 0;
+    }
+#if TRANSFER_MODE == TRANSFER_INDICATE
+    //Sent in the next connection event, confirmed by the central in the one after
+    tx_queue.push_back(std::vector<uint8_t>(data, data + length));
+    while(link_up && !tx_queue.empty())
+    {
+        connection_event();
+    }
+    connection_event();
+#else
+    while(link_up && tx_queue.size() >= controller_buffers)
+    {
+        connection_event();
+    }
+    tx_queue.push_back(std::vector<uint8_t>(data, data + length));
+#endif
+    return link_up;
+}
+
+void SimBLE::poll()
+{
+    connection_event();
+}
+
+bool SimBLE::connected()
+{
+    return link_up;
+}
+
+unsigned long millis()
+{
+    return (unsigned long)(now_us / 1000);
+}
+
+void delay(unsigned long ms)
+{
+    double end_us = now_us + ms * 1000.0;
+    sleep_us += ms * 1000.0;
+    while(next_event_us <= end_us)
+    {
+        connection_event();
+    }
+    now_us = end_us;
+}
+
+int read_voltage()
+{
+    return on_voltage(now_us / 1000);
+}
+
+extern "C" void sim_configure(double interval_ms, int packets, int buffers, double gateway_ms, notify_callback notify, voltage_callback voltage)
+{
+    interval_us = interval_ms * 1000;
+    packets_per_event = packets;
+    controller_buffers = buffers;
+    gateway_delay_us = gateway_ms * 1000;
+    on_notify = notify;
+    on_voltage = voltage;
+}
+
+//A central connects and subscribes
+extern "C" void sim_connect()
+{
+    link_up = true;
+    next_event_us = now_us + interval_us;
+    transfer_on_connect();
+}
+
+extern "C" void sim_disconnect_at(double time_ms)
+{
+    disconnect_us = time_ms * 1000;
+}
+
+extern "C" void sim_gateway_write(const uint8_t* data, int length)
+{
+    Write write = {std::vector<uint8_t>(data, data + length), now_us + gateway_delay_us};
+    rx_queue.push_back(write);
+}
+
+extern "C" bool sim_transfer(const uint8_t* data, int length) { return transfer_image(data, length); }
+extern "C" void sim_abort() { transfer_abort(); }
+extern "C" double sim_now_ms() { return now_us / 1000; }
+extern "C" void sim_advance(double ms) { delay((unsigned long)ms); }
+extern "C" unsigned long sim_events() { return events; }
+extern "C" unsigned long sim_packets() { return packets; }
+extern "C" double sim_sleep_ms() { return sleep_us / 1000; }
+extern "C" void sim_stats(unsigned long* out)
+{
+    out[0] = transfer_stats.duration_ms;
+    out[1] = transfer_stats.bytes;
+    out[2] = transfer_stats.chunks;
+    out[3] = transfer_stats.retransmitted;
+    out[4] = transfer_stats.chunk_size;
+    out[5] = transfer_stats.paused_ms;
+    out[6] = transfer_stats.resumes;
+}
+"""
+
+NOTIFY_CALLBACK = ctypes.CFUNCTYPE(None, ctypes.POINTER(ctypes.c_uint8), ctypes.c_int, ctypes.c_double)
+VOLTAGE_CALLBACK = ctypes.CFUNCTYPE(ctypes.c_int, ctypes.c_double)
+STATS = ["duration_ms", "bytes", "chunks", "retransmitted", "chunk_size", "paused_ms", "resumes"]
+
+
+def build_transfer(build_dir, mode):
+    """Compiles image_transfer.cpp of the sketch with the loopback link for the given TRANSFER_MODE, returns it loaded with ctypes.
+    The sources are copied next to the stand-in application.h, which their quoted includes find first."""
+    source_dir = os.path.join(build_dir, "mode{}".format(mode))
+    os.makedirs(source_dir, exist_ok=True)
+    for name in ("image_transfer.cpp", "image_transfer.h", "frame_codec.cpp", "frame_codec.h"):
+        shutil.copy(os.path.join(SKETCH, name), source_dir)
+    with open(os.path.join(source_dir, "application.h"), "w") as f:
+        f.write(APPLICATION_H)
+    with open(os.path.join(source_dir, "link.cpp"), "w") as f:
+        f.write(LINK_CPP)
+    library = ctypes.CDLL(compile_library(source_dir, "transfer", [os.path.join(source_dir, name) for name in ("link.cpp", "image_transfer.cpp", "frame_codec.cpp")],
+                                          source_dir, ["TRANSFER_MODE={}".format(mode)]))
+    library.windowed = mode == TRANSFER_NOTIFY_WINDOWED
+    library.sim_configure.argtypes = [ctypes.c_double, ctypes.c_int, ctypes.c_int, ctypes.c_double, NOTIFY_CALLBACK, VOLTAGE_CALLBACK]
+    library.sim_disconnect_at.argtypes = [ctypes.c_double]
+    library.sim_gateway_write.argtypes = [ctypes.c_char_p, ctypes.c_int]
+    library.sim_transfer.argtypes = [ctypes.c_char_p, ctypes.c_int]
+    library.sim_transfer.restype = ctypes.c_bool
+    library.sim_now_ms.restype = ctypes.c_double
+    library.sim_advance.argtypes = [ctypes.c_double]
+    library.sim_events.restype = ctypes.c_ulong
+    library.sim_packets.restype = ctypes.c_ulong
+    library.sim_sleep_ms.restype = ctypes.c_double
+    return library
+
+
+class SimGateway:
+    """The gateway side of vjezba.py: reassembles the chunks and writes acknowledgements back over the link."""
+
+    def __init__(self, library, windowed, mtu=MTU, ack_every=ACK_EVERY):
+        self.library = library
+        self.windowed = windowed
+        self.mtu = mtu
+        self.ack_every = ack_every
+        self.reassembler = frame_codec.FrameReassembler()
+        self.counter = 0
+        self.images = []
+        self.received = 0
+
+    def write(self, message):
+        self.library.sim_gateway_write(message, len(message))
+
+    def subscribe(self):
+        """Connection and subscription, followed by the first acknowledgement with the MTU in the windowed mode."""
+        self.library.sim_connect()
+        if self.windowed:
+            self.write(self.reassembler.ack(self.mtu))
+
+    def deliver(self, data, time_ms):
+        self.received += 1
+        image = self.reassembler.add(data)
+        self.counter += 1
+        if self.windowed and (image is not None or self.counter % self.ack_every == 0):
+            self.write(self.reassembler.ack(self.mtu))
+        if image is not None:
+            self.counter = 0
+            self.images.append((time_ms, image))
+
+    def on_notify(self, data, length, time_ms):
+        self.deliver(bytes(data[:length]), time_ms)
+
+
+class Loopback:
+    """Image transfer of the sketch on one side of the loopback link and a gateway on the other."""
+
+    def __init__(self, library, gateway_class, args, voltage=None, **gateway_options):
+        self.library = library
+        self.gateway = gateway_class(library, library.windowed, **gateway_options)
+        self.notify = NOTIFY_CALLBACK(lambda data, length, time_ms: self.gateway.on_notify(data, length, time_ms))
+        self.voltage = VOLTAGE_CALLBACK(voltage or (lambda time_ms: 4200))
+        library.sim_configure(args.interval, args.packets, args.buffers, args.gateway_ms, self.notify, self.voltage)
+
+    def send(self, image):
+        """Sends one image, returns (delivered, stats dict)."""
+        delivered = self.library.sim_transfer(image, len(image))
+        stats = (ctypes.c_ulong * len(STATS))()
+        self.library.sim_stats(stats)
+        return delivered, dict(zip(STATS, stats))
+
+
+def make_frames(sizes, count, seed):
+    rng = random.Random(seed)
+    return [bytes(rng.getrandbits(8) for _ in range(sizes[i % len(sizes)])) for i in range(count)]
+
+
+def run_mode(library, frames, args):
+    """Transfers the frames over one connection, returns the totals."""
+    link = Loopback(library, SimGateway, args, ack_every=args.ack_every)
+    link.gateway.subscribe()
+    start_ms = library.sim_now_ms()
+    start_events = library.sim_events()
+    totals = {"bytes": 0, "chunks": 0, "retransmitted": 0, "failed": 0, "ms": 0.0}
+    for image in frames:
+        frame_start = library.sim_now_ms()
+        delivered, stats = link.send(image)
+        if not delivered:
+            library.sim_abort()
+            totals["failed"] += 1
+        totals["ms"] += library.sim_now_ms() - frame_start
+        totals["bytes"] += len(image)
+        totals["chunks"] += stats["chunks"]
+        totals["retransmitted"] += stats["retransmitted"]
+        totals["chunk_size"] = stats["chunk_size"]
+    totals["events"] = library.sim_events() - start_events
+    totals["intact"] = [image for _, image in link.gateway.images] == frames
+    totals["elapsed_ms"] = library.sim_now_ms() - start_ms
+    return totals
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--intervals", type=float, nargs="+", default=[7.5, 30, 50], help="connection intervals in ms")
+    parser.add_argument("--sizes", type=int, nargs="+", default=[3080], help="image sizes in bytes (at most {})".format(MAX_JPEG_BYTES))
+    parser.add_argument("--frames", type=int, default=5)
+    parser.add_argument("--packets", type=int, default=4, help="notifications per connection event")
+    parser.add_argument("--buffers", type=int, default=8, help="notifications the controller queues")
+    parser.add_argument("--gateway-ms", type=float, default=10, help="time the gateway needs to write an acknowledgement")
+    parser.add_argument("--ack-every", type=int, default=ACK_EVERY, help="chunks per acknowledgement of the gateway")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    frames = make_frames(args.sizes, args.frames, args.seed)
+    ok = True
+    with tempfile.TemporaryDirectory() as build_dir:
+        libraries = {}
+        for name, mode in MODES.items():
+            libraries[name] = build_transfer(build_dir, mode)
+        print("{:>11} {:>9} {:>9} {:>10} {:>8} {:>12} {:>7} {:>6} {:>7}".format("interval ms", "mode", "chunk B", "ms/frame", "B/s",
+                                                                            "events/frame", "B/event", "resent", "intact"))
+        for interval in args.intervals:
+            args.interval = interval
+            results = {}
+            for name, library in libraries.items():
+                totals = run_mode(library, frames, args)
+                results[name] = totals
+                ok &= totals["intact"] and totals["failed"] == 0
+                print("{:>11g} {:>9} {:>9} {:>10.0f} {:>8.0f} {:>12.1f} {:>7.0f} {:>6} {:>7}".format(
+                    interval, name, totals["chunk_size"], totals["ms"] / len(frames), totals["bytes"] * 1000 / totals["ms"],
+                    totals["events"] / len(frames), totals["bytes"] / totals["events"], totals["retransmitted"],
+                    "yes" if totals["intact"] else "NO"))
+            print("{:>11} windowed is {:.1f}x faster".format("", results["indicate"]["ms"] / results["windowed"]["ms"]))
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,122 @@
+"""
+This script evaluates the multi-window person search of the natural_light sketch (see window_search.cpp) on a set of camera frames. Every frame is converted to
+the 160x120 luma the device decodes, and the reference int8 model (split_model.py) is run on the same 96x96 windows in the same order as on the board, stopping
+at the first confident window. It compares the search with the centre crop alone (the original behaviour) and with running every window: the recall on frames
+with a person, the false positive rate on frames without one, the windows run per frame and the estimated local inference time. For every window position it
+reports how often it ran and how often it found the person.
+
+If the image directory contains the subdirectories person and no_person, they are used as labels; otherwise the detection rate of every mode is reported.
+The time per window is the measured duration of the full inference (execution_time of F_local in application.cpp); the time measured on the board is reported in
+the telemetry (search_ms). With --budget-ms the time budget the scheduler passes to the search is applied as well.
+Requires numpy and Pillow.
+
+Examples:
+    python window_search_benchmark.py frames
+    python window_search_benchmark.py frames --budget-ms 2500 --confident 0.9
+"""
+import argparse
+import os
+
+import numpy as np
+from PIL import Image
+
+from split_benchmark import load_frames
+from split_model import ReferenceModel
+from thumbnail_benchmark import crop_origin
+
+DEFAULT_MODEL = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Arduino_examples", "natural_light", "person_detect_model_data.cpp")
+#Must be the same as SEARCH_FRAME_WIDTH / SEARCH_FRAME_HEIGHT in window_search.h and search_windows in window_search.cpp
+FRAME_SIZE = (160, 120)
+#The centre window is the MCU-aligned crop of DecodeAndProcessImage, (32, 8)
+WINDOWS = [crop_origin(), (0, 0), (64, 0), (0, 24), (64, 24)]
+CROP = 96
+#SEARCH_CONFIDENT_SCORE 77 of the int8 output, (77 + 128) / 256
+CONFIDENT = 0.8
+THRESHOLD = 0.5
+WINDOW_MS = 1148
+
+
+def device_frame(path):
+    """160x120 int8 luma, as DecodeAndProcessImage produces it for the search."""
+    image = Image.open(path).convert("L")
+    if image.size != FRAME_SIZE:
+        image = image.resize(FRAME_SIZE)
+    return (np.asarray(image, np.int32) - 128).astype(np.int8)
+
+
+def search(scores, confident, max_windows):
+    """Replays search_run() on the person probabilities of all windows, returns (best probability, windows run, index of the best window)."""
+    best, best_window, run = None, None, 0
+    for window, score in enumerate(scores[:max_windows]):
+        run += 1
+        if best is None or score > best:
+            best, best_window = score, window
+        if score >= confident:
+            break
+    return best, run, best_window
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("images", help="directory with camera frames (optionally in person / no_person subdirectories)")
+    parser.add_argument("--model", default=DEFAULT_MODEL, help=".tflite file or C array source of the model")
+    parser.add_argument("--confident", type=float, default=CONFIDENT, help="person probability that stops the search")
+    parser.add_argument("--window-ms", type=float, default=WINDOW_MS)
+    parser.add_argument("--budget-ms", type=float, help="time budget of the search (the first window always runs)")
+    args = parser.parse_args()
+
+    frames = load_frames(args.images)
+    if not frames:
+        parser.error("no images in {}".format(args.images))
+    model = ReferenceModel(args.model)
+    budget_windows = len(WINDOWS)
+    if args.budget_ms is not None:
+        budget_windows = max(1, min(len(WINDOWS), int(args.budget_ms // args.window_ms)))
+
+    #Person probability of every window of every frame
+    scores = []
+    for path, _ in frames:
+        frame = device_frame(path)
+        window_scores = []
+        for x, y in WINDOWS:
+            crop = frame[y:y + CROP, x:x + CROP].reshape(1, CROP, CROP, 1)
+            window_scores.append(model.person_probability(model.run(crop)))
+        scores.append(window_scores)
+
+    labels = [label for _, label in frames]
+    labelled = any(label is not None for label in labels)
+    modes = (("centre crop", 0, 1), ("search", args.confident, budget_windows), ("all windows", 2.0, len(WINDOWS)))
+    header = "{:>12} {:>8} {:>10}".format("mode", "windows", "ms/frame")
+    header += " {:>8} {:>8}".format("recall", "false +") if labelled else " {:>9}".format("detected")
+    print("{} frames, {} windows, search stops at {:.2f}{}".format(len(frames), len(WINDOWS), args.confident,
+                                                                 ", budget {} windows".format(budget_windows) if args.budget_ms is not None else ""))
+    print(header)
+    ran = [0] * len(WINDOWS)
+    found = [0] * len(WINDOWS)
+    for name, confident, max_windows in modes:
+        results = [search(window_scores, confident, max_windows) for window_scores in scores]
+        detected = [best > THRESHOLD for best, _, _ in results]
+        windows = sum(run for _, run, _ in results) / len(results)
+        line = "{:>12} {:>8.2f} {:>10.0f}".format(name, windows, windows * args.window_ms)
+        if labelled:
+            person = [d for d, label in zip(detected, labels) if label is True]
+            empty = [d for d, label in zip(detected, labels) if label is False]
+            line += " {:>8} {:>8}".format("{:.1%}".format(sum(person) / len(person)) if person else "-",
+                                          "{:.1%}".format(sum(empty) / len(empty)) if empty else "-")
+        else:
+            line += " {:>9.1%}".format(sum(detected) / len(detected))
+        print(line)
+        if name == "search":
+            for (best, run, window), hit in zip(results, detected):
+                for i in range(run):
+                    ran[i] += 1
+                if hit:
+                    found[window] += 1
+
+    print("{:>6} {:>10} {:>8} {:>9} {:>10}".format("window", "position", "ran", "found", "ms/frame"))
+    for i, (x, y) in enumerate(WINDOWS):
+        print("{:>6} {:>10} {:>8.0%} {:>9} {:>10.0f}".format(i, "{},{}".format(x, y), ran[i] / len(frames), found[i], ran[i] / len(frames) * args.window_ms))
+
+
+if __name__ == "__main__":
+    main()